@@ -143,6 +143,17 @@ struct block_mode
 	float percentile;
 };
 
+// compact per-block-mode data needed to unpack a physical block,
+// precomputed so that the decoder does not touch the decimation tables.
+struct block_mode_decode
+{
+	uint8_t permit_decode;
+	uint8_t is_dual_plane;
+	uint8_t quantization_mode;
+	uint8_t weight_count; // weights per plane
+	uint8_t bits_for_weights; // ISE bits of all planes
+};
+
 struct block_size_descriptor
 {
 	int decimation_mode_count;
@@ -153,6 +164,7 @@ struct block_size_descriptor
 	int permit_encode[MAX_DECIMATION_MODES];
 	decimation_table decimation_tables[MAX_DECIMATION_MODES + 1];
 	block_mode block_modes[MAX_WEIGHT_MODES];
+	block_mode_decode block_mode_decodes[MAX_WEIGHT_MODES];
 
 	// for the k-means bed bitmap partitioning algorithm, we don't
 	// want to consider more than 64 texels; this array specifies
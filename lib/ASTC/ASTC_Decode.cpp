@@ -27,47 +27,125 @@
 #include "ASTC/ASTC_Decode.h"
 
 #include <cassert>
-#include <cstring>
 
-ASTCBlockDecoder::ASTCBlockDecoder(
-	ASTC_Encoder::ASTC_Encode *codec, BYTE BlockWidth, BYTE BlockHeight)
+ASTCBlockDecoder::ASTCBlockDecoder(ASTC_Encoder::ASTC_Encode *codec,
+	BYTE BlockWidth, BYTE BlockHeight, const texel_layout_cpu *layout,
+	BYTE BlockDepth)
 	: codec(codec)
-	, img(allocate_image_cpu(8, BlockWidth, BlockHeight, 1, 0))
+	, layout(layout)
+	, blockWidth(BlockWidth)
+	, blockHeight(BlockHeight)
+	, blockDepth(BlockDepth)
 {
 }
 
-ASTCBlockDecoder::~ASTCBlockDecoder()
+void ASTCBlockDecoder::decompressTexels(
+	imageblock_cpu &pb, const BYTE in[]) const
 {
-	destroy_image_cpu(img);
+	physical_compressed_block_cpu pcb =
+		*(const physical_compressed_block_cpu *) in;
+	symbolic_compressed_block_cpu scb;
+
+	physical_to_symbolic_cpu(blockWidth, blockHeight, blockDepth, pcb, &scb);
+
+	pb.xpos = pb.ypos = pb.zpos = 0;
+	decompress_symbolic_block(&scb, &pb, codec);
+}
+
+void ASTCBlockDecoder::decompressHalfTexels(
+	uint16_t *texels, const BYTE in[]) const
+{
+	physical_compressed_block_cpu pcb =
+		*(const physical_compressed_block_cpu *) in;
+	symbolic_compressed_block_cpu scb;
+
+	physical_to_symbolic_cpu(blockWidth, blockHeight, blockDepth, pcb, &scb);
+
+	decompress_symbolic_block_sf16(&scb, texels, codec);
 }
 
 void ASTCBlockDecoder::decompress(CMP_COLOR out[], const BYTE in[])
 {
-	DecompressBlock(img, out, in, codec);
+	DecompressBlock(blockWidth, blockHeight, out, in, codec);
 }
 
-void ASTCBlockDecoder::DecompressBlock(BYTE BlockWidth, BYTE BlockHeight,
-	CMP_COLOR out[], const BYTE in[], ASTC_Encoder::ASTC_Encode *encoder)
+void ASTCBlockDecoder::decompress(BYTE *out, ptrdiff_t pitch, int x, int y,
+	int width, int height, const BYTE in[])
+{
+	decompress(out, pitch, 0, x, y, 0, width, height, 1, in);
+}
+
+void ASTCBlockDecoder::decompressHalf(BYTE *out, ptrdiff_t pitch, int x,
+	int y, int width, int height, const BYTE in[])
+{
+	decompressHalf(out, pitch, 0, x, y, 0, width, height, 1, in);
+}
+
+void ASTCBlockDecoder::decompress(BYTE *out, ptrdiff_t pitch,
+	ptrdiff_t slicePitch, int x, int y, int z, int width, int height,
+	int depth, const BYTE in[])
 {
-	// Results Buffer
-	astc_codec_image_cpu *img =
-		allocate_image_cpu(8, BlockWidth, BlockHeight, 1, 0);
+	assert(x >= 0 && width > 0 && x + width <= blockWidth);
+	assert(y >= 0 && height > 0 && y + height <= blockHeight);
+	assert(z >= 0 && depth > 0 && z + depth <= blockDepth);
 
-	DecompressBlock(img, out, in, encoder);
+	imageblock_cpu pb;
+	decompressTexels(pb, in);
 
-	destroy_image_cpu(img);
+	// Slices follow each other in the block, so a slice is just more rows
+	for (int i = 0; i < depth; i++)
+	{
+		write_imageblock_rgba8_cpu(&pb, blockWidth, x,
+			(z + i) * blockHeight + y, width, height, layout,
+			out + i * slicePitch, pitch);
+	}
+}
+
+void ASTCBlockDecoder::decompressHalf(BYTE *out, ptrdiff_t pitch,
+	ptrdiff_t slicePitch, int x, int y, int z, int width, int height,
+	int depth, const BYTE in[])
+{
+	assert(x >= 0 && width > 0 && x + width <= blockWidth);
+	assert(y >= 0 && height > 0 && y + height <= blockHeight);
+	assert(z >= 0 && depth > 0 && z + depth <= blockDepth);
+
+	uint16_t texels[4 * MAX_TEXELS_PER_BLOCK];
+	decompressHalfTexels(texels, in);
+
+	for (int i = 0; i < depth; i++)
+	{
+		write_imageblock_sf16_cpu(texels, blockWidth, x,
+			(z + i) * blockHeight + y, width, height, layout,
+			out + i * slicePitch, pitch);
+	}
 }
 
-void ASTCBlockDecoder::DecompressBlock(astc_codec_image_cpu *img,
+void ASTCBlockDecoder::decompressAverage(float color[4], const BYTE in[])
+{
+	physical_compressed_block_cpu pcb =
+		*(const physical_compressed_block_cpu *) in;
+	symbolic_compressed_block_cpu scb;
+
+	physical_to_symbolic_cpu(blockWidth, blockHeight, blockDepth, pcb, &scb);
+
+	decompress_symbolic_block_average(&scb, color, codec);
+}
+
+void ASTCBlockDecoder::DecompressBlock(BYTE BlockWidth, BYTE BlockHeight,
 	CMP_COLOR out[], const BYTE in[], ASTC_Encoder::ASTC_Encode *encoder)
 {
-	assert(img->imagedata8);
-	assert(img->zsize == 1);
-	assert(img->padding == 0);
-	int BlockWidth = img->xsize;
-	int BlockHeight = img->ysize;
+	DecompressBlock(BlockWidth, BlockHeight, reinterpret_cast<BYTE *>(out),
+		BlockWidth * sizeof(CMP_COLOR), 0, 0, BlockWidth, BlockHeight, in,
+		encoder, &texel_layout_rgba8_cpu);
+}
 
-	initialize_image_cpu(img);
+void ASTCBlockDecoder::DecompressBlock(BYTE BlockWidth, BYTE BlockHeight,
+	BYTE *out, ptrdiff_t pitch, int x, int y, int width, int height,
+	const BYTE in[], ASTC_Encoder::ASTC_Encode *encoder,
+	const texel_layout_cpu *layout)
+{
+	assert(x >= 0 && width > 0 && x + width <= BlockWidth);
+	assert(y >= 0 && height > 0 && y + height <= BlockHeight);
 
 	physical_compressed_block_cpu pcb =
 		*(const physical_compressed_block_cpu *) in;
@@ -75,20 +153,11 @@ void ASTCBlockDecoder::DecompressBlock(astc_codec_image_cpu *img,
 
 	physical_to_symbolic_cpu(BlockWidth, BlockHeight, 1, pcb, &scb);
 
-	swizzlepattern_cpu swz_decode = { 0, 1, 2, 3 };
 	imageblock_cpu pb;
 	pb.xpos = pb.ypos = pb.zpos = 0;
 
 	decompress_symbolic_block(&scb, &pb, encoder);
 
-	write_imageblock_cpu(
-		img, &pb, BlockWidth, BlockHeight, 1, 0, 0, 0, swz_decode);
-
-	// copy results to our output buffer
-	CMP_COLOR *ptr = out;
-	for (int y = 0; y < BlockHeight; y++)
-	{
-		memcpy(ptr, img->imagedata8[0][y], BlockWidth * 4);
-		ptr += BlockWidth;
-	}
+	write_imageblock_rgba8_cpu(
+		&pb, BlockWidth, x, y, width, height, layout, out, pitch);
 }
@@ -33,22 +33,55 @@
 class ASTCBlockDecoder
 {
 	ASTC_Encoder::ASTC_Encode *codec;
-	astc_codec_image_cpu *img;
+	const texel_layout_cpu *layout;
+	BYTE blockWidth;
+	BYTE blockHeight;
+	BYTE blockDepth;
+
+	void decompressTexels(imageblock_cpu &pb, const BYTE in[]) const;
+	void decompressHalfTexels(uint16_t *texels, const BYTE in[]) const;
 
 public:
-	ASTCBlockDecoder(
-		ASTC_Encoder::ASTC_Encode *codec, BYTE BlockWidth, BYTE BlockHeight);
-	~ASTCBlockDecoder();
+	ASTCBlockDecoder(ASTC_Encoder::ASTC_Encode *codec, BYTE BlockWidth,
+		BYTE BlockHeight,
+		const texel_layout_cpu *layout = &texel_layout_rgba8_cpu,
+		BYTE BlockDepth = 1);
 
 	void decompress(CMP_COLOR out[], const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE]);
 
+	// Decodes one block straight into an image with the decoder layout.
+	// Only the width x height texels starting at (x, y) inside the block
+	// are stored. out points at where texel (x, y) goes and pitch is the
+	// byte distance between block rows (negative for bottom-up images).
+	void decompress(BYTE *out, ptrdiff_t pitch, int x, int y, int width,
+		int height, const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE]);
+
+	// Same for an image of half float texels, HDR values are kept. The
+	// decoder layout offsets count 16-bit channels.
+	void decompressHalf(BYTE *out, ptrdiff_t pitch, int x, int y, int width,
+		int height, const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE]);
+
+	// 3D block versions of the above: depth slices starting at slice z
+	// inside the block are stored, slicePitch bytes apart.
+	void decompress(BYTE *out, ptrdiff_t pitch, ptrdiff_t slicePitch, int x,
+		int y, int z, int width, int height, int depth,
+		const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE]);
+	void decompressHalf(BYTE *out, ptrdiff_t pitch, ptrdiff_t slicePitch,
+		int x, int y, int z, int width, int height, int depth,
+		const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE]);
+
+	// Computes the approximate average RGBA color of a block, in [0,1]
+	void decompressAverage(
+		float color[4], const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE]);
+
 	static void DecompressBlock(BYTE BlockWidth, BYTE BlockHeight,
 		CMP_COLOR out[], const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE],
 		ASTC_Encoder::ASTC_Encode *codec);
 
-	static void DecompressBlock(astc_codec_image_cpu *img, CMP_COLOR out[],
+	static void DecompressBlock(BYTE BlockWidth, BYTE BlockHeight, BYTE *out,
+		ptrdiff_t pitch, int x, int y, int width, int height,
 		const BYTE in[ASTC_COMPRESSED_BLOCK_SIZE],
-		ASTC_Encoder::ASTC_Encode *codec);
+		ASTC_Encoder::ASTC_Encode *codec, const texel_layout_cpu *layout);
 };
 
 #endif
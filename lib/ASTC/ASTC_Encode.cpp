@@ -29,18 +29,63 @@
 #include "ASTC_Encode_Kernel.h"
 #include "ASTC_Host.h"
 
-void ASTCBlockEncoder::CompressBlock_kernel(astc_codec_image *input_image,
-	uint8_t *bp, int x, int y, ASTC_Encoder::ASTC_Encode *ASTCEncode,
+#include <cassert>
+
+void ASTCBlockEncoder::CompressBlock_kernel(
+	const image_source_cpu *input_image, uint8_t *bp, int x, int y, int z,
+	ASTC_Encoder::ASTC_Encode *ASTCEncode,
 	ASTC_Encoder::compress_symbolic_block_buffers *buffers)
 {
 	imageblock_cpu m_pb;
 	symbolic_compressed_block scb;
+	ASTCEncodeStats *stats = buffers->stats;
+	ASTC_Encoder::encode_stats_timer timer(stats);
+
+	ASTCBlockCosts *costs = buffers->costs;
+	std::chrono::steady_clock::time_point begin;
+	uint64_t trials = 0;
+	if (costs)
+	{
+		assert(stats);
+		begin = std::chrono::steady_clock::now();
+		trials = stats->trials;
+	}
 
-	fetch_imageblock_cpu(input_image, &m_pb, x, y, 0, ASTCEncode);
+	fetch_imageblock_source_cpu(input_image, &m_pb, x, y, z, ASTCEncode);
+	timer.mark(ASTC_STAGE_FETCH);
 
-	ASTC_Encoder::compress_symbolic_block(&m_pb, &scb, ASTCEncode, buffers);
+	float error = ASTC_Encoder::compress_symbolic_block(
+		&m_pb, &scb, ASTCEncode, buffers);
+	timer.restart();
 	physical_compressed_block pcb;
 	pcb = ASTC_Encoder::symbolic_to_physical(&scb, ASTCEncode);
 
 	*(physical_compressed_block *) bp = pcb;
+	timer.mark(ASTC_STAGE_PACK);
+
+	if (stats)
+	{
+		stats->blocks++;
+		stats->partitionCounts[scb.partition_count]++;
+		if (scb.block_mode >= 0)
+		{
+			stats->blockModes[scb.block_mode]++;
+			if (ASTCEncode->bsd->block_modes[scb.block_mode].is_dual_plane)
+				stats->dualPlaneBlocks++;
+		}
+	}
+
+	if (costs)
+	{
+		// Workers write elements of their own blocks only
+		size_t column = x / ASTCEncode->m_xdim;
+		size_t row = y / ASTCEncode->m_ydim;
+		size_t layer = z / ASTCEncode->m_zdim;
+		size_t index = (layer * costs->rows + row) * costs->columns + column;
+		std::chrono::duration<float> elapsed =
+			std::chrono::steady_clock::now() - begin;
+		costs->seconds[index] = elapsed.count();
+		costs->trials[index] = uint32_t(stats->trials - trials);
+		costs->errors[index] = error;
+	}
 }
@@ -28,12 +28,15 @@
 #include "ASTC/ARM/astc_codec_internals.h"
 #include "ASTC_Encode_Kernel.h"
 
+struct image_source_cpu;
+
 class ASTCBlockEncoder
 {
 public:
 	// This routine compresses a block and returns the RMS error
-	static void CompressBlock_kernel(astc_codec_image *input_image, uint8_t *bp,
-		int x, int y, ASTC_Encoder::ASTC_Encode *ASTCEncode,
+	static void CompressBlock_kernel(const image_source_cpu *input_image,
+		uint8_t *bp, int x, int y, int z,
+		ASTC_Encoder::ASTC_Encode *ASTCEncode,
 		ASTC_Encoder::compress_symbolic_block_buffers *buffers);
 };
 
@@ -2171,7 +2171,7 @@ static float prepare_error_weight_block(imageblock *blk,
 {
 	DEBUG("prepare_error_weight_block");
 
-	unsigned int x, y;
+	unsigned int x, y, z;
 	int idx = 0;
 
 	int any_mean_stdev_weight = ASTCEncode->m_ewp.rgb_base_weight != 1.0 ||
@@ -2188,18 +2188,15 @@ static float prepare_error_weight_block(imageblock *blk,
 	ewb->contains_zeroweight_texels = 0;
 	float4 normals = { 1.0f, 1.0f, 1.0f, 1.0f };
 
-#ifdef ENABLE_3D_SUPPORT
-	for (int z = 0; z < ASTCEncode->m_zdim; z++)
-#endif
+	for (z = 0; z < ASTCEncode->m_zdim; z++)
+	{
 		for (y = 0; y < ASTCEncode->m_ydim; y++)
+		{
 			for (x = 0; x < ASTCEncode->m_xdim; x++, idx++)
 			{
 				if (blk->xpos + int(x) >= blk->xsize ||
-					blk->ypos + int(y) >= blk->ysize
-#ifdef ENABLE_3D_SUPPORT
-					|| blk->zpos + int(z) >= blk->zsize
-#endif
-				)
+					blk->ypos + int(y) >= blk->ysize ||
+					blk->zpos + int(z) >= blk->zsize)
 				{
 					float4 weights =
 						float4(FLOAT_n11, FLOAT_n11, FLOAT_n11, FLOAT_n11);
@@ -2358,11 +2355,24 @@ static float prepare_error_weight_block(imageblock *blk,
                         printf("--> %f %f %f %f\n", error_weight.x, error_weight.y, error_weight.z, error_weight.w );
                     */
 
+				// the color of a fully transparent texel is never visible,
+				// so only its alpha needs to be matched.
+				if (ASTCEncode->m_ignore_transparent_rgb &&
+					blk->orig_data[4 * idx + 3] <= 0.0f)
+				{
+					error_weight.x = FLOAT_n11;
+					error_weight.y = FLOAT_n11;
+					error_weight.z = FLOAT_n11;
+					ewb->contains_zeroweight_texels = 1;
+				}
+
 				ewb->error_weights[idx] = error_weight;
 				float res = dot(error_weight, normals);
 				if (res < FLOAT_n10)
 					ewb->contains_zeroweight_texels = 1;
 			}
+		}
+	}
 
 	int i;
 
@@ -9798,6 +9808,47 @@ uint16_t lns_to_sf16(uint16_t p)
 	return res;
 }
 
+// sRGB transfer function tables, built once at startup so that the
+// conversions cost a lookup per channel.
+struct srgb_tables
+{
+	uint16_t linear_sf16[256]; // sRGB byte -> linear FP16
+	float srgb[4096]; // linear value in 1/4095 steps -> sRGB
+
+	srgb_tables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			c = c <= 0.04045f ? c / 12.92f
+							  : float(pow((c + 0.055f) / 1.055f, 2.4f));
+			linear_sf16[i] = float_to_sf16(c, SF_NEARESTEVEN);
+		}
+
+		for (int i = 0; i < 4096; i++)
+		{
+			float c = i / 4095.0f;
+			srgb[i] = c <= 0.0031308f
+				? c * 12.92f
+				: float(1.055f * pow(c, 1.0f / 2.4f) - 0.055f);
+		}
+	}
+};
+
+static const srgb_tables srgb_table;
+
+uint16_t srgb8_to_linear_sf16(uint8_t p)
+{
+	return srgb_table.linear_sf16[p];
+}
+
+float linear_to_srgb(float p)
+{
+	// NaN fails the first comparison
+	p = p > 0.0f ? MIN(p, 1.0f) : 0.0f;
+	return srgb_table.srgb[int(p * 4095.0f + 0.5f)];
+}
+
 // helper function to initialize the orig-data from the work-data
 static void imageblock_initialize_orig_from_work(
 	imageblock *blk, int pixelcount)
@@ -9836,6 +9887,104 @@ static void imageblock_initialize_orig_from_work(
 	imageblock_initialize_deriv_from_work_and_orig(blk, pixelcount);
 }
 
+// Interpolates the endpoint colors of a block with regular block mode.
+// Texel colors are left as 16-bit UNORM or LNS values, told apart by the
+// rgb_lns and alpha_lns flags.
+static void decode_symbolic_block_texels(symbolic_compressed_block *scb,
+	ushort4 *colors, uint8_t *rgb_lns, uint8_t *alpha_lns, uint8_t *nan_texel,
+	ASTC_Encode *ASTCEncode)
+{
+	int i;
+
+	// get the appropriate partition-table entry
+	int partition_count = scb->partition_count;
+
+	// get the appropriate block descriptor
+	int is_dual_plane =
+		ASTCEncode->bsd->block_modes[scb->block_mode].is_dual_plane;
+	int weight_quantization_level =
+		ASTCEncode->bsd->block_modes[scb->block_mode].quantization_mode;
+
+	// decode the color endpoints
+	ushort4 color_endpoint0[4];
+	ushort4 color_endpoint1[4];
+	int rgb_hdr_endpoint[4];
+	int alpha_hdr_endpoint[4];
+	int nan_endpoint[4];
+
+	for (i = 0; i < partition_count; i++)
+		unpack_color_endpoints(scb->color_formats[i],
+			scb->color_quantization_level, scb->color_values[i],
+			&(rgb_hdr_endpoint[i]), &(alpha_hdr_endpoint[i]),
+			&(nan_endpoint[i]), &(color_endpoint0[i]), &(color_endpoint1[i]),
+			ASTCEncode);
+
+	// first unquantize the weights
+	int uq_plane1_weights[MAX_WEIGHTS_PER_BLOCK];
+	int uq_plane2_weights[MAX_WEIGHTS_PER_BLOCK];
+	int weight_count =
+		ASTCEncode->bsd
+			->decimation_tables[ASTCEncode->bsd->block_modes[scb->block_mode]
+									.decimation_mode]
+			.num_weights;
+
+	const quantization_and_transfer_table *qat =
+		&(quant_and_xfer_tables[weight_quantization_level]);
+
+	for (i = 0; i < weight_count; i++)
+	{
+		uq_plane1_weights[i] = qat->unquantized_value[scb->plane1_weights[i]];
+	}
+	if (is_dual_plane)
+	{
+		for (i = 0; i < weight_count; i++)
+			uq_plane2_weights[i] =
+				qat->unquantized_value[scb->plane2_weights[i]];
+	}
+
+	// then un-decimate them.
+	int weights[MAX_TEXELS_PER_BLOCK];
+	int plane2_weights[MAX_TEXELS_PER_BLOCK];
+
+	for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
+		weights[i] = compute_value_of_texel_global(i,
+			&ASTCEncode->bsd
+				 ->decimation_tables[ASTCEncode->bsd
+										 ->block_modes[scb->block_mode]
+										 .decimation_mode],
+			uq_plane1_weights);
+
+	if (is_dual_plane)
+		for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
+			plane2_weights[i] = compute_value_of_texel_global(i,
+				&ASTCEncode->bsd
+					 ->decimation_tables[ASTCEncode->bsd
+											 ->block_modes[scb->block_mode]
+											 .decimation_mode],
+				uq_plane2_weights);
+
+	int plane2_color_component = scb->plane2_color_component;
+
+	// now that we have endpoint colors and weights, we can unpack actual colors for
+	// each texel.
+	for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
+	{
+		int partition =
+			ASTCEncode->partition_tables[partition_count][scb->partition_index]
+				.partition_of_texel[i];
+		if (partition > 3)
+			partition = 3;
+
+		colors[i] = COMPUTE_LRP_COLOR(color_endpoint0[partition],
+			color_endpoint1[partition], weights[i], plane2_weights[i],
+			is_dual_plane ? plane2_color_component : -1, ASTCEncode);
+
+		rgb_lns[i] = (uint8_t) rgb_hdr_endpoint[partition];
+		alpha_lns[i] = (uint8_t) alpha_hdr_endpoint[partition];
+		nan_texel[i] = (uint8_t) nan_endpoint[partition];
+	}
+}
+
 void decompress_symbolic_block(
 	symbolic_compressed_block *scb, imageblock *blk, ASTC_Encode *ASTCEncode)
 {
@@ -9949,103 +10098,218 @@ void decompress_symbolic_block(
 		return;
 	}
 
-	// get the appropriate partition-table entry
-	int partition_count = scb->partition_count;
+	ushort4 colors[MAX_TEXELS_PER_BLOCK];
+	decode_symbolic_block_texels(scb, colors, blk->rgb_lns, blk->alpha_lns,
+		blk->nan_texel, ASTCEncode);
 
-	// get the appropriate block descriptor
-	int is_dual_plane =
-		ASTCEncode->bsd->block_modes[scb->block_mode].is_dual_plane;
-	int weight_quantization_level =
-		ASTCEncode->bsd->block_modes[scb->block_mode].quantization_mode;
+	for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
+	{
+		blk->work_data[4 * i] = colors[i].x;
+		blk->work_data[4 * i + 1] = colors[i].y;
+		blk->work_data[4 * i + 2] = colors[i].z;
+		blk->work_data[4 * i + 3] = colors[i].w;
+	}
 
-	// decode the color endpoints
-	ushort4 color_endpoint0[4];
-	ushort4 color_endpoint1[4];
-	int rgb_hdr_endpoint[4];
-	int alpha_hdr_endpoint[4];
-	int nan_endpoint[4];
+	imageblock_initialize_orig_from_work(blk, ASTCEncode->m_texels_per_block);
 
-	for (i = 0; i < partition_count; i++)
-		unpack_color_endpoints(scb->color_formats[i],
-			scb->color_quantization_level, scb->color_values[i],
-			&(rgb_hdr_endpoint[i]), &(alpha_hdr_endpoint[i]),
-			&(nan_endpoint[i]), &(color_endpoint0[i]), &(color_endpoint1[i]),
-			ASTCEncode);
+	update_imageblock_flags(blk, ASTCEncode);
+}
 
-	// first unquantize the weights
-	int uq_plane1_weights[MAX_WEIGHTS_PER_BLOCK];
-	int uq_plane2_weights[MAX_WEIGHTS_PER_BLOCK];
-	int weight_count =
-		ASTCEncode->bsd
-			->decimation_tables[ASTCEncode->bsd->block_modes[scb->block_mode]
-									.decimation_mode]
-			.num_weights;
+void decompress_symbolic_block_sf16(
+	symbolic_compressed_block *scb, uint16_t *texels, ASTC_Encode *ASTCEncode)
+{
+	DEBUG("decompress_symbolic_block_sf16");
+	int i;
 
-	const quantization_and_transfer_table *qat =
-		&(quant_and_xfer_tables[weight_quantization_level]);
+	// sRGB colors are 8-bit values, converted to linear
+	int srgb = ASTCEncode->m_decode_mode == ASTC_DECODE_LDR_SRGB;
 
-	for (i = 0; i < weight_count; i++)
+	// magenta, as the 8-bit decoder shows NaN texels
+	static const uint16_t error_color[4] = { 0x3C00, 0, 0x3C00, 0x3C00 };
+	uint16_t constant_color[4];
+	const uint16_t *fill = NULL;
+
+	if (scb->error_block)
 	{
-		uq_plane1_weights[i] = qat->unquantized_value[scb->plane1_weights[i]];
+		fill = error_color;
+	} else if (scb->block_mode == -2)
+	{
+		// For sRGB decoding, we should return only the top 8 bits.
+		int mask = srgb ? 0xFF00 : 0xFFFF;
+
+		for (i = 0; i < 4; i++)
+		{
+			uint16_t c = (uint16_t) scb->constant_color[i] & mask;
+			constant_color[i] = srgb && i < 3
+				? srgb8_to_linear_sf16(uint8_t(c >> 8))
+				: unorm16_to_sf16(c);
+		}
+		fill = constant_color;
+	} else if (scb->block_mode < 0)
+	{
+		// constant-color block already stored as FP16
+		if (ASTCEncode->m_decode_mode != ASTC_DECODE_HDR)
+		{
+			fill = error_color;
+		} else
+		{
+			for (i = 0; i < 4; i++)
+				constant_color[i] = (uint16_t) scb->constant_color[i];
+			fill = constant_color;
+		}
 	}
-	if (is_dual_plane)
+
+	if (fill)
 	{
-		for (i = 0; i < weight_count; i++)
-			uq_plane2_weights[i] =
-				qat->unquantized_value[scb->plane2_weights[i]];
+		for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
+		{
+			texels[4 * i] = fill[0];
+			texels[4 * i + 1] = fill[1];
+			texels[4 * i + 2] = fill[2];
+			texels[4 * i + 3] = fill[3];
+		}
+		return;
 	}
 
-	// then un-decimate them.
-	int weights[MAX_TEXELS_PER_BLOCK];
-	int plane2_weights[MAX_TEXELS_PER_BLOCK];
+	ushort4 colors[MAX_TEXELS_PER_BLOCK];
+	uint8_t rgb_lns[MAX_TEXELS_PER_BLOCK];
+	uint8_t alpha_lns[MAX_TEXELS_PER_BLOCK];
+	uint8_t nan_texel[MAX_TEXELS_PER_BLOCK];
+	decode_symbolic_block_texels(
+		scb, colors, rgb_lns, alpha_lns, nan_texel, ASTCEncode);
 
 	for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
-		weights[i] = compute_value_of_texel_global(i,
-			&ASTCEncode->bsd
-				 ->decimation_tables[ASTCEncode->bsd
-										 ->block_modes[scb->block_mode]
-										 .decimation_mode],
-			uq_plane1_weights);
+	{
+		uint16_t *out = texels + 4 * i;
+		if (nan_texel[i])
+		{
+			out[0] = error_color[0];
+			out[1] = error_color[1];
+			out[2] = error_color[2];
+			out[3] = error_color[3];
+			continue;
+		}
 
-	if (is_dual_plane)
-		for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
-			plane2_weights[i] = compute_value_of_texel_global(i,
-				&ASTCEncode->bsd
-					 ->decimation_tables[ASTCEncode->bsd
-											 ->block_modes[scb->block_mode]
-											 .decimation_mode],
-				uq_plane2_weights);
+		if (rgb_lns[i])
+		{
+			out[0] = lns_to_sf16(colors[i].x);
+			out[1] = lns_to_sf16(colors[i].y);
+			out[2] = lns_to_sf16(colors[i].z);
+		} else if (srgb)
+		{
+			out[0] = srgb8_to_linear_sf16(uint8_t(colors[i].x >> 8));
+			out[1] = srgb8_to_linear_sf16(uint8_t(colors[i].y >> 8));
+			out[2] = srgb8_to_linear_sf16(uint8_t(colors[i].z >> 8));
+		} else
+		{
+			out[0] = unorm16_to_sf16(colors[i].x);
+			out[1] = unorm16_to_sf16(colors[i].y);
+			out[2] = unorm16_to_sf16(colors[i].z);
+		}
 
-	int plane2_color_component = scb->plane2_color_component;
+		out[3] = alpha_lns[i] ? lns_to_sf16(colors[i].w)
+							  : unorm16_to_sf16(colors[i].w);
+	}
+}
 
-	// now that we have endpoint colors and weights, we can unpack actual colors for
-	// each texel.
-	ushort4 color;
-	for (i = 0; i < ASTCEncode->m_texels_per_block; i++)
+// Computes an approximate average color of a block without per-texel infill.
+// Each partition is represented by its endpoints interpolated with the
+// average grid weight and contributes in proportion to its texel count.
+// The result is clamped to [0,1] like the RGBA8 output of the decoder.
+void decompress_symbolic_block_average(
+	symbolic_compressed_block *scb, float color[4], ASTC_Encode *ASTCEncode)
+{
+	DEBUG("decompress_symbolic_block_average");
+	int i, j;
+
+	imageblock blk;
+	int partition_count = 1;
+	int texels_per_partition[4] = { 1, 0, 0, 0 };
+	int texel_count = 1;
+
+	if (scb->error_block || scb->block_mode < 0)
 	{
-		int partition =
-			ASTCEncode->partition_tables[partition_count][scb->partition_index]
-				.partition_of_texel[i];
-		if (partition > 3)
-			partition = 3;
+		// constant and error blocks are cheap to expand fully
+		decompress_symbolic_block(scb, &blk, ASTCEncode);
+	} else
+	{
+		partition_count = scb->partition_count;
 
-		color = COMPUTE_LRP_COLOR(color_endpoint0[partition],
-			color_endpoint1[partition], weights[i], plane2_weights[i],
-			is_dual_plane ? plane2_color_component : -1, ASTCEncode);
+		int is_dual_plane =
+			ASTCEncode->bsd->block_modes[scb->block_mode].is_dual_plane;
+		int weight_quantization_level =
+			ASTCEncode->bsd->block_modes[scb->block_mode].quantization_mode;
+		int weight_count =
+			ASTCEncode->bsd
+				->decimation_tables[ASTCEncode->bsd->block_modes[scb->block_mode]
+										.decimation_mode]
+				.num_weights;
+
+		const quantization_and_transfer_table *qat =
+			&(quant_and_xfer_tables[weight_quantization_level]);
+
+		// infill preserves the average, so average the grid weights directly
+		int plane1_sum = 0;
+		int plane2_sum = 0;
+		for (i = 0; i < weight_count; i++)
+		{
+			plane1_sum += qat->unquantized_value[scb->plane1_weights[i]];
+			if (is_dual_plane)
+				plane2_sum += qat->unquantized_value[scb->plane2_weights[i]];
+		}
+		int plane1_weight = (plane1_sum + weight_count / 2) / weight_count;
+		int plane2_weight = (plane2_sum + weight_count / 2) / weight_count;
+
+		const partition_info *pt =
+			&ASTCEncode
+				 ->partition_tables[partition_count][scb->partition_index];
+
+		texel_count = 0;
+		for (i = 0; i < partition_count; i++)
+		{
+			ushort4 color_endpoint0;
+			ushort4 color_endpoint1;
+			int rgb_hdr_endpoint;
+			int alpha_hdr_endpoint;
+			int nan_endpoint;
+
+			unpack_color_endpoints(scb->color_formats[i],
+				scb->color_quantization_level, scb->color_values[i],
+				&rgb_hdr_endpoint, &alpha_hdr_endpoint, &nan_endpoint,
+				&color_endpoint0, &color_endpoint1, ASTCEncode);
 
-		blk->rgb_lns[i] = (uint8_t) rgb_hdr_endpoint[partition];
-		blk->alpha_lns[i] = (uint8_t) alpha_hdr_endpoint[partition];
-		blk->nan_texel[i] = (uint8_t) nan_endpoint[partition];
+			ushort4 lrp_color = COMPUTE_LRP_COLOR(color_endpoint0,
+				color_endpoint1, plane1_weight, plane2_weight,
+				is_dual_plane ? scb->plane2_color_component : -1, ASTCEncode);
 
-		blk->work_data[4 * i] = color.x;
-		blk->work_data[4 * i + 1] = color.y;
-		blk->work_data[4 * i + 2] = color.z;
-		blk->work_data[4 * i + 3] = color.w;
+			blk.rgb_lns[i] = (uint8_t) rgb_hdr_endpoint;
+			blk.alpha_lns[i] = (uint8_t) alpha_hdr_endpoint;
+			blk.nan_texel[i] = (uint8_t) nan_endpoint;
+
+			blk.work_data[4 * i] = lrp_color.x;
+			blk.work_data[4 * i + 1] = lrp_color.y;
+			blk.work_data[4 * i + 2] = lrp_color.z;
+			blk.work_data[4 * i + 3] = lrp_color.w;
+
+			texels_per_partition[i] = pt->texels_per_partition[i];
+			texel_count += texels_per_partition[i];
+		}
+
+		imageblock_initialize_orig_from_work(&blk, partition_count);
 	}
 
-	imageblock_initialize_orig_from_work(blk, ASTCEncode->m_texels_per_block);
+	static const float nan_color[4] = { 1.0f, 0.0f, 1.0f, 1.0f };
 
-	update_imageblock_flags(blk, ASTCEncode);
+	color[0] = color[1] = color[2] = color[3] = 0.0f;
+	for (i = 0; i < partition_count; i++)
+	{
+		// NaN-pixel, but we can't display it. Display purple instead.
+		const float *fptr =
+			blk.nan_texel[i] ? nan_color : blk.orig_data + 4 * i;
+		float scale = float(texels_per_partition[i]) / float(texel_count);
+		for (j = 0; j < 4; j++)
+			color[j] += MAX(0.0f, MIN(fptr[j], 1.0f)) * scale;
+	}
 }
 
 static float compute_imageblock_difference(imageblock *p1, imageblock *p2,
@@ -12130,6 +12394,8 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 	endpoints_and_weights eix1[MAX_DECIMATION_MODES];
 	endpoints_and_weights eix2[MAX_DECIMATION_MODES];
 
+	encode_stats_timer timer(buffers->stats);
+
 	float *decimated_weights = buffers->decimated_weights;
 	uint8_t *u8_quantized_decimated_quantized_weights =
 		buffers->u8_quantized_decimated_quantized_weights;
@@ -12137,33 +12403,35 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 	float *flt_quantized_decimated_quantized_weights =
 		buffers->flt_quantized_decimated_quantized_weights;
 
-	if (blk->red_min == blk->red_max && blk->green_min == blk->green_max &&
-		blk->blue_min == blk->blue_max && blk->alpha_min == blk->alpha_max)
+	// a block without any visible texels is encoded as transparent black.
+	int transparent_block =
+		ASTCEncode->m_ignore_transparent_rgb && blk->alpha_max <= 0.0f;
+
+	if (transparent_block ||
+		(blk->red_min == blk->red_max && blk->green_min == blk->green_max &&
+			blk->blue_min == blk->blue_max && blk->alpha_min == blk->alpha_max))
 	{
 		// detected a constant-color block. Encode as FP16 if using HDR
 		scb->error_block = 0;
 
+		float red = transparent_block ? 0.0f : blk->orig_data[0];
+		float green = transparent_block ? 0.0f : blk->orig_data[1];
+		float blue = transparent_block ? 0.0f : blk->orig_data[2];
+		float alpha = transparent_block ? 0.0f : blk->orig_data[3];
+
 		if (ASTCEncode->m_rgb_force_use_of_hdr)
 		{
 			scb->block_mode = -1;
 			scb->partition_count = 0;
-			scb->constant_color[0] =
-				float_to_sf16(blk->orig_data[0], SF_NEARESTEVEN);
-			scb->constant_color[1] =
-				float_to_sf16(blk->orig_data[1], SF_NEARESTEVEN);
-			scb->constant_color[2] =
-				float_to_sf16(blk->orig_data[2], SF_NEARESTEVEN);
-			scb->constant_color[3] =
-				float_to_sf16(blk->orig_data[3], SF_NEARESTEVEN);
+			scb->constant_color[0] = float_to_sf16(red, SF_NEARESTEVEN);
+			scb->constant_color[1] = float_to_sf16(green, SF_NEARESTEVEN);
+			scb->constant_color[2] = float_to_sf16(blue, SF_NEARESTEVEN);
+			scb->constant_color[3] = float_to_sf16(alpha, SF_NEARESTEVEN);
 		} else
 		{
 			// Encode as UNORM16 if NOT using HDR.
 			scb->block_mode = -2;
 			scb->partition_count = 0;
-			float red = blk->orig_data[0];
-			float green = blk->orig_data[1];
-			float blue = blk->orig_data[2];
-			float alpha = blk->orig_data[3];
 			if (red < 0)
 				red = 0;
 			else if (red > 1)
@@ -12185,6 +12453,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 			scb->constant_color[2] = (int) floor(blue * 65535.0f + 0.5f);
 			scb->constant_color[3] = (int) floor(alpha * 65535.0f + 0.5f);
 		}
+		timer.exit(ASTC_STAGE_PREPARE, ASTC_EXIT_CONSTANT);
 		return 0.0f;
 	}
 
@@ -12199,6 +12468,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 
 	int uses_alpha = imageblock_uses_alpha1(blk);
 	float mode_cutoff = ASTCEncode->m_ewp.block_mode_cutoff;
+	timer.mark(ASTC_STAGE_PREPARE);
 
 	// next, test mode #0. This mode uses 1 plane of weights and 1 partition.
 	// we test it twice, first with a modecutoff of 0, then with the specified mode-cutoff.
@@ -12222,6 +12492,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 			u8_quantized_decimated_quantized_weights,
 			decimated_quantized_weights,
 			flt_quantized_decimated_quantized_weights, ASTCEncode);
+		timer.trial();
 		best_errorval_in_mode = FLOAT_30;
 
 		for (j = 0; j < 4; j++)
@@ -12230,6 +12501,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 				continue;
 
 			decompress_symbolic_block(tempblocks + j, &temp, ASTCEncode);
+			timer.decode();
 			float errorval =
 				compute_imageblock_difference(blk, &temp, &ewb, ASTCEncode) *
 				errorval_mult[i];
@@ -12247,15 +12519,19 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 		if ((error_of_best_block / error_weight_sum) <
 			ASTCEncode->m_ewp.texel_avg_error_limit)
 		{
+			timer.exit(ASTC_STAGE_MODE_0, ASTC_EXIT_MODE_0);
 			// mean squared error per color component.
 			return (error_of_best_block / ASTCEncode->m_texels_per_block);
 		}
 	}
 
+	timer.mark(ASTC_STAGE_MODE_0);
+
 	int is_normal_map;
 	float lowest_correl;
 	prepare_block_statistics(
 		blk, &ewb, &is_normal_map, &lowest_correl, ASTCEncode);
+	timer.mark(ASTC_STAGE_PREPARE);
 
 	if (is_normal_map && lowest_correl < 0.99f)
 		lowest_correl = 0.99f;
@@ -12281,6 +12557,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 			u8_quantized_decimated_quantized_weights,
 			decimated_quantized_weights,
 			flt_quantized_decimated_quantized_weights, ASTCEncode);
+		timer.trial();
 
 		best_errorval_in_mode = FLOAT_30;
 		for (j = 0; j < 4; j++)
@@ -12288,6 +12565,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 			if (tempblocks[j].error_block)
 				continue;
 			decompress_symbolic_block(tempblocks + j, &temp, ASTCEncode);
+			timer.decode();
 			float errorval =
 				compute_imageblock_difference(blk, &temp, &ewb, ASTCEncode);
 			if (errorval < best_errorval_in_mode)
@@ -12305,11 +12583,14 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 		if ((error_of_best_block / error_weight_sum) <
 			ASTCEncode->m_ewp.texel_avg_error_limit)
 		{
+			timer.exit(ASTC_STAGE_2_PLANES, ASTC_EXIT_2_PLANES);
 			// mean squared error per color component.
 			return (error_of_best_block / ASTCEncode->m_texels_per_block);
 		}
 	}
 
+	timer.mark(ASTC_STAGE_2_PLANES);
+
 	// find best blocks for 2, 3 and 4 partitions
 	int partition_count;
 	int max_partitions = 2;
@@ -12328,10 +12609,12 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 		int partition_indices_1plane[2];
 		int partition_indices_2planes[2];
 
+		timer.mark(ASTC_STAGE_PARTITIONS);
 		find_best_partitionings(ASTCEncode->m_ewp.partition_search_limit,
 			partition_count, blk, &ewb, 1, &(partition_indices_1plane[0]),
 			&(partition_indices_1plane[1]), &(partition_indices_2planes[0]),
 			ASTCEncode);
+		timer.mark(ASTC_STAGE_PARTITION_SEARCH);
 
 		for (i = 0; i < 2; i++)
 		{
@@ -12341,6 +12624,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 				decimated_weights, u8_quantized_decimated_quantized_weights,
 				decimated_quantized_weights,
 				flt_quantized_decimated_quantized_weights, ASTCEncode);
+			timer.trial();
 
 			best_errorval_in_mode = FLOAT_30;
 			for (j = 0; j < 4; j++)
@@ -12348,6 +12632,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 				if (tempblocks[j].error_block)
 					continue;
 				decompress_symbolic_block(tempblocks + j, &temp, ASTCEncode);
+				timer.decode();
 				float errorval =
 					compute_imageblock_difference(blk, &temp, &ewb, ASTCEncode);
 				if (errorval < best_errorval_in_mode)
@@ -12366,6 +12651,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 			if ((error_of_best_block / error_weight_sum) <
 				ASTCEncode->m_ewp.texel_avg_error_limit)
 			{
+				timer.exit(ASTC_STAGE_PARTITIONS, ASTC_EXIT_PARTITIONS);
 				// mean squared error per color component.
 				return (error_of_best_block / ASTCEncode->m_texels_per_block);
 			}
@@ -12376,6 +12662,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 				(best_errorvals_in_modes[0] *
 					ASTCEncode->m_ewp.partition_1_to_2_limit))
 		{
+			timer.exit(ASTC_STAGE_PARTITIONS, ASTC_EXIT_PARTITION_1_TO_2);
 			// mean squared error per color component.
 			return (error_of_best_block / ASTCEncode->m_texels_per_block);
 		}
@@ -12397,6 +12684,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 				u8_quantized_decimated_quantized_weights,
 				decimated_quantized_weights,
 				flt_quantized_decimated_quantized_weights, ASTCEncode);
+			timer.trial();
 
 			best_errorval_in_mode = FLOAT_30;
 			for (j = 0; j < 4; j++)
@@ -12404,6 +12692,7 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 				if (tempblocks[j].error_block)
 					continue;
 				decompress_symbolic_block(tempblocks + j, &temp, ASTCEncode);
+				timer.decode();
 
 				float errorval =
 					compute_imageblock_difference(blk, &temp, &ewb, ASTCEncode);
@@ -12424,12 +12713,14 @@ float compress_symbolic_block(imageblock *blk, symbolic_compressed_block *scb,
 			if ((error_of_best_block / error_weight_sum) <
 				ASTCEncode->m_ewp.texel_avg_error_limit)
 			{
+				timer.exit(ASTC_STAGE_PARTITIONS, ASTC_EXIT_PARTITIONS);
 				// mean squared error per color component.
 				return (error_of_best_block / ASTCEncode->m_texels_per_block);
 			}
 		}
 	}
 
+	timer.exit(ASTC_STAGE_PARTITIONS, ASTC_EXIT_END);
 	// mean squared error per color component.
 	return (error_of_best_block / ASTCEncode->m_texels_per_block);
 }
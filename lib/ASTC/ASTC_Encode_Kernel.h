@@ -19,6 +19,9 @@
 //===========================================================================
 
 #include "ARM/astc_codec_internals.h"
+#include "ASTC_Stats.h"
+
+#include <chrono>
 
 struct Vec4uc
 {
@@ -125,8 +128,6 @@ extern const int steps_of_level[];
 #define COVERAGE_BITMAPS_MAX 32
 #endif
 
-// #define ASTC_ENABLE_3D_SUPPORT     : Incomplete code do not enable!
-
 #define FLOAT_n4 1e-4f
 #define FLOAT_n7 1e-7f
 #define FLOAT_n10 1e-10f
@@ -276,6 +277,7 @@ typedef struct
 	int m_rgb_force_use_of_hdr;
 	int m_alpha_force_use_of_hdr;
 	int m_perform_srgb_transform;
+	int m_ignore_transparent_rgb; // RGB of texels with zero alpha is don't-care
 	int m_texels_per_block; //
 	unsigned int m_width_in_blocks; //
 	unsigned int m_height_in_blocks; //
@@ -297,6 +299,63 @@ struct compress_symbolic_block_buffers
 		MAX_WEIGHTS_PER_BLOCK];
 	float flt_quantized_decimated_quantized_weights[2 * MAX_WEIGHT_MODES *
 		MAX_WEIGHTS_PER_BLOCK];	
+	// Statistics of the worker owning the buffers, nullptr when disabled
+	ASTCEncodeStats *stats = nullptr;
+	// Costs of every block of the image, shared by all workers. Statistics
+	// are required with them, trials are counted there.
+	ASTCBlockCosts *costs = nullptr;
+};
+
+// Adds the time since the previous mark to a stage of the statistics.
+// Does nothing without statistics.
+class encode_stats_timer
+{
+public:
+	explicit encode_stats_timer(ASTCEncodeStats *stats)
+		: stats(stats)
+	{
+		restart();
+	}
+
+	void restart()
+	{
+		if (stats)
+			last = std::chrono::steady_clock::now();
+	}
+
+	void mark(ASTCEncodeStage stage)
+	{
+		if (!stats)
+			return;
+
+		auto now = std::chrono::steady_clock::now();
+		stats->stageSeconds[stage] +=
+			std::chrono::duration<double>(now - last).count();
+		last = now;
+	}
+
+	void exit(ASTCEncodeStage stage, ASTCEncodeExit reason)
+	{
+		mark(stage);
+		if (stats)
+			stats->exits[reason]++;
+	}
+
+	void trial()
+	{
+		if (stats)
+			stats->trials++;
+	}
+
+	void decode()
+	{
+		if (stats)
+			stats->decodes++;
+	}
+
+private:
+	ASTCEncodeStats *stats;
+	std::chrono::steady_clock::time_point last;
 };
 
 extern void imageblock_initialize_work_from_orig(
@@ -308,6 +367,15 @@ void update_imageblock_flags(imageblock *pb, ASTC_Encode *ASTC_Encode);
 extern void decompress_symbolic_block(
 	symbolic_compressed_block *scb, imageblock *blk, ASTC_Encode *ASTCEncode);
 
+// Decodes the texels of a block straight to FP16 R, G, B, A values,
+// without the float image block used by the encoder. Colors of the sRGB
+// decode mode are converted to linear, as sampling on a GPU would.
+extern void decompress_symbolic_block_sf16(
+	symbolic_compressed_block *scb, uint16_t *texels, ASTC_Encode *ASTCEncode);
+
+extern void decompress_symbolic_block_average(
+	symbolic_compressed_block *scb, float color[4], ASTC_Encode *ASTCEncode);
+
 extern float compress_symbolic_block(
 	imageblock *blk, symbolic_compressed_block *scb, ASTC_Encode *ASTCEncode,
 		compress_symbolic_block_buffers *buffers);
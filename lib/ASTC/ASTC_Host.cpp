@@ -17,6 +17,7 @@
 
 #include "ASTC_Host.h"
 #include "ASTC_Encode_Kernel.h"
+#include "ASTC_Trace.h"
 #include "ARM/softfloat.h"
 
 #include <iostream>
@@ -29083,9 +29084,7 @@ static float c_stepsizes_sqr[ANGULAR_STEPS];
 static int c_max_angular_steps_needed_for_quant_level[13];
 
 
-#ifdef ASTC_ENABLE_3D_SUPPORT
-// These functions use new () and should either be in CPU or changed to share a pre allocated pointer
-void initialize_decimation_table_3d(
+static void initialize_decimation_table_3d_cpu(
 	// dimensions of the block
 	int xdim, int ydim, int zdim,
 	// number of grid points in 3d weight grid
@@ -29288,7 +29287,8 @@ void initialize_decimation_table_3d(
 	dt->num_weights = weights_per_block;
 }
 
-int decode_block_mode_3d(int blockmode, int *Nval, int *Mval, int *Qval,
+// return 0 on invalid mode, 1 on valid mode.
+static int decode_block_mode_3d(int blockmode, int *Nval, int *Mval, int *Qval,
 	int *dual_weight_plane, int *quant_mode)
 {
 	int base_quant_mode = (blockmode >> 4) & 1;
@@ -29375,8 +29375,9 @@ int decode_block_mode_3d(int blockmode, int *Nval, int *Mval, int *Qval,
 	return 1;
 }
 
-// stubbed for the time being.
-const float *get_3d_percentile_table_host(
+// There is no measured percentile table for 3D block sizes, so every
+// block mode is considered by the search.
+static const float *get_3d_percentile_table_host(
 	int blockdim_x, int blockdim_y, int blockdim_z)
 {
 	IGNOREPARAM(blockdim_x);
@@ -29385,8 +29386,8 @@ const float *get_3d_percentile_table_host(
 	return dummy_percentile_table_3d;
 }
 
-void construct_block_size_descriptor_3d_host(
-	int xdim, int ydim, int zdim, block_size_descriptor *bsd)
+static void construct_block_size_descriptor_3d_cpu(
+	int xdim, int ydim, int zdim, block_size_descriptor_cpu *bsd)
 {
 	int decimation_mode_index
 		[512]; // for each of the 512 entries in the decim_table_array, its index
@@ -29396,6 +29397,7 @@ void construct_block_size_descriptor_3d_host(
 	int x_weights;
 	int y_weights;
 	int z_weights;
+	int texels_per_block = xdim * ydim * zdim;
 
 	for (i = 0; i < 512; i++)
 	{
@@ -29407,16 +29409,15 @@ void construct_block_size_descriptor_3d_host(
 		for (y_weights = 2; y_weights <= 6; y_weights++)
 			for (z_weights = 2; z_weights <= 6; z_weights++)
 			{
-				if ((x_weights * y_weights * z_weights) > MAX_WEIGHTS_PER_BLOCK)
+				int weight_count = x_weights * y_weights * z_weights;
+				if (weight_count > MAX_WEIGHTS_PER_BLOCK)
 					continue;
-				decimation_table dt;
+				auto &dt = bsd->decimation_tables[decimation_mode_count];
 				decimation_mode_index[z_weights * 64 + y_weights * 8 +
 					x_weights] = decimation_mode_count;
-				initialize_decimation_table_3d(
+				initialize_decimation_table_3d_cpu(
 					xdim, ydim, zdim, x_weights, y_weights, z_weights, &dt);
 
-				int weight_count = x_weights * y_weights * z_weights;
-
 				int maxprec_1plane = -1;
 				int maxprec_2planes = -1;
 				for (i = 0; i < 12; i++)
@@ -29432,6 +29433,7 @@ void construct_block_size_descriptor_3d_host(
 						bits_2planes <= MAX_WEIGHT_BITS_PER_BLOCK)
 						maxprec_2planes = i;
 				}
+
 				bsd->permit_encode[decimation_mode_count] =
 					(x_weights <= xdim && y_weights <= ydim &&
 						z_weights <= zdim);
@@ -29442,7 +29444,6 @@ void construct_block_size_descriptor_3d_host(
 					maxprec_1plane;
 				bsd->decimation_mode_maxprec_2planes[decimation_mode_count] =
 					maxprec_2planes;
-				bsd->decimation_tables[decimation_mode_count] = dt;
 
 				decimation_mode_count++;
 			}
@@ -29482,6 +29483,7 @@ void construct_block_size_descriptor_3d_host(
 			fail = 1;
 			permit_encode = 0;
 		}
+
 		if (fail)
 		{
 			bsd->block_modes[i].decimation_mode = -1;
@@ -29494,16 +29496,11 @@ void construct_block_size_descriptor_3d_host(
 		{
 			int decimation_mode = decimation_mode_index[z_weights * 64 +
 				y_weights * 8 + x_weights];
-			bsd->block_modes[i].decimation_mode =
-				(ASTC_Encoder::uint8_t) decimation_mode;
-			bsd->block_modes[i].quantization_mode =
-				(ASTC_Encoder::uint8_t) quantization_mode;
-			bsd->block_modes[i].is_dual_plane =
-				(ASTC_Encoder::uint8_t) is_dual_plane;
-			bsd->block_modes[i].permit_encode =
-				(ASTC_Encoder::uint8_t) permit_encode;
-			bsd->block_modes[i].permit_decode =
-				(ASTC_Encoder::uint8_t) permit_encode;
+			bsd->block_modes[i].decimation_mode = (uint8_t) decimation_mode;
+			bsd->block_modes[i].quantization_mode = (uint8_t) quantization_mode;
+			bsd->block_modes[i].is_dual_plane = (uint8_t) is_dual_plane;
+			bsd->block_modes[i].permit_encode = (uint8_t) permit_encode;
+			bsd->block_modes[i].permit_decode = (uint8_t) permit_encode;
 			bsd->block_modes[i].percentile = percentiles[i];
 
 			if (bsd->decimation_mode_percentile[decimation_mode] >
@@ -29511,28 +29508,50 @@ void construct_block_size_descriptor_3d_host(
 				bsd->decimation_mode_percentile[decimation_mode] =
 					percentiles[i];
 		}
+
+		block_mode_decode &bmd = bsd->block_mode_decodes[i];
+		if (fail || !permit_encode)
+		{
+			bmd.permit_decode = 0;
+			bmd.is_dual_plane = 0;
+			bmd.quantization_mode = 0;
+			bmd.weight_count = 0;
+			bmd.bits_for_weights = 0;
+		} else
+		{
+			int weight_count = x_weights * y_weights * z_weights;
+			bmd.permit_decode = 1;
+			bmd.is_dual_plane = (uint8_t) is_dual_plane;
+			bmd.quantization_mode = (uint8_t) quantization_mode;
+			bmd.weight_count = (uint8_t) weight_count;
+			bmd.bits_for_weights = (uint8_t) compute_ise_bitcount(
+				is_dual_plane ? 2 * weight_count : weight_count,
+				(quantization_method) quantization_mode);
+		}
 	}
 
-	if (xdim * ydim * zdim <= 64)
+	if (texels_per_block <= 64)
 	{
-		bsd->texelcount_for_bitmap_partitioning = xdim * ydim * zdim;
-		for (i = 0; i < xdim * ydim * zdim; i++)
+		bsd->texelcount_for_bitmap_partitioning = texels_per_block;
+		for (i = 0; i < texels_per_block; i++)
 			bsd->texels_for_bitmap_partitioning[i] = i;
 	} else
 	{
 		// pick 64 random texels for use with bitmap partitioning.
 		int arr[MAX_TEXELS_PER_BLOCK];
-		for (i = 0; i < xdim * ydim * zdim; i++)
+		for (i = 0; i < texels_per_block; i++)
 			arr[i] = 0;
 		int arr_elements_set = 0;
+		i = 0;
 		while (arr_elements_set < 64)
 		{
-			int idx = rand() % (xdim * ydim * zdim);
+			int idx = pseudo_random_tbl[i & 255] % texels_per_block;
 			if (arr[idx] == 0)
 			{
 				arr_elements_set++;
 				arr[idx] = 1;
 			}
+			i++;
 		}
 		int texel_weights_written = 0;
 		int idx = 0;
@@ -29546,7 +29565,6 @@ void construct_block_size_descriptor_3d_host(
 		bsd->texelcount_for_bitmap_partitioning = 64;
 	}
 }
-#endif
 
 // return 0 on invalid mode, 1 on valid mode.
 static int decode_block_mode_2d(int blockmode, int *Nval, int *Mval,
@@ -30064,6 +30082,7 @@ static partition_info **c_partition_tables[4096] = {NULL};
 static const partition_info *const * get_partition_tables(
 		 ASTC_Encode *ASTCEncode)
 {
+	ASTCTraceScope trace("get_partition_tables", "init");
 	int xdim = ASTCEncode->m_xdim;
 	int ydim = ASTCEncode->m_ydim;
 	int zdim = ASTCEncode->m_zdim;
@@ -30424,6 +30443,26 @@ static void construct_block_size_descriptor_2d_cpu(
 				bsd->decimation_mode_percentile[decimation_mode] =
 					percentiles[i];
 		}
+
+		block_mode_decode &bmd = bsd->block_mode_decodes[i];
+		if (fail || !permit_encode)
+		{
+			bmd.permit_decode = 0;
+			bmd.is_dual_plane = 0;
+			bmd.quantization_mode = 0;
+			bmd.weight_count = 0;
+			bmd.bits_for_weights = 0;
+		} else
+		{
+			int weight_count = x_weights * y_weights;
+			bmd.permit_decode = 1;
+			bmd.is_dual_plane = (uint8_t) is_dual_plane;
+			bmd.quantization_mode = (uint8_t) quantization_mode;
+			bmd.weight_count = (uint8_t) weight_count;
+			bmd.bits_for_weights = (uint8_t) ASTC_Encoder::compute_ise_bitcount(
+				is_dual_plane ? 2 * weight_count : weight_count,
+				(quantization_method) quantization_mode);
+		}
 	}
 
 	if (xdim * ydim <= 64)
@@ -30478,11 +30517,9 @@ static block_size_descriptor_cpu *get_block_size_descriptor_cpu(
 		std::lock_guard<std::mutex> lock(block_size_descriptor_mutex);
 
 		block_size_descriptor_cpu *bsd = new block_size_descriptor_cpu;
-#ifdef ASTC_ENABLE_3D_SUPPORT
 		if (zdim > 1)
-			construct_block_size_descriptor_3d(xdim, ydim, zdim, bsd);
+			construct_block_size_descriptor_3d_cpu(xdim, ydim, zdim, bsd);
 		else
-#endif
 			construct_block_size_descriptor_2d_cpu(xdim, ydim, bsd);
 
 		bsd_pointers[bsd_index] = bsd;
@@ -30493,218 +30530,10 @@ static block_size_descriptor_cpu *get_block_size_descriptor_cpu(
 static void setup_block_size_descriptor(
 	 ASTC_Encode *ASTCEncode)
 {
-#ifdef ASTC_ENABLE_3D_SUPPORT
-	if (zdim > 1)
-		construct_block_size_descriptor_3d_host(
-			xdim, ydim, zdim, &ASTCEncode->bsd);
-	else
-#endif
 	ASTCEncode->bsd = get_block_size_descriptor_cpu(
 				ASTCEncode->m_xdim, ASTCEncode->m_ydim, ASTCEncode->m_zdim);
 }
 
-//-----------------------------------------------------
-#ifdef ASTC_ENABLE_3D_SUPPORT
-static void initialize_decimation_table_3d(
-	// dimensions of the block
-	int xdim, int ydim, int zdim,
-	// number of grid points in 3d weight grid
-	int x_weights, int y_weights, int z_weights, decimation_table *dt)
-{
-	int i, j;
-	int x, y, z;
-
-	int texels_per_block = xdim * ydim * zdim;
-	int weights_per_block = x_weights * y_weights * z_weights;
-
-	int weightcount_of_texel[MAX_TEXELS_PER_BLOCK];
-	int grid_weights_of_texel[MAX_TEXELS_PER_BLOCK][4];
-	int weights_of_texel[MAX_TEXELS_PER_BLOCK][4];
-
-	int texelcount_of_weight[MAX_WEIGHTS_PER_BLOCK];
-	int texels_of_weight[MAX_WEIGHTS_PER_BLOCK][MAX_TEXELS_PER_BLOCK];
-	int texelweights_of_weight[MAX_WEIGHTS_PER_BLOCK][MAX_TEXELS_PER_BLOCK];
-
-	for (i = 0; i < weights_per_block; i++)
-		texelcount_of_weight[i] = 0;
-	for (i = 0; i < texels_per_block; i++)
-		weightcount_of_texel[i] = 0;
-
-	for (z = 0; z < zdim; z++)
-		for (y = 0; y < ydim; y++)
-			for (x = 0; x < xdim; x++)
-			{
-				int texel = (z * ydim + y) * xdim + x;
-
-				int x_weight =
-					(((1024 + xdim / 2) / (xdim - 1)) * x * (x_weights - 1) +
-						32) >>
-					6;
-				int y_weight =
-					(((1024 + ydim / 2) / (ydim - 1)) * y * (y_weights - 1) +
-						32) >>
-					6;
-				int z_weight =
-					(((1024 + zdim / 2) / (zdim - 1)) * z * (z_weights - 1) +
-						32) >>
-					6;
-
-				int x_weight_frac = x_weight & 0xF;
-				int y_weight_frac = y_weight & 0xF;
-				int z_weight_frac = z_weight & 0xF;
-				int x_weight_int = x_weight >> 4;
-				int y_weight_int = y_weight >> 4;
-				int z_weight_int = z_weight >> 4;
-				int qweight[4];
-				int weight[4];
-				qweight[0] =
-					(z_weight_int * y_weights + y_weight_int) * x_weights +
-					x_weight_int;
-				qweight[3] =
-					((z_weight_int + 1) * y_weights + (y_weight_int + 1)) *
-						x_weights +
-					(x_weight_int + 1);
-
-				// simplex interpolation
-				int fs = x_weight_frac;
-				int ft = y_weight_frac;
-				int fp = z_weight_frac;
-
-				int cas = ((fs > ft) << 2) + ((ft > fp) << 1) + ((fs > fp));
-				int N = x_weights;
-				int NM = x_weights * y_weights;
-
-				int s1, s2, w0, w1, w2, w3;
-				switch (cas)
-				{
-					case 7:
-						s1 = 1;
-						s2 = N;
-						w0 = 16 - fs;
-						w1 = fs - ft;
-						w2 = ft - fp;
-						w3 = fp;
-						break;
-					case 3:
-						s1 = N;
-						s2 = 1;
-						w0 = 16 - ft;
-						w1 = ft - fs;
-						w2 = fs - fp;
-						w3 = fp;
-						break;
-					case 5:
-						s1 = 1;
-						s2 = NM;
-						w0 = 16 - fs;
-						w1 = fs - fp;
-						w2 = fp - ft;
-						w3 = ft;
-						break;
-					case 4:
-						s1 = NM;
-						s2 = 1;
-						w0 = 16 - fp;
-						w1 = fp - fs;
-						w2 = fs - ft;
-						w3 = ft;
-						break;
-					case 2:
-						s1 = N;
-						s2 = NM;
-						w0 = 16 - ft;
-						w1 = ft - fp;
-						w2 = fp - fs;
-						w3 = fs;
-						break;
-					case 0:
-						s1 = NM;
-						s2 = N;
-						w0 = 16 - fp;
-						w1 = fp - ft;
-						w2 = ft - fs;
-						w3 = fs;
-						break;
-
-					default:
-						s1 = NM;
-						s2 = N;
-						w0 = 16 - fp;
-						w1 = fp - ft;
-						w2 = ft - fs;
-						w3 = fs;
-						break;
-				}
-
-				qweight[1] = qweight[0] + s1;
-				qweight[2] = qweight[1] + s2;
-				weight[0] = w0;
-				weight[1] = w1;
-				weight[2] = w2;
-				weight[3] = w3;
-
-                /*
-                for(i=0;i<4;i++) weight[i] <<= 4; */
-
-				for (i = 0; i < 4; i++)
-					if (weight[i] != 0)
-					{
-						grid_weights_of_texel[texel]
-											 [weightcount_of_texel[texel]] =
-												 qweight[i];
-						weights_of_texel[texel][weightcount_of_texel[texel]] =
-							weight[i];
-						weightcount_of_texel[texel]++;
-						texels_of_weight[qweight[i]]
-										[texelcount_of_weight[qweight[i]]] =
-											texel;
-						texelweights_of_weight
-							[qweight[i]][texelcount_of_weight[qweight[i]]] =
-								weight[i];
-						texelcount_of_weight[qweight[i]]++;
-					}
-			}
-
-	for (i = 0; i < texels_per_block; i++)
-	{
-		dt->texel_num_weights[i] = (uint8_t) weightcount_of_texel[i];
-
-		// ensure that all 4 entries are actually initialized.
-		// This allows a branch-free implemntation of compute_value_of_texel_flt()
-		for (j = 0; j < 4; j++)
-		{
-			dt->texel_weights_int[i][j] = 0;
-			dt->texel_weights_float[i][j] = 0.0f;
-			dt->texel_weights[i][j] = 0;
-		}
-
-		for (j = 0; j < weightcount_of_texel[i]; j++)
-		{
-			dt->texel_weights_int[i][j] = (uint8_t) weights_of_texel[i][j];
-			dt->texel_weights_float[i][j] =
-				static_cast<float>(weights_of_texel[i][j]) *
-				(1.0f / TEXEL_WEIGHT_SUM);
-			dt->texel_weights[i][j] = (uint8_t) grid_weights_of_texel[i][j];
-		}
-	}
-
-	for (i = 0; i < weights_per_block; i++)
-	{
-		dt->weight_num_texels[i] = (uint8_t) texelcount_of_weight[i];
-		for (j = 0; j < texelcount_of_weight[i]; j++)
-		{
-			dt->weight_texel[i][j] = (uint8_t) texels_of_weight[i][j];
-			dt->weights_int[i][j] = (uint8_t) texelweights_of_weight[i][j];
-			dt->weights_flt[i][j] =
-				static_cast<float>(texelweights_of_weight[i][j]);
-		}
-	}
-
-	dt->num_texels = texels_per_block;
-	dt->num_weights = weights_per_block;
-}
-#endif
-
 // routine to read up to 8 bits
 static inline int read_bits(int bitcount, int bitoffset, const uint8_t *ptr)
 {
@@ -31206,21 +31035,14 @@ static void decode_ise(int quantization_level, int elements, const uint8_t *inpu
 static void InitializeASTCSettingsForSetBlockSize(
 	 ASTC_Encode *ASTCEncode)
 {
-	int xdim_2d = ASTCEncode->m_xdim;
-	int ydim_2d = ASTCEncode->m_ydim;
-	float log10_texels_2d = log((float) (xdim_2d * ydim_2d)) / log(10.0f);
-
-#ifdef ASTC_ENABLE_3D_SUPPORT
-	int xdim_3d = ASTCEncode->m_xdim;
-	int ydim_3d = ASTCEncode->m_ydim;
-	int zdim_3d = ASTCEncode->m_zdim;
-	float log10_texels_3d = 0.0f;
-	log10_texels_3d = log((float) (xdim_3d * ydim_3d * zdim_3d)) / log(10.0f);
-	float dblimit_autoset_3d = 0.0;
-#endif
+	// The dB limits scale with the texel count, so 3D blocks share the
+	// 2D formulas with zdim folded in.
+	int texels_per_block =
+		ASTCEncode->m_xdim * ASTCEncode->m_ydim * ASTCEncode->m_zdim;
+	float log10_texels = log((float) texels_per_block) / log(10.0f);
 
 	int plimit_autoset = -1;
-	float dblimit_autoset_2d = 0.0;
+	float dblimit_autoset = 0.0;
 	float oplimit_autoset = 0.0;
 	float mincorrel_autoset = 0.0;
 	float bmc_autoset = 0.0;
@@ -31232,12 +31054,8 @@ static void InitializeASTCSettingsForSetBlockSize(
 		// Very Fast
 		plimit_autoset = 2;
 		oplimit_autoset = 1.f;
-		dblimit_autoset_2d =
-			MAX(70 - 35 * log10_texels_2d, 53 - 19 * log10_texels_2d);
-#ifdef ASTC_ENABLE_3D_SUPPORT
-		dblimit_autoset_3d =
-			MAX(70 - 35 * log10_texels_3d, 53 - 19 * log10_texels_3d);
-#endif
+		dblimit_autoset =
+			MAX(70 - 35 * log10_texels, 53 - 19 * log10_texels);
 		bmc_autoset = 25.f;
 		mincorrel_autoset = 0.5f;
 		maxiters_autoset = 1;
@@ -31247,12 +31065,8 @@ static void InitializeASTCSettingsForSetBlockSize(
 		plimit_autoset = 4;
 		oplimit_autoset = 1.0;
 		mincorrel_autoset = 0.5f;
-		dblimit_autoset_2d =
-			MAX(85 - 35 * log10_texels_2d, 63 - 19 * log10_texels_2d);
-#ifdef ASTC_ENABLE_3D_SUPPORT
-		dblimit_autoset_2d =
-			MAX(85 - 35 * log10_texels_3d, 63 - 19 * log10_texels_3d);
-#endif
+		dblimit_autoset =
+			MAX(85 - 35 * log10_texels, 63 - 19 * log10_texels);
 		bmc_autoset = 50;
 		maxiters_autoset = 1;
 	} else if (ASTCEncode->m_Quality < 0.7)
@@ -31261,12 +31075,8 @@ static void InitializeASTCSettingsForSetBlockSize(
 		plimit_autoset = 25;
 		oplimit_autoset = 1.2f;
 		mincorrel_autoset = 0.75f;
-		dblimit_autoset_2d =
-			MAX(95 - 35 * log10_texels_2d, 70 - 19 * log10_texels_2d);
-#ifdef ASTC_ENABLE_3D_SUPPORT
-		dblimit_autoset_2d =
-			MAX(95 - 35 * log10_texels_3d, 70 - 19 * log10_texels_3d);
-#endif
+		dblimit_autoset =
+			MAX(95 - 35 * log10_texels, 70 - 19 * log10_texels);
 		bmc_autoset = 75;
 		maxiters_autoset = 2;
 	} else if (ASTCEncode->m_Quality < 0.9)
@@ -31275,12 +31085,8 @@ static void InitializeASTCSettingsForSetBlockSize(
 		plimit_autoset = 100;
 		oplimit_autoset = 2.5f;
 		mincorrel_autoset = 0.95f;
-		dblimit_autoset_2d =
-			MAX(105 - 35 * log10_texels_2d, 77 - 19 * log10_texels_2d);
-#ifdef ASTC_ENABLE_3D_SUPPORT
-		dblimit_autoset_2d =
-			MAX(105 - 35 * log10_texels_3d, 77 - 19 * log10_texels_3d);
-#endif
+		dblimit_autoset =
+			MAX(105 - 35 * log10_texels, 77 - 19 * log10_texels);
 		bmc_autoset = 95;
 		maxiters_autoset = 4;
 	} else
@@ -31289,21 +31095,16 @@ static void InitializeASTCSettingsForSetBlockSize(
 		plimit_autoset = PARTITION_COUNT;
 		oplimit_autoset = 1000.f;
 		mincorrel_autoset = 0.99f;
-		dblimit_autoset_2d = 999.f;
+		dblimit_autoset = 999.f;
 		bmc_autoset = 100;
 		maxiters_autoset = 4;
 	}
 
 	int partitions_to_test = plimit_autoset;
-	float dblimit_2d = dblimit_autoset_2d;
+	float dblimit = dblimit_autoset;
 	float oplimit = oplimit_autoset;
 	float mincorrel = mincorrel_autoset;
 
-#ifdef ASTC_ENABLE_3D_SUPPORT
-	float dblimit_3d =
-		dblimit_set_by_user ? dblimit_user_specified : dblimit_autoset_3d;
-#endif
-
 	ASTCEncode->m_ewp.rgb_power = 1.0f;
 	ASTCEncode->m_ewp.alpha_power = 1.0f;
 	ASTCEncode->m_ewp.rgb_base_weight = 1.0f;
@@ -31328,21 +31129,15 @@ static void InitializeASTCSettingsForSetBlockSize(
 
 	ASTCEncode->m_ewp.block_mode_cutoff = bmc_autoset / 100.0f;
 
-	float texel_avg_error_limit_2d;
-	float texel_avg_error_limit_3d;
+	float texel_avg_error_limit;
 
 	if (ASTCEncode->m_rgb_force_use_of_hdr == 0)
 	{
-		texel_avg_error_limit_2d =
-			pow(0.1f, dblimit_2d * 0.1f) * 65535.0f * 65535.0f;
-#ifdef ASTC_ENABLE_3D_SUPPORT
-		texel_avg_error_limit_3d =
-			pow(0.1f, dblimit_3d * 0.1f) * 65535.0f * 65535.0f;
-#endif
+		texel_avg_error_limit =
+			pow(0.1f, dblimit * 0.1f) * 65535.0f * 65535.0f;
 	} else
 	{
-		texel_avg_error_limit_2d = 0.0f;
-		texel_avg_error_limit_3d = 0.0f;
+		texel_avg_error_limit = 0.0f;
 	}
 	ASTCEncode->m_ewp.partition_1_to_2_limit = oplimit;
 	ASTCEncode->m_ewp.lowest_correlation_cutoff = mincorrel;
@@ -31371,7 +31166,7 @@ static void InitializeASTCSettingsForSetBlockSize(
 		max_color_component_weight / 1000.0f);
 
 	// Allocate arrays for image data and load results.
-	ASTCEncode->m_ewp.texel_avg_error_limit = texel_avg_error_limit_2d;
+	ASTCEncode->m_ewp.texel_avg_error_limit = texel_avg_error_limit;
 
 	expand_block_artifact_suppression_host(ASTCEncode->m_xdim,
 		ASTCEncode->m_ydim, ASTCEncode->m_zdim, &ASTCEncode->m_ewp);
@@ -31385,16 +31180,13 @@ static void init_ASTC_tables()
 
 bool init_ASTC( ASTC_Encode *ASTCEncode)
 {
+	ASTCTraceScope trace("init_ASTC", "init");
 	init_ASTC_tables();
 	InitializeASTCSettingsForSetBlockSize(ASTCEncode);
 	setup_block_size_descriptor(ASTCEncode);
 
-#ifdef ASTC_ENABLE_3D_SUPPORT
 	ASTCEncode->m_texels_per_block =
 		ASTCEncode->m_xdim * ASTCEncode->m_ydim * ASTCEncode->m_zdim;
-#else
-	ASTCEncode->m_texels_per_block = ASTCEncode->m_xdim * ASTCEncode->m_ydim;
-#endif
 	ASTCEncode->partition_tables = get_partition_tables(ASTCEncode);
 	return true;
 }
@@ -31403,169 +31195,6 @@ bool init_ASTC( ASTC_Encode *ASTCEncode)
 //=====================================================================================================================================
 // CPU Based Decoder code
 
-#ifdef ASTC_ENABLE_3D_SUPPORT
-void construct_block_size_descriptor_3d(
-	int xdim, int ydim, int zdim, block_size_descriptor *bsd)
-{
-	int decimation_mode_index
-		[512]; // for each of the 512 entries in the decim_table_array, its index
-	int decimation_mode_count = 0;
-
-	int i;
-	int x_weights;
-	int y_weights;
-	int z_weights;
-
-	for (i = 0; i < 512; i++)
-	{
-		decimation_mode_index[i] = -1;
-	}
-
-	// gather all the infill-modes that can be used with the current block size
-	for (x_weights = 2; x_weights <= 6; x_weights++)
-		for (y_weights = 2; y_weights <= 6; y_weights++)
-			for (z_weights = 2; z_weights <= 6; z_weights++)
-			{
-				if ((x_weights * y_weights * z_weights) > MAX_WEIGHTS_PER_BLOCK)
-					continue;
-				decimation_table *dt = new decimation_table;
-				decimation_mode_index[z_weights * 64 + y_weights * 8 +
-					x_weights] = decimation_mode_count;
-				initialize_decimation_table_3d(
-					xdim, ydim, zdim, x_weights, y_weights, z_weights, dt);
-
-				int weight_count = x_weights * y_weights * z_weights;
-
-				int maxprec_1plane = -1;
-				int maxprec_2planes = -1;
-				for (i = 0; i < 12; i++)
-				{
-					int bits_1plane = compute_ise_bitcount(
-						weight_count, (quantization_method) i);
-					int bits_2planes = compute_ise_bitcount(
-						2 * weight_count, (quantization_method) i);
-					if (bits_1plane >= MIN_WEIGHT_BITS_PER_BLOCK &&
-						bits_1plane <= MAX_WEIGHT_BITS_PER_BLOCK)
-						maxprec_1plane = i;
-					if (bits_2planes >= MIN_WEIGHT_BITS_PER_BLOCK &&
-						bits_2planes <= MAX_WEIGHT_BITS_PER_BLOCK)
-						maxprec_2planes = i;
-				}
-				bsd->permit_encode[decimation_mode_count] =
-					(x_weights <= xdim && y_weights <= ydim &&
-						z_weights <= zdim);
-
-				bsd->decimation_mode_samples[decimation_mode_count] =
-					weight_count;
-				bsd->decimation_mode_maxprec_1plane[decimation_mode_count] =
-					maxprec_1plane;
-				bsd->decimation_mode_maxprec_2planes[decimation_mode_count] =
-					maxprec_2planes;
-				bsd->decimation_tables[decimation_mode_count] =
-					*dt; // NP code change!
-
-				decimation_mode_count++;
-			}
-
-	for (i = 0; i < MAX_DECIMATION_MODES; i++)
-	{
-		bsd->decimation_mode_percentile[i] = 1.0f;
-	}
-
-	for (i = decimation_mode_count; i < MAX_DECIMATION_MODES; i++)
-	{
-		bsd->permit_encode[i] = 0;
-		bsd->decimation_mode_samples[i] = 0;
-		bsd->decimation_mode_maxprec_1plane[i] = -1;
-		bsd->decimation_mode_maxprec_2planes[i] = -1;
-	}
-
-	bsd->decimation_mode_count = decimation_mode_count;
-
-	const float *percentiles = get_3d_percentile_table(xdim, ydim, zdim);
-
-	// then construct the list of block formats
-	for (i = 0; i < 2048; i++)
-	{
-		int is_dual_plane;
-		int quantization_mode;
-		int fail = 0;
-		int permit_encode = 1;
-
-		if (decode_block_mode_3d(i, &x_weights, &y_weights, &z_weights,
-				&is_dual_plane, &quantization_mode))
-		{
-			if (x_weights > xdim || y_weights > ydim || z_weights > zdim)
-				permit_encode = 0;
-		} else
-
-		{
-			fail = 1;
-			permit_encode = 0;
-		}
-		if (fail)
-		{
-			bsd->block_modes[i].decimation_mode = -1;
-			bsd->block_modes[i].quantization_mode = -1;
-			bsd->block_modes[i].is_dual_plane = -1;
-			bsd->block_modes[i].permit_encode = 0;
-			bsd->block_modes[i].permit_decode = 0;
-			bsd->block_modes[i].percentile = 1.0f;
-		} else
-		{
-			int decimation_mode = decimation_mode_index[z_weights * 64 +
-				y_weights * 8 + x_weights];
-			bsd->block_modes[i].decimation_mode = (uint8_t) decimation_mode;
-			bsd->block_modes[i].quantization_mode = (uint8_t) quantization_mode;
-			bsd->block_modes[i].is_dual_plane = (uint8_t) is_dual_plane;
-			bsd->block_modes[i].permit_encode = (uint8_t) permit_encode;
-			bsd->block_modes[i].permit_decode = (uint8_t) permit_encode;
-			bsd->block_modes[i].percentile = percentiles[i];
-
-			if (bsd->decimation_mode_percentile[decimation_mode] >
-				percentiles[i])
-				bsd->decimation_mode_percentile[decimation_mode] =
-					percentiles[i];
-		}
-	}
-
-	if (xdim * ydim * zdim <= 64)
-	{
-		bsd->texelcount_for_bitmap_partitioning = xdim * ydim * zdim;
-		for (i = 0; i < xdim * ydim * zdim; i++)
-			bsd->texels_for_bitmap_partitioning[i] = i;
-	}
-
-	else
-	{
-		// pick 64 random texels for use with bitmap partitioning.
-		int arr[MAX_TEXELS_PER_BLOCK];
-		for (i = 0; i < xdim * ydim * zdim; i++)
-			arr[i] = 0;
-		int arr_elements_set = 0;
-		while (arr_elements_set < 64)
-		{
-			int idx = rand() % (xdim * ydim * zdim);
-			if (arr[idx] == 0)
-			{
-				arr_elements_set++;
-				arr[idx] = 1;
-			}
-		}
-		int texel_weights_written = 0;
-		int idx = 0;
-		while (texel_weights_written < 64)
-		{
-			if (arr[idx])
-				bsd->texels_for_bitmap_partitioning[texel_weights_written++] =
-					idx;
-			idx++;
-		}
-		bsd->texelcount_for_bitmap_partitioning = 64;
-	}
-}
-#endif
-
 void physical_to_symbolic_cpu(int xdim, int ydim, int zdim,
 	physical_compressed_block_cpu pb, symbolic_compressed_block_cpu *res)
 {
@@ -31574,10 +31203,9 @@ void physical_to_symbolic_cpu(int xdim, int ydim, int zdim,
 
 	res->error_block = 0;
 
-	// get hold of the block-size descriptor and the decimation tables.
+	// get hold of the block-size descriptor.
 	const block_size_descriptor_cpu *bsd =
 		ASTC_Encoder::get_block_size_descriptor_cpu(xdim, ydim, zdim);
-	const decimation_table_cpu *ixtab2 = bsd->decimation_tables;
 
 	// extract header fields
 	int block_mode = ASTC_Encoder::read_bits(11, 0, pb.data);
@@ -31644,17 +31272,16 @@ void physical_to_symbolic_cpu(int xdim, int ydim, int zdim,
 		return;
 	}
 
-	if (bsd->block_modes[block_mode].permit_decode == 0)
+	const block_mode_decode &bmd = bsd->block_mode_decodes[block_mode];
+	if (bmd.permit_decode == 0)
 	{
 		res->error_block = 1;
 		return;
 	}
 
-	int weight_count =
-		ixtab2[bsd->block_modes[block_mode].decimation_mode].num_weights;
-	int weight_quantization_method =
-		bsd->block_modes[block_mode].quantization_mode;
-	int is_dual_plane = bsd->block_modes[block_mode].is_dual_plane;
+	int weight_count = bmd.weight_count;
+	int weight_quantization_method = bmd.quantization_mode;
+	int is_dual_plane = bmd.is_dual_plane;
 
 	int real_weight_count = is_dual_plane ? 2 * weight_count : weight_count;
 
@@ -31666,9 +31293,7 @@ void physical_to_symbolic_cpu(int xdim, int ydim, int zdim,
 	for (i = 0; i < 16; i++)
 		bswapped[i] = (uint8_t) ASTC_Encoder::bitrev8(pb.data[15 - i]);
 
-	int bits_for_weights =
-		ASTC_Encoder::compute_ise_bitcount(real_weight_count,
-			(quantization_method) weight_quantization_method);
+	int bits_for_weights = bmd.bits_for_weights;
 
 	int below_weights_pos = 128 - bits_for_weights;
 
@@ -31940,6 +31565,90 @@ void fetch_imageblock_cpu(const astc_codec_image_cpu *img,
 	update_imageblock_flags(pb, ASTCEncode);
 }
 
+void fetch_imageblock_source_cpu(const image_source_cpu *img,
+	imageblock_cpu *pb, int xpos, int ypos, int zpos,
+	ASTC_Encoder::ASTC_Encode *ASTCEncode)
+{
+	float *fptr = pb->orig_data;
+
+	int xdim = ASTCEncode->m_xdim;
+	int ydim = ASTCEncode->m_ydim;
+	int zdim = ASTCEncode->m_zdim;
+
+	pb->xpos = xpos;
+	pb->ypos = ypos;
+	pb->zpos = zpos;
+	pb->xsize = img->xsize;
+	pb->ysize = img->ysize;
+	pb->zsize = img->zsize;
+
+	const texel_layout_cpu *layout = img->layout;
+	int texel_size = layout->texel_size;
+	if (img->type != IMAGE_SOURCE_UNORM8)
+		texel_size *= 2;
+	bool inside = xpos + xdim <= img->xsize && ypos + ydim <= img->ysize &&
+		zpos + zdim <= img->zsize;
+	int srgb = ASTCEncode->m_perform_srgb_transform;
+
+	for (int z = 0; z < zdim; z++)
+	{
+		int zi = inside ? zpos + z : MIN(zpos + z, img->zsize - 1);
+		const uint8_t *slice = img->data + zi * img->slice_pitch;
+
+		for (int y = 0; y < ydim; y++)
+		{
+			int yi = inside ? ypos + y : MIN(ypos + y, img->ysize - 1);
+			const uint8_t *row = slice + yi * img->pitch;
+
+			for (int x = 0; x < xdim; x++)
+			{
+				// clamp X coordinate to the picture.
+				int xi = inside ? xpos + x : MIN(xpos + x, img->xsize - 1);
+				const uint8_t *texel = row + texel_size * xi;
+
+				switch (img->type)
+				{
+				case IMAGE_SOURCE_UNORM8:
+					load_texel_rgba8_cpu(texel, layout, fptr);
+					break;
+
+				case IMAGE_SOURCE_UNORM16:
+					load_texel_rgba16_cpu(
+						reinterpret_cast<const uint16_t *>(texel), layout,
+						fptr);
+					break;
+
+				case IMAGE_SOURCE_FLOAT16:
+					load_texel_rgba16f_cpu(
+						reinterpret_cast<const uint16_t *>(texel), layout,
+						fptr);
+					if (srgb)
+					{
+						fptr[0] = ASTC_Encoder::linear_to_srgb(fptr[0]);
+						fptr[1] = ASTC_Encoder::linear_to_srgb(fptr[1]);
+						fptr[2] = ASTC_Encoder::linear_to_srgb(fptr[2]);
+					}
+					break;
+				}
+				fptr += 4;
+			}
+		}
+	}
+
+	int pixelcount = xdim * ydim * zdim;
+
+	// impose the choice on every pixel when encoding.
+	for (int i = 0; i < pixelcount; i++)
+	{
+		pb->rgb_lns[i] = (uint8_t) ASTCEncode->m_rgb_force_use_of_hdr;
+		pb->alpha_lns[i] = (uint8_t) ASTCEncode->m_alpha_force_use_of_hdr;
+		pb->nan_texel[i] = 0;
+	}
+
+	ASTC_Encoder::imageblock_initialize_work_from_orig(pb, pixelcount);
+	update_imageblock_flags(pb, ASTCEncode);
+}
+
 void destroy_image_cpu(astc_codec_image_cpu *img)
 {
 	if (img == NULL)
@@ -32247,5 +31956,263 @@ void write_imageblock_cpu(astc_codec_image_cpu * img, const imageblock_cpu * pb,
                 }
     }
 }
+
+const texel_layout_cpu texel_layout_rgba8_cpu = { 4, { 0, 1, 2, 3 }, 0, 0 };
+
+// Converts a decoded texel to 8-bit channels and stores it with the given
+// layout. Luminance is computed with the same weights Qt uses for qGray.
+void store_texel_rgba8_cpu(
+    const float rgba[4], const texel_layout_cpu * layout, uint8_t * out)
+{
+    float data[4];
+    for (int c = 0; c < 4; c++)
+    {
+        // clamp to [0,1]
+        data[c] = rgba[c] > 1.0f ? 1.0f : rgba[c];
+    }
+
+    if (layout->premultiply)
+    {
+        data[0] *= data[3];
+        data[1] *= data[3];
+        data[2] *= data[3];
+    }
+
+    // pack the data
+    int ri = static_cast < int >(floor(data[0] * 255.0f + 0.5f));
+    int gi = static_cast < int >(floor(data[1] * 255.0f + 0.5f));
+    int bi = static_cast < int >(floor(data[2] * 255.0f + 0.5f));
+    int ai = static_cast < int >(floor(data[3] * 255.0f + 0.5f));
+
+    if (layout->texel_size == 1)
+    {
+        out[0] = (uint8_t)((ri * 11 + gi * 16 + bi * 5) / 32);
+        return;
+    }
+
+    out[layout->offsets[0]] = (uint8_t)ri;
+    out[layout->offsets[1]] = (uint8_t)gi;
+    out[layout->offsets[2]] = (uint8_t)bi;
+    out[layout->offsets[3]] = layout->opaque ? 0xFF : (uint8_t)ai;
+}
+
+// Reads a 16-bit unsigned normalized texel as straight RGBA in [0,1].
+void load_texel_rgba16_cpu(
+    const uint16_t * in, const texel_layout_cpu * layout, float rgba[4])
+{
+    int ai = layout->opaque ? 0xFFFF : in[layout->offsets[3]];
+    rgba[3] = ai / 65535.0f;
+
+    for (int c = 0; c < 3; c++)
+    {
+        int ci = in[layout->offsets[c]];
+        if (layout->premultiply && ai != 0xFFFF)
+            rgba[c] = ai == 0 ? 0.0f : MIN(float (ci) / float (ai), 1.0f);
+        else
+            rgba[c] = ci / 65535.0f;
+    }
+}
+
+// Reads a half float texel for HDR encoding. Color is kept above zero and
+// below the half float range as the LNS conversion expects; NaN becomes
+// zero. Alpha is encoded as LDR, so it is clamped to [0,1].
+void load_texel_rgba16f_cpu(
+    const uint16_t * in, const texel_layout_cpu * layout, float rgba[4])
+{
+    float alpha = layout->opaque ? 1.0f : sf16_to_float(in[layout->offsets[3]]);
+    rgba[3] = alpha > 0.0f ? MIN(alpha, 1.0f) : 0.0f;
+
+    for (int c = 0; c < 3; c++)
+    {
+        float value = sf16_to_float(in[layout->offsets[c]]);
+        if (layout->premultiply && rgba[3] > 0.0f)
+            value /= rgba[3];
+        // NaN fails both comparisons
+        rgba[c] = value > 1e-8f ? MIN(value, 65504.0f) : 1e-8f;
+    }
+}
+
+// Reads an 8-bit texel with the given layout as straight RGBA in [0,1].
+// Luminance is expanded to gray, premultiplied colors are divided back.
+void load_texel_rgba8_cpu(
+    const uint8_t * in, const texel_layout_cpu * layout, float rgba[4])
+{
+    if (layout->texel_size == 1)
+    {
+        rgba[0] = rgba[1] = rgba[2] = in[0] / 255.0f;
+        rgba[3] = 1.0f;
+        return;
+    }
+
+    int ai = layout->opaque ? 0xFF : in[layout->offsets[3]];
+    rgba[3] = ai / 255.0f;
+
+    for (int c = 0; c < 3; c++)
+    {
+        int ci = in[layout->offsets[c]];
+        if (layout->premultiply && ai != 0xFF)
+            rgba[c] = ai == 0 ? 0.0f : MIN(float (ci) / float (ai), 1.0f);
+        else
+            rgba[c] = ci / 255.0f;
+    }
+}
+
+// Writes a decoded block as 8-bit texels straight into a caller-owned image.
+// Only the width x height texels starting at (x0, y0) inside the block are
+// stored. dst points at where texel (x0, y0) goes, pitch is the byte
+// distance between consecutive block rows (may be negative for bottom-up
+// images).
+void write_imageblock_rgba8_cpu(const imageblock_cpu * pb, int xdim,
+    int x0, int y0, int width, int height, const texel_layout_cpu * layout,
+    uint8_t * dst, ptrdiff_t pitch)
+{
+    // NaN-pixel, but we can't display it. Display purple instead.
+    static const float nan_color[4] = { 1.0f, 0.0f, 1.0f, 1.0f };
+    int texel_size = layout->texel_size;
+
+    for (int y = 0; y < height; y++)
+    {
+        int texel = xdim * (y0 + y) + x0;
+        const float *fptr = pb->orig_data + 4 * texel;
+        const uint8_t *nptr = pb->nan_texel + texel;
+        uint8_t *out = dst + pitch * y;
+
+        for (int x = 0; x < width; x++)
+        {
+            store_texel_rgba8_cpu(nptr[x] ? nan_color : fptr, layout, out);
+            fptr += 4;
+            out += texel_size;
+        }
+    }
+}
+
+// Same as write_imageblock_rgba8_cpu for half float texels decoded by
+// decompress_symbolic_block_sf16. Values are copied as they are, HDR
+// included; only an opaque layout replaces alpha with 1.0.
+void write_imageblock_sf16_cpu(const uint16_t * texels, int xdim,
+    int x0, int y0, int width, int height, const texel_layout_cpu * layout,
+    uint8_t * dst, ptrdiff_t pitch)
+{
+    const int *offsets = layout->offsets;
+    int texel_size = layout->texel_size;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint16_t *in = texels + 4 * (xdim * (y0 + y) + x0);
+        uint16_t *out = reinterpret_cast < uint16_t * >(dst + pitch * y);
+
+        for (int x = 0; x < width; x++)
+        {
+            out[offsets[0]] = in[0];
+            out[offsets[1]] = in[1];
+            out[offsets[2]] = in[2];
+            out[offsets[3]] = layout->opaque ? 0x3C00 : in[3];
+            in += 4;
+            out += texel_size;
+        }
+    }
+}
+
+void physical_block_traits_cpu(int xdim, int ydim, int zdim,
+    const physical_compressed_block_cpu & pb, int * has_alpha, int * has_color)
+{
+    *has_alpha = 0;
+    *has_color = 0;
+
+    int block_mode = ASTC_Encoder::read_bits(11, 0, pb.data);
+
+    if ((block_mode & 0x1FF) == 0x1FC)
+    {
+        // void-extent block: look at the constant color itself
+        uint16_t color[4];
+        for (int i = 0; i < 4; i++)
+            color[i] = pb.data[2 * i + 8] | (pb.data[2 * i + 9] << 8);
+
+        uint16_t one = (block_mode & 0x200) ? 0x3C00 : 0xFFFF;
+        *has_alpha = color[3] != one;
+        *has_color = color[0] != color[1] || color[0] != color[2];
+        return;
+    }
+
+    const block_size_descriptor_cpu *bsd =
+        ASTC_Encoder::get_block_size_descriptor_cpu(xdim, ydim, zdim);
+    const block_mode_decode &bmd = bsd->block_mode_decodes[block_mode];
+    if (bmd.permit_decode == 0)
+    {
+        // error blocks are displayed purple
+        *has_color = 1;
+        return;
+    }
+
+    int partition_count = ASTC_Encoder::read_bits(2, 11, pb.data) + 1;
+    int color_formats[4];
+    if (partition_count == 1)
+    {
+        color_formats[0] = ASTC_Encoder::read_bits(4, 13, pb.data);
+    }
+    else
+    {
+        int encoded_type_highpart_size = (3 * partition_count) - 4;
+        int below_weights_pos =
+            128 - bmd.bits_for_weights - encoded_type_highpart_size;
+        int encoded_type =
+            ASTC_Encoder::read_bits(6, 13 + PARTITION_BITS, pb.data) |
+            (ASTC_Encoder::read_bits(
+                encoded_type_highpart_size, below_weights_pos, pb.data)
+                << 6);
+        int baseclass = encoded_type & 0x3;
+        if (baseclass == 0)
+        {
+            for (int i = 0; i < partition_count; i++)
+                color_formats[i] = (encoded_type >> 2) & 0xF;
+        }
+        else
+        {
+            int bitpos = 2;
+            baseclass--;
+            for (int i = 0; i < partition_count; i++)
+            {
+                color_formats[i] = (((encoded_type >> bitpos) & 1) + baseclass)
+                    << 2;
+                bitpos++;
+            }
+            for (int i = 0; i < partition_count; i++)
+            {
+                color_formats[i] |= (encoded_type >> bitpos) & 3;
+                bitpos += 2;
+            }
+        }
+    }
+
+    for (int i = 0; i < partition_count; i++)
+    {
+        switch (color_formats[i])
+        {
+        case FMT_LUMINANCE:
+        case FMT_LUMINANCE_DELTA:
+        case FMT_HDR_LUMINANCE_LARGE_RANGE:
+        case FMT_HDR_LUMINANCE_SMALL_RANGE:
+            break;
+
+        case FMT_LUMINANCE_ALPHA:
+        case FMT_LUMINANCE_ALPHA_DELTA:
+            *has_alpha = 1;
+            break;
+
+        case FMT_RGB_SCALE:
+        case FMT_HDR_RGB_SCALE:
+        case FMT_RGB:
+        case FMT_RGB_DELTA:
+        case FMT_HDR_RGB:
+            *has_color = 1;
+            break;
+
+        default:
+            *has_alpha = 1;
+            *has_color = 1;
+            break;
+        }
+    }
+}
 // End CPU Decoder Code
 //-----------------------------------------------
@@ -29,6 +29,7 @@
 #include "ASTC_Encode_Kernel.h"
 #include "ARM/astc_codec_internals.h"
 
+#include <cstddef>
 #include <cstdint>
 
 namespace ASTC_Encoder
@@ -37,6 +38,9 @@ bool init_ASTC(ASTC_Encode *ASTCEncode);
 
 extern uint16_t unorm16_to_sf16(uint16_t p);
 extern uint16_t lns_to_sf16(uint16_t p);
+// sRGB transfer function by table lookup
+extern uint16_t srgb8_to_linear_sf16(uint8_t p);
+extern float linear_to_srgb(float p);
 extern void find_number_of_bits_trits_quints(
 	int quantization_level, int *bits, int *trits, int *quints);
 extern void luminance_unpack(
@@ -114,10 +118,73 @@ void write_imageblock_cpu(astc_codec_image_cpu *img, const imageblock_cpu *pb,
 	int xdim, int ydim, int zdim, int xpos, int ypos, int zpos,
 	swizzlepattern_cpu swz);
 
+// Layout of 8-bit texels read by the encoder and written by the decoder
+struct texel_layout_cpu
+{
+	int texel_size; // 4, or 1 for luminance only
+	int offsets[4]; // byte offsets of R, G, B and A in a 4 byte texel
+	int premultiply; // store RGB multiplied by alpha
+	int opaque; // store 255 as alpha
+};
+
+extern const texel_layout_cpu texel_layout_rgba8_cpu;
+
+void store_texel_rgba8_cpu(
+	const float rgba[4], const texel_layout_cpu *layout, uint8_t *out);
+
+void load_texel_rgba8_cpu(
+	const uint8_t *in, const texel_layout_cpu *layout, float rgba[4]);
+void load_texel_rgba16_cpu(
+	const uint16_t *in, const texel_layout_cpu *layout, float rgba[4]);
+void load_texel_rgba16f_cpu(
+	const uint16_t *in, const texel_layout_cpu *layout, float rgba[4]);
+
+void write_imageblock_rgba8_cpu(const imageblock_cpu *pb, int xdim, int x0,
+	int y0, int width, int height, const texel_layout_cpu *layout,
+	uint8_t *dst, ptrdiff_t pitch);
+
+void write_imageblock_sf16_cpu(const uint16_t *texels, int xdim, int x0,
+	int y0, int width, int height, const texel_layout_cpu *layout,
+	uint8_t *dst, ptrdiff_t pitch);
+
+// Cheaply reports whether a physical block may decode to non-opaque or
+// non-gray texels, from its block mode and endpoint formats only.
+void physical_block_traits_cpu(int xdim, int ydim, int zdim,
+	const physical_compressed_block_cpu &pb, int *has_alpha, int *has_color);
+
 void destroy_image_cpu(astc_codec_image_cpu *img);
 
 void fetch_imageblock_cpu(const astc_codec_image_cpu *img, imageblock_cpu *pb,
 	// position in texture.
 	int xpos, int ypos, int zpos, ASTC_Encoder::ASTC_Encode *ASTCEncode);
 
+enum image_source_type_cpu
+{
+	IMAGE_SOURCE_UNORM8,
+	IMAGE_SOURCE_UNORM16,
+	IMAGE_SOURCE_FLOAT16,
+};
+
+// Texels read in place from the caller's memory. Layout offsets and texel
+// size count channels, which are 16 bits wide for the 16-bit types.
+struct image_source_cpu
+{
+	const uint8_t *data; // first image row
+	ptrdiff_t pitch; // negative when rows are stored bottom-up
+	ptrdiff_t slice_pitch; // distance between slices of a volume
+	int xsize;
+	int ysize;
+	int zsize;
+	int type; // image_source_type_cpu
+	const texel_layout_cpu *layout;
+};
+
+// Same as fetch_imageblock_cpu, clamping coordinates only for blocks
+// crossing the image border. Half float texels go to the encoder
+// unclamped, as HDR values, or converted from linear to sRGB when the
+// encoder performs the sRGB transform.
+void fetch_imageblock_source_cpu(const image_source_cpu *img,
+	imageblock_cpu *pb, int xpos, int ypos, int zpos,
+	ASTC_Encoder::ASTC_Encode *ASTCEncode);
+
 #endif
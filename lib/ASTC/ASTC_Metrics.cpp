@@ -0,0 +1,261 @@
+//===============================================================================
+// Copyright (c) 2007-2016  Advanced Micro Devices, Inc. All rights reserved.
+// Copyright (c) 2004-2006 ATI Technologies Inc.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ASTC_Metrics.cpp : Error of decoded images against their source
+//
+
+#include "ASTC/ASTC_Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+static const int SSIM_WINDOW = 8;
+static const int SSIM_STEP = 4;
+static const double SSIM_C1 = (0.01 * 255) * (0.01 * 255);
+static const double SSIM_C2 = (0.03 * 255) * (0.03 * 255);
+
+// Sums of one band of rows, added together once all bands are done
+struct metrics_band_sums
+{
+	uint64_t squared[4];
+	uint64_t alphaWeighted;
+	uint64_t alpha;
+	double ssim[4];
+	uint64_t windows;
+};
+
+// Runs work(y0, y1, band) on bands of rows, one thread each
+template <typename WORK>
+static void run_bands(int height, int threadCount, WORK work)
+{
+	int bands = std::max(1, std::min(threadCount, height / SSIM_STEP));
+	if (bands == 1)
+	{
+		work(0, height, 0);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(bands);
+	for (int band = 0; band < bands; band++)
+	{
+		int y0 = height * band / bands;
+		int y1 = height * (band + 1) / bands;
+		threads.emplace_back(work, y0, y1, band);
+	}
+	for (auto &thread : threads)
+		thread.join();
+}
+
+static bool is_plain_rgba8(const texel_layout_cpu *layout)
+{
+	return layout->texel_size == 4 && !layout->opaque &&
+		layout->offsets[0] == 0 && layout->offsets[1] == 1 &&
+		layout->offsets[2] == 2 && layout->offsets[3] == 3;
+}
+
+// Converts a row to R, G, B, A bytes
+static void load_row_rgba8(const uint8_t *in, const texel_layout_cpu *layout,
+	int width, uint8_t *out)
+{
+	for (int x = 0; x < width; x++, in += layout->texel_size, out += 4)
+	{
+		if (layout->texel_size == 1)
+		{
+			out[0] = out[1] = out[2] = in[0];
+			out[3] = 255;
+			continue;
+		}
+
+		for (int c = 0; c < 4; c++)
+			out[c] = in[layout->offsets[c]];
+		if (layout->opaque)
+			out[3] = 255;
+	}
+}
+
+static void add_row_errors(const uint8_t *a, const uint8_t *b, int width,
+	metrics_band_sums &sums)
+{
+	// Plain integer loops over bytes, vectorized by the compiler. The
+	// 32-bit sums are flushed every 65535 texels, before they overflow.
+	const int runLength = 65535;
+	for (int x0 = 0; x0 < width; x0 += runLength)
+	{
+		const int runEnd = std::min(width, x0 + runLength);
+		uint32_t squared[4] = { 0, 0, 0, 0 };
+		uint64_t alphaWeighted = 0;
+		uint32_t alpha = 0;
+		for (int x = x0; x < runEnd; x++, a += 4, b += 4)
+		{
+			uint32_t rgb = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				int d = int(a[c]) - int(b[c]);
+				uint32_t d2 = uint32_t(d * d);
+				squared[c] += d2;
+				if (c < 3)
+					rgb += d2;
+			}
+			alphaWeighted += uint64_t(rgb) * a[3];
+			alpha += a[3];
+		}
+
+		for (int c = 0; c < 4; c++)
+			sums.squared[c] += squared[c];
+		sums.alphaWeighted += alphaWeighted;
+		sums.alpha += alpha;
+	}
+}
+
+static void add_ssim_window(const uint8_t *a, ptrdiff_t pitchA,
+	const uint8_t *b, ptrdiff_t pitchB, int windowWidth, int windowHeight,
+	metrics_band_sums &sums)
+{
+	uint32_t sa[4] = { 0, 0, 0, 0 };
+	uint32_t sb[4] = { 0, 0, 0, 0 };
+	uint32_t saa[4] = { 0, 0, 0, 0 };
+	uint32_t sbb[4] = { 0, 0, 0, 0 };
+	uint32_t sab[4] = { 0, 0, 0, 0 };
+	for (int y = 0; y < windowHeight; y++, a += pitchA, b += pitchB)
+	{
+		for (int x = 0; x < windowWidth * 4; x += 4)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				uint32_t va = a[x + c];
+				uint32_t vb = b[x + c];
+				sa[c] += va;
+				sb[c] += vb;
+				saa[c] += va * va;
+				sbb[c] += vb * vb;
+				sab[c] += va * vb;
+			}
+		}
+	}
+
+	const double n = double(windowWidth * windowHeight);
+	for (int c = 0; c < 4; c++)
+	{
+		double ma = sa[c] / n;
+		double mb = sb[c] / n;
+		double va = saa[c] / n - ma * ma;
+		double vb = sbb[c] / n - mb * mb;
+		double cov = sab[c] / n - ma * mb;
+		sums.ssim[c] += ((2.0 * ma * mb + SSIM_C1) * (2.0 * cov + SSIM_C2)) /
+			((ma * ma + mb * mb + SSIM_C1) * (va + vb + SSIM_C2));
+	}
+	sums.windows++;
+}
+
+static double psnr_of(double mse)
+{
+	return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+void compute_quality_metrics_cpu(const uint8_t *source,
+	ptrdiff_t sourcePitch, const uint8_t *decoded, ptrdiff_t decodedPitch,
+	const texel_layout_cpu *layout, int width, int height, int threadCount,
+	ASTCQualityMetrics *metrics)
+{
+	// Other layouts are converted to R, G, B, A first, SSIM windows span
+	// the rows of several bands
+	std::vector<uint8_t> sourceRGBA;
+	std::vector<uint8_t> decodedRGBA;
+	if (!is_plain_rgba8(layout))
+	{
+		sourceRGBA.resize(size_t(width) * height * 4);
+		decodedRGBA.resize(sourceRGBA.size());
+		run_bands(height, threadCount, [&](int y0, int y1, int) {
+			for (int y = y0; y < y1; y++)
+			{
+				size_t offset = size_t(y) * width * 4;
+				load_row_rgba8(source + y * sourcePitch, layout, width,
+					&sourceRGBA[offset]);
+				load_row_rgba8(decoded + y * decodedPitch, layout, width,
+					&decodedRGBA[offset]);
+			}
+		});
+		source = sourceRGBA.data();
+		decoded = decodedRGBA.data();
+		sourcePitch = decodedPitch = ptrdiff_t(width) * 4;
+	}
+
+	// Windows are clipped to small images
+	const int windowWidth = std::min(width, SSIM_WINDOW);
+	const int windowHeight = std::min(height, SSIM_WINDOW);
+
+	std::vector<metrics_band_sums> bands(
+		size_t(std::max(threadCount, 1)), metrics_band_sums());
+	run_bands(height, threadCount, [&](int y0, int y1, int band) {
+		metrics_band_sums &sums = bands[band];
+		for (int y = y0; y < y1; y++)
+		{
+			add_row_errors(source + y * sourcePitch,
+				decoded + y * decodedPitch, width, sums);
+
+			// Windows starting on this row
+			if (y % SSIM_STEP != 0 || y + windowHeight > height)
+				continue;
+			for (int x = 0; x + windowWidth <= width; x += SSIM_STEP)
+			{
+				add_ssim_window(source + y * sourcePitch + x * 4, sourcePitch,
+					decoded + y * decodedPitch + x * 4, decodedPitch,
+					windowWidth, windowHeight, sums);
+			}
+		}
+	});
+
+	metrics_band_sums total = metrics_band_sums();
+	for (auto &sums : bands)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			total.squared[c] += sums.squared[c];
+			total.ssim[c] += sums.ssim[c];
+		}
+		total.alphaWeighted += sums.alphaWeighted;
+		total.alpha += sums.alpha;
+		total.windows += sums.windows;
+	}
+
+	const double texels = double(width) * height;
+	double rgb = 0.0;
+	for (int c = 0; c < 4; c++)
+	{
+		metrics->mse[c] = total.squared[c] / texels;
+		metrics->psnr[c] = psnr_of(metrics->mse[c]);
+		metrics->ssim[c] = total.windows ? total.ssim[c] / total.windows : 1.0;
+		if (c < 3)
+			rgb += metrics->mse[c];
+	}
+	metrics->psnrRGB = psnr_of(rgb / 3.0);
+	metrics->psnrRGBA = psnr_of((rgb + metrics->mse[3]) / 4.0);
+	metrics->psnrAlphaWeighted = psnr_of(total.alpha
+			? total.alphaWeighted / (3.0 * total.alpha)
+			: 0.0);
+	metrics->ssimRGB =
+		(metrics->ssim[0] + metrics->ssim[1] + metrics->ssim[2]) / 3.0;
+}
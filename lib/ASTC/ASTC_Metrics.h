@@ -0,0 +1,60 @@
+//===============================================================================
+// Copyright (c) 2014-2016  Advanced Micro Devices, Inc. All rights reserved.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+//
+// ASTC_Metrics.h : Error of decoded images against their source
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ASTC_METRICS_H_
+#define _ASTC_METRICS_H_
+
+#include "ASTC_Host.h"
+
+// Error of decoded 8-bit texels against their source. Identical images
+// have infinite PSNR.
+struct ASTCQualityMetrics
+{
+	// Mean squared error and PSNR of R, G, B and A
+	double mse[4];
+	double psnr[4];
+	// Over R, G and B together, and over all four channels
+	double psnrRGB;
+	double psnrRGBA;
+	// RGB error of each texel weighted by its source alpha, so that
+	// invisible texels do not count
+	double psnrAlphaWeighted;
+	// Mean SSIM of 8x8 windows 4 texels apart, for each channel and for
+	// R, G and B together
+	double ssim[4];
+	double ssimRGB;
+};
+
+// Compares two images of width x height texels with the given layout.
+// Rows are split in bands across threadCount threads. Luminance only
+// texels count as gray RGB, texels of opaque layouts as opaque.
+void compute_quality_metrics_cpu(const uint8_t *source,
+	ptrdiff_t sourcePitch, const uint8_t *decoded, ptrdiff_t decodedPitch,
+	const texel_layout_cpu *layout, int width, int height, int threadCount,
+	ASTCQualityMetrics *metrics);
+
+#endif
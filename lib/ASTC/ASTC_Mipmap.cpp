@@ -0,0 +1,324 @@
+//===============================================================================
+// Copyright (c) 2007-2016  Advanced Micro Devices, Inc. All rights reserved.
+// Copyright (c) 2004-2006 ATI Technologies Inc.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ASTC_Mipmap.cpp : Mip level downsampling for the encoder
+//
+
+#include "ASTC/ASTC_Mipmap.h"
+#include "ARM/softfloat.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Kaiser window parameters, as commonly used for mipmaps: the filter
+// spans 3 destination texels on each side.
+static const double KAISER_WIDTH = 3.0;
+static const double KAISER_ALPHA = 4.0;
+// Samples per source texel when integrating the Kaiser filter
+static const int KAISER_SAMPLES = 8;
+static const double PI = 3.14159265358979323846;
+
+static double bessel0(double x)
+{
+	// Power series, converges quickly for the window arguments
+	double sum = 1.0;
+	double term = 1.0;
+	double halfX = x * 0.5;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= halfX / k;
+		double t2 = term * term;
+		sum += t2;
+		if (t2 < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static double kaiser(double x)
+{
+	double t = x / KAISER_WIDTH;
+	if (t <= -1.0 || t >= 1.0)
+		return 0.0;
+
+	double window =
+		bessel0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / bessel0(KAISER_ALPHA);
+	if (x == 0.0)
+		return window;
+
+	double px = PI * x;
+	return window * std::sin(px) / px;
+}
+
+// Integral of the filter over [x0, x1], in destination texel units
+static double integrate(ASTCMipmapFilter filter, double x0, double x1)
+{
+	if (filter == ASTC_MIPMAP_BOX)
+		return std::max(0.0, std::min(x1, 0.5) - std::max(x0, -0.5));
+
+	double step = (x1 - x0) / KAISER_SAMPLES;
+	double sum = 0.0;
+	for (int i = 0; i < KAISER_SAMPLES; i++)
+		sum += kaiser(x0 + (i + 0.5) * step);
+	return sum * step;
+}
+
+ASTCMipmapResampler::ASTCMipmapResampler(ASTCMipmapFilter filter,
+	CMP_DWORD srcWidth, CMP_DWORD srcHeight, CMP_DWORD dstWidth,
+	CMP_DWORD dstHeight)
+	: srcWidth(srcWidth)
+	, srcHeight(srcHeight)
+	, dstWidth(dstWidth)
+	, dstHeight(dstHeight)
+	, tapsX(makeTaps(filter, srcWidth, dstWidth))
+	, tapsY(makeTaps(filter, srcHeight, dstHeight))
+{
+}
+
+CMP_DWORD ASTCMipmapResampler::levelCount(CMP_DWORD width, CMP_DWORD height)
+{
+	CMP_DWORD size = std::max(width, height);
+	CMP_DWORD count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		count++;
+	}
+	return count;
+}
+
+std::vector<ASTCMipmapResampler::Taps> ASTCMipmapResampler::makeTaps(
+	ASTCMipmapFilter filter, CMP_DWORD srcSize, CMP_DWORD dstSize)
+{
+	const double scale = double(srcSize) / dstSize;
+	const double radius =
+		(filter == ASTC_MIPMAP_BOX ? 0.5 : KAISER_WIDTH) * scale;
+
+	std::vector<Taps> result(dstSize);
+	std::vector<float> weights;
+	for (CMP_DWORD i = 0; i < dstSize; i++)
+	{
+		double center = (i + 0.5) * scale;
+		int first = int(std::floor(center - radius));
+		int last = int(std::ceil(center + radius));
+
+		// Weights of the clamped source texels
+		CMP_DWORD clampedFirst = CMP_DWORD(std::max(first, 0));
+		CMP_DWORD clampedLast = CMP_DWORD(std::min(last, int(srcSize) - 1));
+		weights.assign(clampedLast - clampedFirst + 1, 0.f);
+
+		double sum = 0.0;
+		for (int j = first; j <= last; j++)
+		{
+			double w = integrate(
+				filter, (j - center) / scale, (j + 1 - center) / scale);
+			int clamped = std::min(std::max(j, 0), int(srcSize) - 1);
+			weights[clamped - clampedFirst] += float(w);
+			sum += w;
+		}
+
+		// Weights sum to one, trailing zero taps are dropped
+		for (auto &w : weights)
+			w = float(w / sum);
+		while (weights.size() > 1 && weights.back() == 0.f)
+			weights.pop_back();
+		CMP_DWORD skip = 0;
+		while (skip + 1 < weights.size() && weights[skip] == 0.f)
+			skip++;
+
+		Taps &taps = result[i];
+		taps.first = clampedFirst + skip;
+		taps.weights.assign(weights.begin() + skip, weights.end());
+	}
+	return result;
+}
+
+void ASTCMipmapResampler::resample(const RowReader &reader, float *out) const
+{
+	// Horizontally filtered source rows, each kept until no destination
+	// row needs it. Rows used by a destination row are consecutive and
+	// move down only, so a ring of the widest vertical span is enough.
+	size_t ringSize = 0;
+	for (auto &taps : tapsY)
+		ringSize = std::max(ringSize, taps.weights.size());
+
+	const size_t dstRowSize = dstWidth * 4;
+	std::vector<float> ring(ringSize * dstRowSize);
+	std::vector<int> ringRows(ringSize, -1);
+	std::vector<float> srcRow(srcWidth * 4);
+
+	for (CMP_DWORD y = 0; y < dstHeight; y++)
+	{
+		const Taps &rowTaps = tapsY[y];
+		float *pOut = out + y * dstRowSize;
+		std::fill(pOut, pOut + dstRowSize, 0.f);
+
+		for (size_t j = 0; j < rowTaps.weights.size(); j++)
+		{
+			CMP_DWORD srcY = CMP_DWORD(rowTaps.first + j);
+			float *pFiltered = &ring[(srcY % ringSize) * dstRowSize];
+			if (ringRows[srcY % ringSize] != int(srcY))
+			{
+				ringRows[srcY % ringSize] = int(srcY);
+				reader(srcY, srcRow.data());
+				for (CMP_DWORD x = 0; x < dstWidth; x++)
+				{
+					const Taps &taps = tapsX[x];
+					const float *pIn = &srcRow[taps.first * 4];
+					float rgba[4] = { 0.f, 0.f, 0.f, 0.f };
+					for (float w : taps.weights)
+					{
+						for (int c = 0; c < 4; c++)
+							rgba[c] += pIn[c] * w;
+						pIn += 4;
+					}
+					std::copy(rgba, rgba + 4, pFiltered + x * 4);
+				}
+			}
+
+			float w = rowTaps.weights[j];
+			for (size_t i = 0; i < dstRowSize; i++)
+				pOut[i] += pFiltered[i] * w;
+		}
+	}
+}
+
+// sRGB to linear for 16-bit values, 8-bit values index it scaled by 257
+static const float *srgb16ToLinear()
+{
+	struct Table
+	{
+		float values[65536];
+
+		Table()
+		{
+			for (int i = 0; i < 65536; i++)
+			{
+				double c = i / 65535.0;
+				values[i] = float(c <= 0.04045
+						? c / 12.92
+						: std::pow((c + 0.055) / 1.055, 2.4));
+			}
+		}
+	};
+
+	static const Table table;
+	return table.values;
+}
+
+static float linearToSRGB16(float c)
+{
+	return c <= 0.0031308f ? c * 12.92f
+						   : float(1.055 * std::pow(c, 1.0 / 2.4) - 0.055);
+}
+
+void load_row_linear_cpu(const CCodecBuffer &buffer,
+	const texel_layout_cpu *layout, CMP_DWORD y, bool srgb, float *rgba)
+{
+	const CMP_BYTE *pRow = buffer.GetData() + y * buffer.GetPitch();
+	const CMP_DWORD width = buffer.GetWidth();
+	const CodecBufferType type = buffer.GetBufferType();
+	const float *toLinear = srgb ? srgb16ToLinear() : nullptr;
+
+	for (CMP_DWORD x = 0; x < width; x++, rgba += 4)
+	{
+		switch (type)
+		{
+			case CBT_RGBA16:
+				load_texel_rgba16_cpu(
+					reinterpret_cast<const uint16_t *>(pRow) + x * 4, layout,
+					rgba);
+				break;
+
+			case CBT_RGBA16F:
+				// Half float colors are linear already
+				load_texel_rgba16f_cpu(
+					reinterpret_cast<const uint16_t *>(pRow) + x * 4, layout,
+					rgba);
+				continue;
+
+			default:
+				load_texel_rgba8_cpu(
+					pRow + x * layout->texel_size, layout, rgba);
+				break;
+		}
+
+		if (toLinear)
+		{
+			for (int c = 0; c < 3; c++)
+				rgba[c] = toLinear[int(rgba[c] * 65535.0f + 0.5f)];
+		}
+	}
+}
+
+void store_row_linear_cpu(
+	CCodecBuffer &buffer, CMP_DWORD y, bool srgb, const float *rgba)
+{
+	CMP_BYTE *pRow = buffer.GetData() + y * buffer.GetPitch();
+	const CMP_DWORD width = buffer.GetWidth();
+	const CodecBufferType type = buffer.GetBufferType();
+
+	for (CMP_DWORD x = 0; x < width; x++, rgba += 4)
+	{
+		// The Kaiser filter may ring below zero
+		float value[4];
+		for (int c = 0; c < 4; c++)
+			value[c] = rgba[c] > 0.f ? rgba[c] : 0.f;
+		value[3] = std::min(value[3], 1.f);
+
+		switch (type)
+		{
+			case CBT_RGBA16F:
+			{
+				auto pTexel = reinterpret_cast<uint16_t *>(pRow) + x * 4;
+				for (int c = 0; c < 4; c++)
+					pTexel[c] = float_to_sf16(value[c], SF_NEARESTEVEN);
+				break;
+			}
+
+			case CBT_RGBA16:
+			{
+				auto pTexel = reinterpret_cast<uint16_t *>(pRow) + x * 4;
+				for (int c = 0; c < 4; c++)
+				{
+					float v = std::min(value[c], 1.f);
+					if (srgb && c < 3)
+						v = linearToSRGB16(v);
+					pTexel[c] = uint16_t(v * 65535.0f + 0.5f);
+				}
+				break;
+			}
+
+			default:
+				if (srgb)
+				{
+					for (int c = 0; c < 3; c++)
+						value[c] = ASTC_Encoder::linear_to_srgb(value[c]);
+				}
+				store_texel_rgba8_cpu(
+					value, &texel_layout_rgba8_cpu, pRow + x * 4);
+				break;
+		}
+	}
+}
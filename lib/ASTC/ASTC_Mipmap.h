@@ -0,0 +1,91 @@
+//===============================================================================
+// Copyright (c) 2014-2016  Advanced Micro Devices, Inc. All rights reserved.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ASTC_Mipmap.h : Mip level downsampling for the encoder
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ASTC_MIPMAP_H_
+#define _ASTC_MIPMAP_H_
+
+#include "ASTC_Host.h"
+#include "Buffer/CodecBuffer.h"
+
+#include <functional>
+#include <vector>
+
+enum ASTCMipmapFilter
+{
+	ASTC_MIPMAP_BOX, // average of the covered texels
+	ASTC_MIPMAP_KAISER, // Kaiser windowed sinc, keeps more detail
+};
+
+// Resamples images of linear RGBA float texels with a separable filter.
+// Source rows are fetched on demand and filtered horizontally once, only
+// the rows under the vertical filter are kept.
+class ASTCMipmapResampler
+{
+public:
+	// Reads source row y as linear RGBA floats
+	typedef std::function<void(CMP_DWORD y, float *rgba)> RowReader;
+
+	ASTCMipmapResampler(ASTCMipmapFilter filter, CMP_DWORD srcWidth,
+		CMP_DWORD srcHeight, CMP_DWORD dstWidth, CMP_DWORD dstHeight);
+
+	// Writes dstWidth x dstHeight texels to out, rows are dstWidth apart
+	void resample(const RowReader &reader, float *out) const;
+
+	// Number of levels of a full mip chain, down to 1x1
+	static CMP_DWORD levelCount(CMP_DWORD width, CMP_DWORD height);
+
+private:
+	// Source texels contributing to one destination texel. Texels past
+	// the image border are clamped, their weights go to the edge texels.
+	struct Taps
+	{
+		CMP_DWORD first;
+		std::vector<float> weights;
+	};
+
+	static std::vector<Taps> makeTaps(
+		ASTCMipmapFilter filter, CMP_DWORD srcSize, CMP_DWORD dstSize);
+
+	CMP_DWORD srcWidth;
+	CMP_DWORD srcHeight;
+	CMP_DWORD dstWidth;
+	CMP_DWORD dstHeight;
+	std::vector<Taps> tapsX;
+	std::vector<Taps> tapsY;
+};
+
+// Reads row y of a CBT_RGBA8888, CBT_RGBA16 or CBT_RGBA16F buffer with the
+// given layout as linear RGBA floats. 8 and 16-bit colors are taken as
+// sRGB encoded when srgb is set.
+void load_row_linear_cpu(const CCodecBuffer &buffer,
+	const texel_layout_cpu *layout, CMP_DWORD y, bool srgb, float *rgba);
+
+// Stores linear RGBA floats as row y of a buffer of straight R, G, B, A
+// texels, the reverse of load_row_linear_cpu.
+void store_row_linear_cpu(
+	CCodecBuffer &buffer, CMP_DWORD y, bool srgb, const float *rgba);
+
+#endif
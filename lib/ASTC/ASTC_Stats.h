@@ -0,0 +1,129 @@
+//===============================================================================
+// Copyright (c) 2014-2016  Advanced Micro Devices, Inc. All rights reserved.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ASTC_Stats.h : Optional statistics of the encoder
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ASTC_STATS_H_
+#define _ASTC_STATS_H_
+
+#include "CommonTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where the search for the encoding of a block stopped
+enum ASTCEncodeExit
+{
+	ASTC_EXIT_CONSTANT, // single color or fully transparent block
+	ASTC_EXIT_MODE_0, // 1 partition and 1 plane met the error limit
+	ASTC_EXIT_2_PLANES, // 1 partition and 2 planes met the error limit
+	ASTC_EXIT_PARTITIONS, // 2 to 4 partitions met the error limit
+	ASTC_EXIT_PARTITION_1_TO_2, // 2 partitions not enough better than 1
+	ASTC_EXIT_END, // every mode was tried
+	ASTC_EXIT_COUNT
+};
+
+enum ASTCEncodeStage
+{
+	ASTC_STAGE_FETCH, // loading the texels of a block
+	ASTC_STAGE_PREPARE, // error weights and block statistics
+	ASTC_STAGE_MODE_0, // 1 partition, 1 plane
+	ASTC_STAGE_2_PLANES, // 1 partition, 2 planes
+	ASTC_STAGE_PARTITION_SEARCH, // choice of the partitionings to try
+	ASTC_STAGE_PARTITIONS, // 2 to 4 partitions, 1 and 2 planes
+	ASTC_STAGE_PACK, // symbolic to physical block
+	ASTC_STAGE_COUNT
+};
+
+enum
+{
+	ASTC_BLOCK_MODE_COUNT = 2048
+};
+
+// Counters of an encode, summed across workers. Stage times are the sum
+// of the time each worker spent in them, not wall clock time of the whole
+// encode.
+struct ASTCEncodeStats
+{
+	CMP_DWORD blocks;
+	CMP_DWORD exits[ASTC_EXIT_COUNT];
+	// Partition count of the chosen encodings, 0 for constant blocks
+	CMP_DWORD partitionCounts[5];
+	CMP_DWORD dualPlaneBlocks;
+	// Chosen block modes, constant blocks excluded
+	CMP_DWORD blockModes[ASTC_BLOCK_MODE_COUNT];
+	// Searches with a fixed partitioning and plane setup, each of them
+	// giving up to 4 candidate encodings
+	uint64_t trials;
+	// Candidate encodings decoded to measure their error
+	uint64_t decodes;
+	double stageSeconds[ASTC_STAGE_COUNT];
+
+	ASTCEncodeStats();
+
+	void reset();
+	void add(const ASTCEncodeStats &other);
+};
+
+enum ASTCHeatmap
+{
+	ASTC_HEATMAP_SECONDS, // encode time of each block
+	ASTC_HEATMAP_TRIALS, // searches made for each block
+	ASTC_HEATMAP_ERROR, // error of the chosen encoding
+	ASTC_HEATMAP_COUNT
+};
+
+// Cost and error of every block of an encode, in the order the blocks are
+// stored: x first, then y, then z.
+struct ASTCBlockCosts
+{
+	CMP_DWORD columns;
+	CMP_DWORD rows;
+	CMP_DWORD layers;
+	// From fetching the texels to packing the block
+	std::vector<float> seconds;
+	// Searches with a fixed partitioning and plane setup, as counted by
+	// ASTCEncodeStats::trials
+	std::vector<uint32_t> trials;
+	// Weighted squared error per texel that the encoder minimized, in its
+	// 16-bit color scale. 0 for constant blocks.
+	std::vector<float> errors;
+
+	ASTCBlockCosts();
+
+	void reset(CMP_DWORD columns, CMP_DWORD rows, CMP_DWORD layers);
+	size_t size() const;
+	float value(ASTCHeatmap which, size_t index) const;
+	float maxValue(ASTCHeatmap which) const;
+
+	// Renders one gray texel per block, layers stacked top to bottom, as
+	// rows of 8-bit gray like QImage::Format_Grayscale8. Values from 0 to
+	// maxValue go from black to white, a maxValue of 0 stands for the
+	// largest value.
+	void heatmap(ASTCHeatmap which, float maxValue, CMP_BYTE *pData,
+		ptrdiff_t pitch) const;
+};
+
+#endif
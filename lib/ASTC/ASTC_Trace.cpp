@@ -0,0 +1,194 @@
+//===============================================================================
+// Copyright (c) 2007-2016  Advanced Micro Devices, Inc. All rights reserved.
+// Copyright (c) 2004-2006 ATI Technologies Inc.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// ASTC_Trace.cpp : Chrome trace events of the encoder and decoder
+//
+
+#include "ASTC/ASTC_Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct trace_event
+{
+	const char *name;
+	const char *category;
+	ASTCTrace::Clock::time_point begin;
+	ASTCTrace::Clock::time_point end;
+	const char *argKeys[3];
+	long long args[3];
+	int argCount;
+};
+
+// Events of one thread. Its mutex is only ever taken by that thread and
+// by stop(), so recording does not contend.
+struct trace_thread
+{
+	std::mutex mutex;
+	std::vector<trace_event> events;
+	const char *name;
+	int id;
+};
+
+std::atomic<bool> ASTCTrace::sEnabled(false);
+
+static std::mutex trace_mutex;
+static FILE *trace_file = nullptr;
+static ASTCTrace::Clock::time_point trace_begin;
+// Counts traces, buffers of an older one are not used again
+static std::atomic<unsigned> trace_generation(0);
+static std::vector<std::shared_ptr<trace_thread>> trace_threads;
+
+static thread_local std::shared_ptr<trace_thread> current_thread;
+static thread_local unsigned current_generation = 0;
+static thread_local const char *current_thread_name = nullptr;
+
+bool ASTCTrace::start(const char *path)
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (trace_file)
+		return false;
+
+	trace_file = fopen(path, "w");
+	if (!trace_file)
+		return false;
+
+	trace_threads.clear();
+	trace_begin = Clock::now();
+	trace_generation++;
+	sEnabled = true;
+	return true;
+}
+
+static double trace_microseconds(ASTCTrace::Clock::time_point time)
+{
+	return std::chrono::duration<double, std::micro>(time - trace_begin)
+		.count();
+}
+
+bool ASTCTrace::stop()
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (!trace_file)
+		return false;
+
+	sEnabled = false;
+
+	FILE *file = trace_file;
+	trace_file = nullptr;
+	fprintf(file,
+		"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+		"\"args\":{\"name\":\"qastc\"}}");
+	for (auto &thread : trace_threads)
+	{
+		std::lock_guard<std::mutex> threadLock(thread->mutex);
+		if (thread->name)
+		{
+			fprintf(file,
+				",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+				"\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				thread->id, thread->name);
+		}
+
+		for (auto &event : thread->events)
+		{
+			fprintf(file,
+				",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+				"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				event.name, event.category, thread->id,
+				trace_microseconds(event.begin),
+				trace_microseconds(event.end) -
+					trace_microseconds(event.begin));
+			if (event.argCount > 0)
+			{
+				fprintf(file, ",\"args\":{");
+				for (int i = 0; i < event.argCount; i++)
+				{
+					fprintf(file, "%s\"%s\":%lld", i > 0 ? "," : "",
+						event.argKeys[i], event.args[i]);
+				}
+				fprintf(file, "}");
+			}
+			fprintf(file, "}");
+		}
+	}
+	fprintf(file, "\n]}\n");
+	trace_threads.clear();
+
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+void ASTCTrace::setThreadName(const char *name)
+{
+	current_thread_name = name;
+	if (current_thread && current_generation == trace_generation)
+	{
+		std::lock_guard<std::mutex> lock(current_thread->mutex);
+		current_thread->name = name;
+	}
+}
+
+void ASTCTrace::add(const char *name, const char *category,
+	Clock::time_point begin, Clock::time_point end,
+	const char *const *argKeys, const long long *args, int argCount)
+{
+	if (current_generation != trace_generation)
+	{
+		// First event of this thread in the running trace
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		if (!trace_file)
+			return;
+
+		current_thread = std::make_shared<trace_thread>();
+		current_thread->name = current_thread_name;
+		current_thread->id = int(trace_threads.size()) + 1;
+		current_generation = trace_generation;
+		trace_threads.push_back(current_thread);
+	}
+
+	trace_event event;
+	event.name = name;
+	event.category = category;
+	event.begin = begin;
+	event.end = end;
+	event.argCount = std::min(argCount, 3);
+	for (int i = 0; i < event.argCount; i++)
+	{
+		event.argKeys[i] = argKeys[i];
+		event.args[i] = args[i];
+	}
+
+	std::lock_guard<std::mutex> lock(current_thread->mutex);
+	current_thread->events.push_back(event);
+}
+
+const char *ASTCTrace::environmentPath()
+{
+	const char *path = getenv("QASTC_TRACE");
+	return path && *path ? path : nullptr;
+}
@@ -0,0 +1,120 @@
+//===============================================================================
+// Copyright (c) 2014-2016  Advanced Micro Devices, Inc. All rights reserved.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// ASTC_Trace.h : Chrome trace events of the encoder and decoder
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ASTC_TRACE_H_
+#define _ASTC_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+
+// Records spans of every thread and writes them as a Chrome trace event
+// JSON file, which Perfetto or chrome://tracing open. Tracing is compiled
+// in and off until started, a span then costs one atomic load.
+//
+// The QASTC_TRACE environment variable names the file of a trace covering
+// a whole program, started and stopped by the program itself.
+class ASTCTrace
+{
+public:
+	// Value of QASTC_TRACE, nullptr when it is not set or empty
+	static const char *environmentPath();
+	// Starts recording to the given file, false when it cannot be created
+	// or a trace is already running
+	static bool start(const char *path);
+	// Writes the recorded events, false on I/O errors
+	static bool stop();
+
+	static bool isEnabled()
+	{
+		return sEnabled.load(std::memory_order_relaxed);
+	}
+
+	// Name shown for the calling thread, a string literal
+	static void setThreadName(const char *name);
+
+	typedef std::chrono::steady_clock Clock;
+
+	// Adds a complete event of the calling thread. Names, categories and
+	// argument keys are string literals.
+	static void add(const char *name, const char *category,
+		Clock::time_point begin, Clock::time_point end,
+		const char *const *argKeys, const long long *args, int argCount);
+
+private:
+	static std::atomic<bool> sEnabled;
+};
+
+// Span from construction to destruction, with up to 3 integer arguments
+class ASTCTraceScope
+{
+public:
+	ASTCTraceScope(const char *name, const char *category)
+		: m_Name(name)
+		, m_Category(category)
+		, m_ArgCount(0)
+		, m_Active(ASTCTrace::isEnabled())
+	{
+		if (m_Active)
+			m_Begin = ASTCTrace::Clock::now();
+	}
+
+	~ASTCTraceScope()
+	{
+		if (m_Active)
+		{
+			ASTCTrace::add(m_Name, m_Category, m_Begin,
+				ASTCTrace::Clock::now(), m_ArgKeys, m_Args, m_ArgCount);
+		}
+	}
+
+	void arg(const char *key, long long value)
+	{
+		if (m_Active && m_ArgCount < MAX_ARGS)
+		{
+			m_ArgKeys[m_ArgCount] = key;
+			m_Args[m_ArgCount++] = value;
+		}
+	}
+
+	ASTCTraceScope(const ASTCTraceScope &) = delete;
+	ASTCTraceScope &operator=(const ASTCTraceScope &) = delete;
+
+private:
+	enum
+	{
+		MAX_ARGS = 3
+	};
+
+	const char *m_Name;
+	const char *m_Category;
+	const char *m_ArgKeys[MAX_ARGS];
+	long long m_Args[MAX_ARGS];
+	int m_ArgCount;
+	bool m_Active;
+	ASTCTrace::Clock::time_point m_Begin;
+};
+
+#endif
@@ -30,16 +30,21 @@
 #include "Codec_ASTC.h"
 
 #include "ASTC_Host.h"
+#include "ASTC_Trace.h"
 #include "ARM/astc_codec_internals.h"
 #include "Buffer/CodecBuffer.h"
 #include "MathMacros.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <atomic>
 #include <thread>
 #include <vector>
 #include <memory>
 #include <queue>
+#include <condition_variable>
 
 #include <mutex>
 
@@ -64,15 +69,38 @@ const astc_block_size_t ASTC_VALID_BLOCK_SIZE[ASTC_VALID_BLOCK] = {
 	{ 12, 12 }, //
 };
 
+const astc_block_size_3d_t ASTC_VALID_BLOCK_SIZE_3D[ASTC_VALID_BLOCK_3D] = {
+	{ 3, 3, 3 }, //
+	{ 4, 3, 3 }, //
+	{ 4, 4, 3 }, //
+	{ 4, 4, 4 }, //
+	{ 5, 4, 4 }, //
+	{ 5, 5, 4 }, //
+	{ 5, 5, 5 }, //
+	{ 6, 5, 5 }, //
+	{ 6, 6, 5 }, //
+	{ 6, 6, 6 }, //
+};
+
+const astc_quality_tier_t ASTC_QUALITY_TIER[ASTC_QUALITY_TIER_COUNT] = {
+	{ "veryfast", 0.1 }, //
+	{ "fast", 0.3 }, //
+	{ "medium", 0.6 }, //
+	{ "thorough", 0.8 }, //
+	{ "exhaustive", 0.95 }, //
+};
+
 //======================================================================================
 struct ASTCEncodeBlockData
 {
 	// Encoder params
 	ASTC_Encoder::compress_symbolic_block_buffers *buffers;
-	astc_codec_image *input_image;
+	const image_source_cpu *input_image;
 	CMP_BYTE *bp;
 	int x;
 	int y;
+	int z;
+	int slot; // block row slot of a streaming encode, or -1
 
 	void encode(ASTC_Encoder::ASTC_Encode *encoder);
 };
@@ -85,9 +113,24 @@ struct ASTCEncodeQueue
 	std::queue<ASTCEncodeBlockData> blocks;
 	std::vector<std::unique_ptr<ASTCEncodeThread>> threads;
 
+	// Streaming mode: workers wait for more blocks until closed, and
+	// count the blocks still to be encoded in each block row slot.
+	bool streaming;
+	bool closed;
+	std::condition_variable blocksAdded;
+	std::condition_variable slotDone;
+	std::vector<CMP_DWORD> slotPending;
+
+	// Statistics the workers add theirs to as they finish, or nullptr
+	ASTCEncodeStats *stats;
+	// Costs the workers record their blocks in, or nullptr
+	ASTCBlockCosts *costs;
+
+	ASTCEncodeQueue();
 	~ASTCEncodeQueue();
 
 	void start(size_t maxThreadCount, ASTC_Encoder::ASTC_Encode *encoder);
+	void close();
 };
 
 struct ASTCEncodeThread
@@ -102,11 +145,57 @@ private:
 	ASTCEncodeQueue *queue;
 	ASTC_Encoder::ASTC_Encode *encoder;
 	ASTC_Encoder::compress_symbolic_block_buffers buffers;
+	ASTCEncodeStats stats;
 
 	std::thread thread;
 	void work();
 };
 
+struct ASTCScaleAccumulator
+{
+	ASTCScaleAccumulator(CMP_DWORD srcWidth, CMP_DWORD srcHeight,
+		CMP_DWORD dstWidth, CMP_DWORD dstHeight);
+
+	// Adds a source rectangle of a single color, in source texel units
+	void add(double x0, double y0, double x1, double y1, const float color[4]);
+	// Adds a single source texel
+	void add(CMP_DWORD x, CMP_DWORD y, const CMP_COLOR &color);
+	// Stores the averaged colors with the given layout
+	void store(CMP_BYTE *pDataOut, CMP_DWORD dwPitch,
+		const texel_layout_cpu &layout, bool flipY) const;
+
+private:
+	// Destination pixels covered by a source texel along one axis.
+	// When downscaling a texel covers at most two of them.
+	struct Span
+	{
+		CMP_DWORD index;
+		float cover[2];
+	};
+
+	static std::vector<Span> makeSpans(
+		CMP_DWORD srcSize, CMP_DWORD dstSize, double scale);
+	void add(CMP_DWORD index, float area, const float color[4]);
+
+	CMP_DWORD width;
+	CMP_DWORD height;
+	double scaleX;
+	double scaleY;
+	std::vector<Span> spansX;
+	std::vector<Span> spansY;
+	std::vector<float> colors;
+	std::vector<float> areas;
+};
+
+static void initImageSource(image_source_cpu &image,
+	CCodecBuffer &buffer, const texel_layout_cpu *layout, bool flipY);
+static ASTC_Encoder::ASTC_Encode *createDecodeParams(
+	CMP_BYTE xdim, CMP_BYTE ydim, CMP_BYTE zdim, bool srgb);
+static texel_layout_cpu texelLayout(ASTCTexelFormat format);
+static texel_layout_cpu sourceLayout(
+	ASTCTexelFormat format, CodecBufferType type);
+static bool isTexelBuffer(CodecBufferType type);
+
 //////////////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////////////
@@ -116,7 +205,110 @@ CCodec_ASTC::CCodec_ASTC()
 	m_NumThreads = sDefaultEncodeThreads;
 	m_xdim = 4;
 	m_ydim = 4;
+	m_zdim = 1;
 	m_Quality = 0.5;
+	m_IgnoreTransparentRGB = false;
+	m_TexelFormat = ASTC_TEXEL_RGBA8888;
+	m_FlipY = false;
+	m_SRGB = false;
+}
+
+ASTCEncodeStats::ASTCEncodeStats()
+{
+	reset();
+}
+
+void ASTCEncodeStats::reset()
+{
+	blocks = 0;
+	std::fill(std::begin(exits), std::end(exits), 0);
+	std::fill(std::begin(partitionCounts), std::end(partitionCounts), 0);
+	dualPlaneBlocks = 0;
+	std::fill(std::begin(blockModes), std::end(blockModes), 0);
+	trials = 0;
+	decodes = 0;
+	std::fill(std::begin(stageSeconds), std::end(stageSeconds), 0.0);
+}
+
+void ASTCEncodeStats::add(const ASTCEncodeStats &other)
+{
+	blocks += other.blocks;
+	for (int i = 0; i < ASTC_EXIT_COUNT; i++)
+		exits[i] += other.exits[i];
+	for (int i = 0; i < 5; i++)
+		partitionCounts[i] += other.partitionCounts[i];
+	dualPlaneBlocks += other.dualPlaneBlocks;
+	for (int i = 0; i < ASTC_BLOCK_MODE_COUNT; i++)
+		blockModes[i] += other.blockModes[i];
+	trials += other.trials;
+	decodes += other.decodes;
+	for (int i = 0; i < ASTC_STAGE_COUNT; i++)
+		stageSeconds[i] += other.stageSeconds[i];
+}
+
+ASTCBlockCosts::ASTCBlockCosts()
+	: columns(0)
+	, rows(0)
+	, layers(0)
+{
+}
+
+void ASTCBlockCosts::reset(
+	CMP_DWORD columns, CMP_DWORD rows, CMP_DWORD layers)
+{
+	this->columns = columns;
+	this->rows = rows;
+	this->layers = layers;
+	seconds.assign(size(), 0.f);
+	trials.assign(size(), 0);
+	errors.assign(size(), 0.f);
+}
+
+size_t ASTCBlockCosts::size() const
+{
+	return size_t(columns) * rows * layers;
+}
+
+float ASTCBlockCosts::value(ASTCHeatmap which, size_t index) const
+{
+	switch (which)
+	{
+		case ASTC_HEATMAP_SECONDS:
+			return seconds[index];
+
+		case ASTC_HEATMAP_TRIALS:
+			return float(trials[index]);
+
+		case ASTC_HEATMAP_ERROR:
+		default:
+			return errors[index];
+	}
+}
+
+float ASTCBlockCosts::maxValue(ASTCHeatmap which) const
+{
+	float result = 0.f;
+	for (size_t i = 0; i < size(); i++)
+		result = std::max(result, value(which, i));
+	return result;
+}
+
+void ASTCBlockCosts::heatmap(ASTCHeatmap which, float maxValue,
+	CMP_BYTE *pData, ptrdiff_t pitch) const
+{
+	if (maxValue <= 0.f)
+		maxValue = this->maxValue(which);
+	float scale = maxValue > 0.f ? 255.f / maxValue : 0.f;
+
+	for (CMP_DWORD row = 0; row < rows * layers; row++)
+	{
+		CMP_BYTE *pRow = pData + row * pitch;
+		for (CMP_DWORD column = 0; column < columns; column++)
+		{
+			float gray = value(which, size_t(row) * columns + column) * scale;
+			pRow[column] = CMP_BYTE(std::min(gray, 255.f) + 0.5f);
+		}
+	}
 }
 
 CMP_BYTE CCodec_ASTC::getDefaultEncodeThreads()
@@ -138,16 +330,24 @@ bool CCodec_ASTC::isValidBlockSize(int w, int h, int d)
 			if (w == size.w && h == size.h)
 				return true;
 		}
+	} else
+	{
+		for (auto &size : ASTC_VALID_BLOCK_SIZE_3D)
+		{
+			if (w == size.w && h == size.h && d == size.d)
+				return true;
+		}
 	}
 	return false;
 }
 
-bool CCodec_ASTC::setBlockRate(int x, int y)
+bool CCodec_ASTC::setBlockRate(int x, int y, int z)
 {
-	if (isValidBlockSize(x, y))
+	if (isValidBlockSize(x, y, z))
 	{
 		m_xdim = x;
 		m_ydim = y;
+		m_zdim = z;
 		return true;
 	}
 	return false;
@@ -156,7 +356,14 @@ bool CCodec_ASTC::setBlockRate(int x, int y)
 CodecError CCodec_ASTC::Compress(
 	CCodecBuffer &bufferIn, CCodecBuffer &bufferOut)
 {
-	if (bufferIn.GetBufferType() != CBT_RGBA8888)
+	return Compress(bufferIn, bufferOut, nullptr);
+}
+
+CodecError CCodec_ASTC::Compress(CCodecBuffer &bufferIn,
+	CCodecBuffer &bufferOut, ASTCEncodeStats *pStats, ASTCBlockCosts *pCosts)
+{
+	ASTCTraceScope trace("Compress", "codec");
+	if (!isTexelBuffer(bufferIn.GetBufferType()))
 	{
 		printf("Unsupported type of input buffer\n");
 		return CE_Unknown;
@@ -168,207 +375,1262 @@ CodecError CCodec_ASTC::Compress(
 		return CE_Unknown;
 	}
 
-	int xsize = bufferIn.GetWidth();
-	int ysize = bufferIn.GetHeight();
 	m_xdim = bufferOut.GetBlockWidth();
 	m_ydim = bufferOut.GetBlockHeight();
+	m_zdim = bufferOut.GetBlockDepth();
 
-	astc_codec_image_cpu *input_image =
-		allocate_image_cpu(8, xsize, ysize, 1, 0);
+	texel_layout_cpu layout =
+		sourceLayout(m_TexelFormat, bufferIn.GetBufferType());
 
-	if (!input_image)
-	{
-		printf("Unable to allocate image buffer\n");
-		return CE_Unknown;
-	}
-
-	auto pData = bufferIn.GetData();
-	for (int y = ysize - 1; y >= 0; y--)
-	{
-		memcpy(input_image->imagedata8[0][y], pData, bufferIn.GetPitch());
-		pData += bufferIn.GetPitch();
-	}
+	// Blocks are fetched straight from the input buffer
+	image_source_cpu input_image;
+	initImageSource(input_image, bufferIn, &layout, m_FlipY);
 
 	int xdim = m_xdim;
 	int ydim = m_ydim;
+	int zdim = m_zdim;
 	CMP_BYTE *bufferOutput = bufferOut.GetData();
 
 	int xblocks = bufferOut.GetColumns();
 	int yblocks = bufferOut.GetRows();
+	int zblocks = bufferOut.GetLayers();
 
 	std::unique_ptr<ASTC_Encoder::ASTC_Encode> encoder(
-		new ASTC_Encoder::ASTC_Encode);
-	encoder->m_decode_mode = ASTC_DECODE_HDR;
-	encoder->m_rgb_force_use_of_hdr = 0;
-	encoder->m_alpha_force_use_of_hdr = 0;
-	encoder->m_perform_srgb_transform = 0;
-	encoder->m_Quality = (float) m_Quality;
-	encoder->m_xdim = m_xdim;
-	encoder->m_ydim = m_ydim;
-	encoder->m_zdim = 1;
-	ASTC_Encoder::init_ASTC(encoder.get());
+		createEncodeParams(bufferIn));
 	{
 		// setup compression threads for each
 		// block to encode  we will load the buffer to pass to ASTC code as 8 bit 4x4 blocks
 		// the fill in source image. ASTC code will then use the adaptive sizes for process on the input
-		CMP_WORD numEncodingThreads = MIN(m_NumThreads, sMaxEncodeThreads);
-		if (numEncodingThreads == 0)
-			numEncodingThreads = 1;
+		CMP_WORD numEncodingThreads = encodeThreadCount();
 		std::unique_ptr<ASTCEncodeQueue> queue;
 		std::unique_ptr<ASTC_Encoder::compress_symbolic_block_buffers> buffers;
+		std::unique_ptr<ASTCEncodeStats> costStats;
+		if (pStats)
+			pStats->reset();
+		if (pCosts)
+			pCosts->reset(xblocks, yblocks, zblocks);
+
 		if (numEncodingThreads > 1)
 		{
 			queue.reset(new ASTCEncodeQueue);
-
+			queue->stats = pStats;
+			queue->costs = pCosts;
 		} else
 		{
 			buffers.reset(new ASTC_Encoder::compress_symbolic_block_buffers);
+			buffers->stats = pStats;
+			buffers->costs = pCosts;
+			// Trials of block costs are counted by the statistics
+			if (pCosts && !pStats)
+			{
+				costStats.reset(new ASTCEncodeStats);
+				buffers->stats = costStats.get();
+			}
 		}
 
+		// Blocks of every layer go to the same queue, so workers are
+		// kept busy across layers of a volume too
 		ASTCEncodeBlockData blockData;
 		blockData.buffers = buffers.get();
-		for (int y = 0; y < yblocks; y++)
+		blockData.slot = -1;
+		for (int z = 0; z < zblocks; z++)
+		{
+			for (int y = 0; y < yblocks; y++)
+			{
+				int yoffset = (z * yblocks + y) * xblocks;
+				for (int x = 0; x < xblocks; x++)
+				{
+					int offset = (yoffset + x) * ASTC_COMPRESSED_BLOCK_SIZE;
+					CMP_BYTE *bp = bufferOutput + offset;
+
+					blockData.input_image = &input_image;
+					blockData.bp = bp;
+					blockData.x = x * xdim;
+					blockData.y = y * ydim;
+					blockData.z = z * zdim;
+
+					if (numEncodingThreads > 1)
+					{
+						queue->blocks.push(blockData);
+					} else
+					{
+						blockData.encode(encoder.get());
+					}
+				}
+			}
+		}
+
+		if (numEncodingThreads > 1)
+		{
+			queue->start(numEncodingThreads, encoder.get());
+		}
+	} // all threads join here
+
+	return CE_OK;
+}
+
+CodecError CCodec_ASTC::CompressBlockRows(CCodecBuffer &bufferIn,
+	CMP_BYTE nBlockWidth, CMP_BYTE nBlockHeight, const BlockRowWriter &writer,
+	CMP_BYTE nBlockDepth)
+{
+	ASTCTraceScope trace("CompressBlockRows", "codec");
+	if (!isTexelBuffer(bufferIn.GetBufferType()))
+	{
+		printf("Unsupported type of input buffer\n");
+		return CE_Unknown;
+	}
+
+	if (!setBlockRate(nBlockWidth, nBlockHeight, nBlockDepth))
+	{
+		printf("Invalid block size\n");
+		return CE_Unknown;
+	}
+
+	texel_layout_cpu layout =
+		sourceLayout(m_TexelFormat, bufferIn.GetBufferType());
+
+	image_source_cpu input_image;
+	initImageSource(input_image, bufferIn, &layout, m_FlipY);
+
+	const int xblocks = (input_image.xsize + nBlockWidth - 1) / nBlockWidth;
+	const int yblocks = (input_image.ysize + nBlockHeight - 1) / nBlockHeight;
+	const int zblocks = (input_image.zsize + nBlockDepth - 1) / nBlockDepth;
+	const CMP_DWORD dwBlockRowSize = xblocks * ASTC_COMPRESSED_BLOCK_SIZE;
+
+	// Block rows of all layers, in file order
+	const int blockRows = yblocks * zblocks;
+
+	std::unique_ptr<ASTC_Encoder::ASTC_Encode> encoder(
+		createEncodeParams(bufferIn));
+
+	CMP_WORD numEncodingThreads = encodeThreadCount();
+
+	ASTCEncodeBlockData blockData;
+	blockData.input_image = &input_image;
+
+	if (numEncodingThreads <= 1)
+	{
+		std::unique_ptr<ASTC_Encoder::compress_symbolic_block_buffers> buffers(
+			new ASTC_Encoder::compress_symbolic_block_buffers);
+		std::vector<CMP_BYTE> blockRow(dwBlockRowSize);
+
+		blockData.buffers = buffers.get();
+		blockData.slot = -1;
+		for (int row = 0; row < blockRows; row++)
 		{
-			int yoffset = y * xblocks;
 			for (int x = 0; x < xblocks; x++)
 			{
-				int offset = (yoffset + x) * ASTC_COMPRESSED_BLOCK_SIZE;
-				CMP_BYTE *bp = bufferOutput + offset;
+				blockData.bp = &blockRow[x * ASTC_COMPRESSED_BLOCK_SIZE];
+				blockData.x = x * nBlockWidth;
+				blockData.y = (row % yblocks) * nBlockHeight;
+				blockData.z = (row / yblocks) * nBlockDepth;
+				blockData.encode(encoder.get());
+			}
+
+			if (!writer(blockRow.data(), dwBlockRowSize))
+				return CE_Aborted;
+		}
+
+		return CE_OK;
+	}
+
+	// Enough block rows in flight to keep every worker busy while the
+	// oldest one is waited for
+	const int windowSize = std::min(blockRows,
+		std::max(2, (2 * numEncodingThreads + xblocks - 1) / xblocks + 1));
+
+	// Declared before the queue, so workers are joined first
+	std::vector<CMP_BYTE> window(windowSize * dwBlockRowSize);
+
+	ASTCEncodeQueue queue;
+	queue.streaming = true;
+	queue.slotPending.resize(windowSize, 0);
+	queue.start(numEncodingThreads, encoder.get());
 
-				blockData.input_image = input_image;
-				blockData.bp = bp;
-				blockData.x = x * xdim;
-				blockData.y = y * ydim;
+	int queuedRows = 0;
+	for (int row = 0; row < blockRows; row++)
+	{
+		for (; queuedRows < blockRows && queuedRows < row + windowSize;
+			 queuedRows++)
+		{
+			int slot = queuedRows % windowSize;
+			CMP_BYTE *pRow = &window[slot * dwBlockRowSize];
+
+			std::lock_guard<std::mutex> lock(queue.blocksMutex);
+			queue.slotPending[slot] = xblocks;
+			blockData.slot = slot;
+			for (int x = 0; x < xblocks; x++)
+			{
+				blockData.bp = pRow + x * ASTC_COMPRESSED_BLOCK_SIZE;
+				blockData.x = x * nBlockWidth;
+				blockData.y = (queuedRows % yblocks) * nBlockHeight;
+				blockData.z = (queuedRows / yblocks) * nBlockDepth;
+				queue.blocks.push(blockData);
+			}
+			queue.blocksAdded.notify_all();
+		}
+
+		int slot = row % windowSize;
+		{
+			ASTCTraceScope trace("wait row", "queue");
+			std::unique_lock<std::mutex> lock(queue.blocksMutex);
+			queue.slotDone.wait(
+				lock, [&queue, slot] { return queue.slotPending[slot] == 0; });
+		}
+
+		if (!writer(&window[slot * dwBlockRowSize], dwBlockRowSize))
+		{
+			queue.close();
+			return CE_Aborted;
+		}
+	}
+
+	queue.close();
+	return CE_OK;
+}
+
+CodecError CCodec_ASTC::CompressMipmaps(CCodecBuffer &bufferIn,
+	CMP_BYTE nBlockWidth, CMP_BYTE nBlockHeight, ASTCMipmapFilter filter,
+	bool bGammaCorrect, const MipLevelWriter &writer, CMP_DWORD nLevels)
+{
+	ASTCTraceScope trace("CompressMipmaps", "codec");
+	const CodecBufferType type = bufferIn.GetBufferType();
+	if (!isTexelBuffer(type))
+	{
+		printf("Unsupported type of input buffer\n");
+		return CE_Unknown;
+	}
+
+	if (bufferIn.GetDepth() != 1)
+	{
+		printf("Mipmaps of volumes are not supported\n");
+		return CE_Unknown;
+	}
+
+	if (!setBlockRate(nBlockWidth, nBlockHeight))
+	{
+		printf("Invalid block size\n");
+		return CE_Unknown;
+	}
+
+	texel_layout_cpu layout = sourceLayout(m_TexelFormat, type);
+
+	// Downsampled levels are straight R, G, B, A texels of the input type
+	texel_layout_cpu levelLayout = texel_layout_rgba8_cpu;
+	levelLayout.opaque = layout.opaque || layout.texel_size == 1 ? 1 : 0;
+
+	CMP_DWORD levelCount = ASTCMipmapResampler::levelCount(
+		bufferIn.GetWidth(), bufferIn.GetHeight());
+	if (nLevels != 0)
+		levelCount = std::min(levelCount, nLevels);
+
+	// Set up once for all levels
+	std::unique_ptr<ASTC_Encoder::ASTC_Encode> encoder(
+		createEncodeParams(bufferIn));
+
+	// Declared before the queue, so workers are joined first
+	std::vector<std::unique_ptr<CCodecBuffer>> levelTexels(levelCount);
+	std::vector<std::unique_ptr<CCodecBuffer>> levelBlocks(levelCount);
+	std::vector<image_source_cpu> levelSources(levelCount);
+	std::unique_ptr<ASTC_Encoder::compress_symbolic_block_buffers> buffers;
+
+	CMP_WORD numEncodingThreads = encodeThreadCount();
+	ASTCEncodeQueue queue;
+	if (numEncodingThreads > 1)
+	{
+		queue.streaming = true;
+		queue.slotPending.resize(levelCount, 0);
+		queue.start(numEncodingThreads, encoder.get());
+	} else
+	{
+		buffers.reset(new ASTC_Encoder::compress_symbolic_block_buffers);
+	}
+
+	// Hands finished levels below the given one to the writer, in order
+	CMP_DWORD writtenLevels = 0;
+	auto writeLevels = [&](CMP_DWORD untilLevel, bool wait) {
+		for (; writtenLevels < untilLevel; writtenLevels++)
+		{
+			if (numEncodingThreads > 1)
+			{
+				ASTCTraceScope trace("wait level", "queue");
+				std::unique_lock<std::mutex> lock(queue.blocksMutex);
+				auto &pending = queue.slotPending[writtenLevels];
+				if (!wait && pending != 0)
+					return true;
+				queue.slotDone.wait(lock, [&pending] { return pending == 0; });
+			}
+
+			CCodecBuffer &blocks = *levelBlocks[writtenLevels];
+			if (!writer(writtenLevels, blocks.GetWidth(), blocks.GetHeight(),
+					blocks.GetData(), blocks.GetDataSize()))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	// Linear texels of the previous and the current level
+	std::vector<float> linear[2];
+
+	CMP_DWORD width = bufferIn.GetWidth();
+	CMP_DWORD height = bufferIn.GetHeight();
+	for (CMP_DWORD level = 0; level < levelCount; level++)
+	{
+		CCodecBuffer *texels = &bufferIn;
+		const texel_layout_cpu *texelsLayout = &layout;
+		if (level > 0)
+		{
+			CMP_DWORD srcWidth = width;
+			CMP_DWORD srcHeight = height;
+			width = std::max<CMP_DWORD>(width >> 1, 1);
+			height = std::max<CMP_DWORD>(height >> 1, 1);
+
+			// Level 1 is read from the input, the next ones from the
+			// unquantized texels of the level above
+			const std::vector<float> &src = linear[(level - 1) & 1];
+			std::vector<float> &dst = linear[level & 1];
+			dst.resize(width * height * 4);
+
+			ASTCTraceScope trace("downsample", "mipmap");
+			trace.arg("level", level);
+			ASTCMipmapResampler resampler(
+				filter, srcWidth, srcHeight, width, height);
+			resampler.resample(
+				[&](CMP_DWORD y, float *rgba) {
+					if (level == 1)
+					{
+						load_row_linear_cpu(
+							bufferIn, &layout, y, bGammaCorrect, rgba);
+					} else
+					{
+						auto pRow = src.begin() + y * srcWidth * 4;
+						std::copy(pRow, pRow + srcWidth * 4, rgba);
+					}
+				},
+				dst.data());
+
+			levelTexels[level].reset(
+				CreateCodecBuffer(type, 0, 0, 0, width, height));
+			texels = levelTexels[level].get();
+			texelsLayout = &levelLayout;
+			for (CMP_DWORD y = 0; y < height; y++)
+			{
+				store_row_linear_cpu(
+					*texels, y, bGammaCorrect, &dst[y * width * 4]);
+			}
+		}
+
+		image_source_cpu &input_image = levelSources[level];
+		initImageSource(input_image, *texels, texelsLayout, m_FlipY);
+
+		levelBlocks[level].reset(
+			CreateBuffer(nBlockWidth, nBlockHeight, 1, width, height));
+		CCodecBuffer &blocks = *levelBlocks[level];
+		const int xblocks = int(blocks.GetColumns());
+		const int yblocks = int(blocks.GetRows());
+
+		ASTCEncodeBlockData blockData;
+		blockData.buffers = buffers.get();
+		blockData.input_image = &input_image;
+		blockData.z = 0;
+		blockData.slot = numEncodingThreads > 1 ? int(level) : -1;
+
+		// Workers go on with this level while the next one is made
+		std::unique_lock<std::mutex> lock(queue.blocksMutex, std::defer_lock);
+		if (numEncodingThreads > 1)
+		{
+			lock.lock();
+			queue.slotPending[level] = xblocks * yblocks;
+		}
+		for (int y = 0; y < yblocks; y++)
+		{
+			for (int x = 0; x < xblocks; x++)
+			{
+				blockData.bp = blocks.GetData() +
+					(y * xblocks + x) * ASTC_COMPRESSED_BLOCK_SIZE;
+				blockData.x = x * nBlockWidth;
+				blockData.y = y * nBlockHeight;
 
 				if (numEncodingThreads > 1)
 				{
-					queue->blocks.push(blockData);
+					queue.blocks.push(blockData);
 				} else
 				{
 					blockData.encode(encoder.get());
 				}
 			}
 		}
+		if (numEncodingThreads > 1)
+		{
+			queue.blocksAdded.notify_all();
+			lock.unlock();
+		}
+
+		if (!writeLevels(level, false))
+		{
+			queue.close();
+			return CE_Aborted;
+		}
+	}
+
+	if (!writeLevels(levelCount, true))
+	{
+		queue.close();
+		return CE_Aborted;
+	}
+
+	queue.close();
+	return CE_OK;
+}
 
+CodecError CCodec_ASTC::TuneQuality(CCodecBuffer &bufferIn,
+	CMP_BYTE nBlockWidth, CMP_BYTE nBlockHeight, double dSeconds,
+	ASTCQualityTuning &tuning, CMP_DWORD nSampleBlocks, CMP_BYTE nBlockDepth)
+{
+	ASTCTraceScope trace("TuneQuality", "codec");
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point tuningStart = Clock::now();
+
+	if (!isTexelBuffer(bufferIn.GetBufferType()))
+	{
+		printf("Unsupported type of input buffer\n");
+		return CE_Unknown;
+	}
+
+	if (!setBlockRate(nBlockWidth, nBlockHeight, nBlockDepth))
+	{
+		printf("Invalid block size\n");
+		return CE_Unknown;
+	}
+
+	const int xblocks = int((bufferIn.GetWidth() + m_xdim - 1) / m_xdim);
+	const int yblocks = int((bufferIn.GetHeight() + m_ydim - 1) / m_ydim);
+	const int zblocks = int((bufferIn.GetDepth() + m_zdim - 1) / m_zdim);
+	const CMP_DWORD totalBlocks = CMP_DWORD(xblocks * yblocks * zblocks);
+	const CMP_DWORD sampleBlocks =
+		std::max<CMP_DWORD>(1, std::min(nSampleBlocks, totalBlocks));
+
+	texel_layout_cpu layout =
+		sourceLayout(m_TexelFormat, bufferIn.GetBufferType());
+
+	image_source_cpu input_image;
+	initImageSource(input_image, bufferIn, &layout, m_FlipY);
+
+	// Blocks at golden ratio steps through the image cover it evenly,
+	// whatever the number of blocks per row
+	std::vector<CMP_BYTE> sampleData(
+		sampleBlocks * ASTC_COMPRESSED_BLOCK_SIZE);
+	std::vector<ASTCEncodeBlockData> samples(sampleBlocks);
+	for (CMP_DWORD i = 0; i < sampleBlocks; i++)
+	{
+		CMP_DWORD index = i;
+		if (sampleBlocks < totalBlocks)
+		{
+			double position = std::fmod(i * 0.6180339887498949, 1.0);
+			index = std::min(
+				CMP_DWORD(position * totalBlocks), totalBlocks - 1);
+		}
+
+		ASTCEncodeBlockData &block = samples[i];
+		block.buffers = nullptr;
+		block.input_image = &input_image;
+		block.bp = &sampleData[i * ASTC_COMPRESSED_BLOCK_SIZE];
+		block.x = int(index % xblocks) * m_xdim;
+		block.y = int(index / xblocks % yblocks) * m_ydim;
+		block.z = int(index / xblocks / yblocks) * m_zdim;
+		block.slot = -1;
+	}
+
+	tuning.sampleBlocks = sampleBlocks;
+	tuning.totalBlocks = totalBlocks;
+	std::fill(std::begin(tuning.sampleSeconds),
+		std::end(tuning.sampleSeconds), -1.0);
+	std::fill(std::begin(tuning.fixedSeconds), std::end(tuning.fixedSeconds),
+		-1.0);
+	std::fill(std::begin(tuning.estimatedSeconds),
+		std::end(tuning.estimatedSeconds), -1.0);
+	tuning.tier = 0;
+	tuning.metDeadline = false;
+
+	// The first blocks of a worker touch its buffers for the first time,
+	// one block per worker is encoded untimed before the sample
+	CMP_WORD numEncodingThreads = encodeThreadCount();
+	const CMP_DWORD warmBlocks =
+		std::min<CMP_DWORD>(numEncodingThreads, sampleBlocks);
+	std::vector<CMP_BYTE> warmData(warmBlocks * ASTC_COMPRESSED_BLOCK_SIZE);
+
+	for (int tier = 0; tier < ASTC_QUALITY_TIER_COUNT; tier++)
+	{
+		// A whole image encode sets up the encoder and starts and joins
+		// the workers once, these are timed apart from the sample
+		Clock::time_point start = Clock::now();
+		std::unique_ptr<ASTC_Encoder::ASTC_Encode> encoder(
+			createEncodeParams(bufferIn, ASTC_QUALITY_TIER[tier].quality));
+		std::chrono::duration<double> fixed = Clock::now() - start;
+
+		std::chrono::duration<double> elapsed;
 		if (numEncodingThreads > 1)
 		{
-			queue->start(numEncodingThreads, encoder.get());
+			ASTCEncodeQueue queue;
+			queue.streaming = true;
+			queue.slotPending.resize(1, 0);
+
+			start = Clock::now();
+			queue.start(numEncodingThreads, encoder.get());
+			fixed += Clock::now() - start;
+
+			// Queues the blocks to slot 0 and waits for them
+			auto encodeBlocks = [&queue](ASTCEncodeBlockData *blocks,
+									CMP_DWORD count) {
+				std::unique_lock<std::mutex> lock(queue.blocksMutex);
+				queue.slotPending[0] = count;
+				for (CMP_DWORD i = 0; i < count; i++)
+				{
+					ASTCEncodeBlockData block = blocks[i];
+					block.slot = 0;
+					queue.blocks.push(block);
+				}
+				queue.blocksAdded.notify_all();
+				queue.slotDone.wait(
+					lock, [&queue] { return queue.slotPending[0] == 0; });
+			};
+
+			std::vector<ASTCEncodeBlockData> warm(
+				samples.begin(), samples.begin() + warmBlocks);
+			for (CMP_DWORD i = 0; i < warmBlocks; i++)
+				warm[i].bp = &warmData[i * ASTC_COMPRESSED_BLOCK_SIZE];
+			encodeBlocks(warm.data(), warmBlocks);
+
+			start = Clock::now();
+			encodeBlocks(samples.data(), sampleBlocks);
+			elapsed = Clock::now() - start;
+
+			start = Clock::now();
+			queue.close();
+			queue.threads.clear();
+			fixed += Clock::now() - start;
+		} else
+		{
+			start = Clock::now();
+			std::unique_ptr<ASTC_Encoder::compress_symbolic_block_buffers>
+				buffers(new ASTC_Encoder::compress_symbolic_block_buffers);
+			fixed += Clock::now() - start;
+
+			ASTCEncodeBlockData warm = samples[0];
+			warm.buffers = buffers.get();
+			warm.bp = warmData.data();
+			warm.encode(encoder.get());
+
+			start = Clock::now();
+			for (auto block : samples)
+			{
+				block.buffers = buffers.get();
+				block.encode(encoder.get());
+			}
+			elapsed = Clock::now() - start;
 		}
-	} // all threads join here
 
-	destroy_image_cpu(input_image);
+		double estimate =
+			fixed.count() + elapsed.count() * totalBlocks / sampleBlocks;
+		tuning.sampleSeconds[tier] = elapsed.count();
+		tuning.fixedSeconds[tier] = fixed.count();
+		tuning.estimatedSeconds[tier] = estimate;
+		if (estimate > dSeconds)
+			break;
 
+		tuning.tier = tier;
+		tuning.metDeadline = true;
+	}
+
+	tuning.quality = ASTC_QUALITY_TIER[tuning.tier].quality;
+
+	std::chrono::duration<double> tuningTime = Clock::now() - tuningStart;
+	tuning.tuningSeconds = tuningTime.count();
 	return CE_OK;
 }
 
 CodecError CCodec_ASTC::Decompress(
 	CCodecBuffer &bufferIn, CCodecBuffer &bufferOut)
 {
+	return Decompress(bufferIn, bufferOut, 0, 0, 0);
+}
+
+CodecError CCodec_ASTC::Decompress(CCodecBuffer &bufferIn,
+	CCodecBuffer &bufferOut, CMP_DWORD dwOffsetX, CMP_DWORD dwOffsetY,
+	CMP_DWORD dwOffsetZ)
+{
+	ASTCTraceScope trace("Decompress", "codec");
 	if (bufferIn.GetFormat() != CMP_FORMAT_ASTC)
 	{
 		printf("Unsupported type of input buffer\n");
 		return CE_Unknown;
 	}
 
-	if (bufferOut.GetBufferType() != CBT_RGBA8888)
+	// Half float output keeps HDR texels as they are decoded
+	CodecBufferType outType = bufferOut.GetBufferType();
+	if (outType != CBT_RGBA8888 && outType != CBT_RGBA16F)
 	{
 		printf("Unsupported type of output buffer\n");
 		return CE_Unknown;
 	}
+	const bool halfFloat = outType == CBT_RGBA16F;
+
+	const CMP_DWORD imageWidth = bufferIn.GetWidth();
+	const CMP_DWORD imageHeight = bufferIn.GetHeight();
+	const CMP_DWORD imageDepth = bufferIn.GetDepth();
+
+	// Region of the input image to decode
+	const CMP_DWORD regionWidth = bufferOut.GetWidth();
+	const CMP_DWORD regionHeight = bufferOut.GetHeight();
+	const CMP_DWORD regionDepth = bufferOut.GetDepth();
+
+	if (regionWidth == 0 || regionHeight == 0 || regionDepth == 0 ||
+		dwOffsetX >= imageWidth || dwOffsetY >= imageHeight ||
+		dwOffsetZ >= imageDepth || regionWidth > imageWidth - dwOffsetX ||
+		regionHeight > imageHeight - dwOffsetY ||
+		regionDepth > imageDepth - dwOffsetZ)
+	{
+		printf("Output buffer does not fit the input image\n");
+		return CE_Unknown;
+	}
 
 	CMP_BYTE Block_Width = bufferIn.GetBlockWidth();
 	CMP_BYTE Block_Height = bufferIn.GetBlockHeight();
+	CMP_BYTE Block_Depth = bufferIn.GetBlockDepth();
 	m_xdim = Block_Width;
 	m_ydim = Block_Height;
+	m_zdim = Block_Depth;
+
+	std::unique_ptr<ASTC_Encoder::ASTC_Encode> codec(createDecodeParams(
+		Block_Width, Block_Height, Block_Depth, m_SRGB));
+
+	texel_layout_cpu layout = sourceLayout(m_TexelFormat, outType);
+	ASTCBlockDecoder decoder(
+		codec.get(), Block_Width, Block_Height, &layout, Block_Depth);
+	const int texelSize = layout.texel_size * (halfFloat ? 2 : 1);
+
+	const CMP_DWORD regionRight = dwOffsetX + regionWidth;
+	const CMP_DWORD regionBottom = dwOffsetY + regionHeight;
+	const CMP_DWORD regionBack = dwOffsetZ + regionDepth;
+
+	// Only the blocks intersecting the region are decoded
+	const CMP_DWORD firstBlockX = dwOffsetX / Block_Width;
+	const CMP_DWORD firstBlockY = dwOffsetY / Block_Height;
+	const CMP_DWORD firstBlockZ = dwOffsetZ / Block_Depth;
+	const CMP_DWORD lastBlockX = (regionRight - 1) / Block_Width;
+	const CMP_DWORD lastBlockY = (regionBottom - 1) / Block_Height;
+	const CMP_DWORD lastBlockZ = (regionBack - 1) / Block_Depth;
+
+	// Output rows go towards lower addresses when flipped, slices of a
+	// volume are flipped one by one
+	ptrdiff_t pitch = bufferOut.GetPitch();
+	const ptrdiff_t slicePitch = pitch * regionHeight;
+	CMP_BYTE *pDataOut = bufferOut.GetData();
+	if (m_FlipY)
+	{
+		pDataOut += (regionHeight - 1) * pitch;
+		pitch = -pitch;
+	}
+
+	CMP_BYTE CompData[ASTC_COMPRESSED_BLOCK_SIZE];
+	for (CMP_DWORD cmpLayerZ = firstBlockZ; cmpLayerZ <= lastBlockZ;
+		 cmpLayerZ++)
+	{
+		CMP_DWORD blockZ = cmpLayerZ * Block_Depth;
+		CMP_DWORD outZ = std::max(blockZ, dwOffsetZ);
+		int slices = int(std::min(blockZ + Block_Depth, regionBack) - outZ);
+
+		CMP_BYTE *pSliceOut =
+			pDataOut + ptrdiff_t(outZ - dwOffsetZ) * slicePitch;
+
+		for (CMP_DWORD cmpRowY = firstBlockY; cmpRowY <= lastBlockY; cmpRowY++)
+		{
+			CMP_DWORD blockY = cmpRowY * Block_Height;
+			CMP_DWORD outY = std::max(blockY, dwOffsetY);
+			int rows =
+				int(std::min(blockY + Block_Height, regionBottom) - outY);
+
+			CMP_BYTE *pRowOut =
+				pSliceOut + ptrdiff_t(outY - dwOffsetY) * pitch;
+
+			for (CMP_DWORD cmpColX = firstBlockX; cmpColX <= lastBlockX;
+				 cmpColX++)
+			{
+				CMP_DWORD blockX = cmpColX * Block_Width;
+				CMP_DWORD outX = std::max(blockX, dwOffsetX);
+				int cols =
+					int(std::min(blockX + Block_Width, regionRight) - outX);
+
+				bufferIn.ReadBlock(cmpColX, cmpRowY, cmpLayerZ, CompData);
+				// Decode straight to the appropriate location in the target
+				// image
+				CMP_BYTE *pOut = pRowOut + (outX - dwOffsetX) * texelSize;
+				int x = int(outX - blockX);
+				int y = int(outY - blockY);
+				int z = int(outZ - blockZ);
+				if (halfFloat)
+				{
+					decoder.decompressHalf(pOut, pitch, slicePitch, x, y, z,
+						cols, rows, slices, CompData);
+				} else
+				{
+					decoder.decompress(pOut, pitch, slicePitch, x, y, z, cols,
+						rows, slices, CompData);
+				}
+			}
+		}
+	}
+
+	return CE_OK;
+}
+
+CodecError CCodec_ASTC::DecompressBlockRows(CMP_BYTE nBlockWidth,
+	CMP_BYTE nBlockHeight, CMP_DWORD dwWidth, CMP_DWORD dwHeight,
+	const BlockRowReader &reader, const TexelRowTarget &target)
+{
+	ASTCTraceScope trace("DecompressBlockRows", "codec");
+	if (!isValidBlockSize(nBlockWidth, nBlockHeight) || dwWidth == 0 ||
+		dwHeight == 0)
+	{
+		printf("Invalid image dimensions\n");
+		return CE_Unknown;
+	}
+
+	m_xdim = nBlockWidth;
+	m_ydim = nBlockHeight;
 
 	std::unique_ptr<ASTC_Encoder::ASTC_Encode> codec(
-		new ASTC_Encoder::ASTC_Encode);
-	codec->m_decode_mode = ASTC_DECODE_HDR;
-	codec->m_rgb_force_use_of_hdr = 0;
-	codec->m_alpha_force_use_of_hdr = 0;
-	codec->m_perform_srgb_transform = 0;
-	codec->m_xdim = m_xdim;
-	codec->m_ydim = m_ydim;
-	codec->m_zdim = 1;
-	codec->m_Quality = 0.f;
-	ASTC_Encoder::init_ASTC(codec.get());
+		createDecodeParams(nBlockWidth, nBlockHeight, 1, m_SRGB));
 
-	ASTCBlockDecoder decoder(codec.get(), Block_Width, Block_Height);
+	texel_layout_cpu layout = texelLayout(m_TexelFormat);
+	ASTCBlockDecoder decoder(codec.get(), nBlockWidth, nBlockHeight, &layout);
+
+	const CMP_DWORD dwBlocksX = (dwWidth + nBlockWidth - 1) / nBlockWidth;
+	const CMP_DWORD dwBlocksY = (dwHeight + nBlockHeight - 1) / nBlockHeight;
+
+	// Single block row buffer
+	const CMP_DWORD dwBlockRowSize = dwBlocksX * ASTC_COMPRESSED_BLOCK_SIZE;
+	std::vector<CMP_BYTE> blockRow(dwBlockRowSize);
+
+	for (CMP_DWORD cmpRowY = 0; cmpRowY < dwBlocksY; cmpRowY++)
+	{
+		CMP_DWORD blockY = cmpRowY * nBlockHeight;
+		int rows = int(std::min<CMP_DWORD>(nBlockHeight, dwHeight - blockY));
+
+		if (!reader(blockRow.data(), dwBlockRowSize))
+			return CE_Aborted;
+
+		CMP_DWORD dwRow = m_FlipY ? dwHeight - blockY - rows : blockY;
+		CMP_BYTE *pRowOut = nullptr;
+		CMP_DWORD dwPitch = 0;
+		if (!target(dwRow, rows, pRowOut, dwPitch))
+			return CE_Aborted;
+
+		// Flipped blocks are written upside down
+		ptrdiff_t rowPitch = dwPitch;
+		if (m_FlipY)
+		{
+			pRowOut += (rows - 1) * rowPitch;
+			rowPitch = -rowPitch;
+		}
+
+		const CMP_BYTE *pBlock = blockRow.data();
+		for (CMP_DWORD cmpColX = 0; cmpColX < dwBlocksX; cmpColX++)
+		{
+			CMP_DWORD blockX = cmpColX * nBlockWidth;
+			int cols = int(std::min<CMP_DWORD>(nBlockWidth, dwWidth - blockX));
+
+			decoder.decompress(pRowOut + blockX * layout.texel_size, rowPitch,
+				0, 0, cols, rows, pBlock);
+			pBlock += ASTC_COMPRESSED_BLOCK_SIZE;
+		}
+	}
+
+	return CE_OK;
+}
+
+CodecError CCodec_ASTC::DecompressScaled(CCodecBuffer &bufferIn,
+	CCodecBuffer &bufferOut, CMP_DWORD dwOffsetX, CMP_DWORD dwOffsetY,
+	CMP_DWORD dwWidth, CMP_DWORD dwHeight)
+{
+	ASTCTraceScope trace("DecompressScaled", "codec");
+	if (bufferIn.GetFormat() != CMP_FORMAT_ASTC)
+	{
+		printf("Unsupported type of input buffer\n");
+		return CE_Unknown;
+	}
+
+	if (bufferOut.GetBufferType() != CBT_RGBA8888)
+	{
+		printf("Unsupported type of output buffer\n");
+		return CE_Unknown;
+	}
+
+	if (bufferIn.GetBlockDepth() != 1)
+	{
+		printf("Scaled decoding of 3D blocks is not supported\n");
+		return CE_Unknown;
+	}
 
 	const CMP_DWORD imageWidth = bufferIn.GetWidth();
 	const CMP_DWORD imageHeight = bufferIn.GetHeight();
 
-	const CMP_DWORD dwBlocksX = bufferIn.GetColumns();
-	const CMP_DWORD dwBlocksY = bufferIn.GetRows();
+	if (dwWidth == 0 || dwHeight == 0 || dwOffsetX >= imageWidth ||
+		dwOffsetY >= imageHeight || dwWidth > imageWidth - dwOffsetX ||
+		dwHeight > imageHeight - dwOffsetY)
+	{
+		printf("Region does not fit the input image\n");
+		return CE_Unknown;
+	}
 
-	// Output data size Pitch
-	CMP_DWORD dwPitch = bufferOut.GetPitch();
+	const CMP_DWORD scaledWidth = bufferOut.GetWidth();
+	const CMP_DWORD scaledHeight = bufferOut.GetHeight();
 
-	// Output Buffer
-	CMP_BYTE *pDataOut = bufferOut.GetData();
+	if (scaledWidth == 0 || scaledHeight == 0 || scaledWidth > dwWidth ||
+		scaledHeight > dwHeight)
+	{
+		printf("Only downscaling is supported\n");
+		return CE_Unknown;
+	}
+
+	CMP_BYTE Block_Width = bufferIn.GetBlockWidth();
+	CMP_BYTE Block_Height = bufferIn.GetBlockHeight();
+	m_xdim = Block_Width;
+	m_ydim = Block_Height;
+
+	std::unique_ptr<ASTC_Encoder::ASTC_Encode> codec(
+		createDecodeParams(Block_Width, Block_Height, 1, m_SRGB));
+
+	ASTCBlockDecoder decoder(codec.get(), Block_Width, Block_Height);
+
+	// When every output pixel covers at least a whole block, the average
+	// color of each block is enough and texels are never interpolated.
+	bool blockAverage = scaledWidth * Block_Width <= dwWidth &&
+		scaledHeight * Block_Height <= dwHeight;
+
+	ASTCScaleAccumulator accumulator(
+		dwWidth, dwHeight, scaledWidth, scaledHeight);
+
+	const CMP_DWORD regionRight = dwOffsetX + dwWidth;
+	const CMP_DWORD regionBottom = dwOffsetY + dwHeight;
+
+	const CMP_DWORD firstBlockX = dwOffsetX / Block_Width;
+	const CMP_DWORD firstBlockY = dwOffsetY / Block_Height;
+	const CMP_DWORD lastBlockX = (regionRight - 1) / Block_Width;
+	const CMP_DWORD lastBlockY = (regionBottom - 1) / Block_Height;
 
 	CMP_COLOR DecData[ASTC_MAX_BLOCK_SIZE * ASTC_MAX_BLOCK_SIZE];
 	CMP_BYTE CompData[ASTC_COMPRESSED_BLOCK_SIZE];
-	for (CMP_DWORD cmpRowY = 0; cmpRowY < dwBlocksY; cmpRowY++)
+	for (CMP_DWORD cmpRowY = firstBlockY; cmpRowY <= lastBlockY; cmpRowY++)
 	{
-		for (CMP_DWORD cmpColX = 0; cmpColX < dwBlocksX; cmpColX++)
+		CMP_DWORD blockY = cmpRowY * Block_Height;
+		CMP_DWORD y0 = std::max(blockY, dwOffsetY);
+		CMP_DWORD y1 = std::min(blockY + Block_Height, regionBottom);
+
+		for (CMP_DWORD cmpColX = firstBlockX; cmpColX <= lastBlockX; cmpColX++)
 		{
+			CMP_DWORD blockX = cmpColX * Block_Width;
+			CMP_DWORD x0 = std::max(blockX, dwOffsetX);
+			CMP_DWORD x1 = std::min(blockX + Block_Width, regionRight);
+
 			bufferIn.ReadBlock(cmpColX, cmpRowY, CompData);
-			// Decode to the appropriate location in the compressed image
+
+			if (blockAverage)
+			{
+				float color[4];
+				decoder.decompressAverage(color, CompData);
+				accumulator.add(x0 - dwOffsetX, y0 - dwOffsetY,
+					x1 - dwOffsetX, y1 - dwOffsetY, color);
+				continue;
+			}
+
 			decoder.decompress(DecData, CompData);
+			for (CMP_DWORD y = y0; y < y1; y++)
+			{
+				const CMP_COLOR *pTexel =
+					DecData + (y - blockY) * Block_Width + (x0 - blockX);
+				for (CMP_DWORD x = x0; x < x1; x++, pTexel++)
+					accumulator.add(x - dwOffsetX, y - dwOffsetY, *pTexel);
+			}
+		}
+	}
 
-			// Now that we have a decoded block lets copy that
-			// data over to the target image buffer
-			CMP_DWORD outX = cmpColX * Block_Width;
-			CMP_DWORD outY = cmpRowY * Block_Height;
+	accumulator.store(bufferOut.GetData(), bufferOut.GetPitch(),
+		texelLayout(m_TexelFormat), m_FlipY);
+	return CE_OK;
+}
+
+CodecError CCodec_ASTC::ComputeMetrics(CCodecBuffer &bufferSource,
+	CCodecBuffer &bufferCompare, ASTCQualityMetrics &metrics)
+{
+	if (bufferSource.GetBufferType() != CBT_RGBA8888)
+	{
+		printf("Unsupported type of source buffer\n");
+		return CE_Unknown;
+	}
+
+	const CMP_DWORD dwWidth = bufferSource.GetWidth();
+	const CMP_DWORD dwHeight = bufferSource.GetHeight();
+	if (bufferCompare.GetWidth() != dwWidth ||
+		bufferCompare.GetHeight() != dwHeight ||
+		bufferSource.GetDepth() != 1 || bufferCompare.GetDepth() != 1)
+	{
+		printf("Buffers to compare differ in size\n");
+		return CE_Unknown;
+	}
 
-			for (int row = 0; row < Block_Height; row++)
+	// Blocks are decoded to the layout of the source
+	std::unique_ptr<CCodecBuffer> decoded;
+	CCodecBuffer *pCompare = &bufferCompare;
+	if (bufferCompare.GetFormat() == CMP_FORMAT_ASTC)
+	{
+		decoded.reset(CreateCodecBuffer(CBT_RGBA8888, 0, 0, 0, dwWidth,
+			dwHeight, bufferSource.GetPitch()));
+		CodecError error = Decompress(bufferCompare, *decoded);
+		if (error != CE_OK)
+			return error;
+
+		pCompare = decoded.get();
+	} else if (bufferCompare.GetBufferType() != CBT_RGBA8888)
+	{
+		printf("Unsupported type of buffer to compare\n");
+		return CE_Unknown;
+	}
+
+	texel_layout_cpu layout = texelLayout(m_TexelFormat);
+	compute_quality_metrics_cpu(bufferSource.GetData(),
+		bufferSource.GetPitch(), pCompare->GetData(), pCompare->GetPitch(),
+		&layout, int(dwWidth), int(dwHeight), encodeThreadCount(), &metrics);
+	return CE_OK;
+}
+
+void CCodec_ASTC::scanBlockTraits(
+	CCodecBuffer &bufferIn, bool &opaque, bool &grayscale)
+{
+	opaque = true;
+	grayscale = true;
+
+	const CMP_BYTE Block_Width = bufferIn.GetBlockWidth();
+	const CMP_BYTE Block_Height = bufferIn.GetBlockHeight();
+	const CMP_BYTE Block_Depth = bufferIn.GetBlockDepth();
+	const CMP_DWORD dwBlocksX = bufferIn.GetColumns();
+	const CMP_DWORD dwBlocksY = bufferIn.GetRows();
+	const CMP_DWORD dwBlocksZ = bufferIn.GetLayers();
+
+	physical_compressed_block_cpu pcb;
+	for (CMP_DWORD cmpLayerZ = 0; cmpLayerZ < dwBlocksZ; cmpLayerZ++)
+	{
+		for (CMP_DWORD cmpRowY = 0; cmpRowY < dwBlocksY; cmpRowY++)
+		{
+			for (CMP_DWORD cmpColX = 0; cmpColX < dwBlocksX; cmpColX++)
 			{
-				CMP_DWORD h = outY + row;
-				if (h >= imageHeight)
-					break;
-
-				CMP_DWORD nextRowCol =
-					(imageHeight - 1 - h) * dwPitch + (outX * 4);
-				auto pData =
-					reinterpret_cast<CMP_COLOR *>(pDataOut + nextRowCol);
-				int yoffset = row * Block_Width;
-				for (int col = 0; col < Block_Width; col++)
-				{
-					CMP_DWORD w = outX + col;
-					if (w >= imageWidth)
-						break;
+				bufferIn.ReadBlock(cmpColX, cmpRowY, cmpLayerZ, pcb.data);
 
-					*pData++ = DecData[yoffset + col];
-				}
+				int hasAlpha;
+				int hasColor;
+				physical_block_traits_cpu(Block_Width, Block_Height,
+					Block_Depth, pcb, &hasAlpha, &hasColor);
+
+				if (hasAlpha)
+					opaque = false;
+				if (hasColor)
+					grayscale = false;
+				if (!opaque && !grayscale)
+					return;
 			}
 		}
 	}
+}
 
-	return CE_OK;
+CMP_WORD CCodec_ASTC::encodeThreadCount() const
+{
+	CMP_WORD numEncodingThreads = MIN(m_NumThreads, sMaxEncodeThreads);
+	return numEncodingThreads == 0 ? 1 : numEncodingThreads;
+}
+
+ASTC_Encoder::ASTC_Encode *CCodec_ASTC::createEncodeParams(
+	CCodecBuffer &bufferIn) const
+{
+	return createEncodeParams(bufferIn, m_Quality);
+}
+
+ASTC_Encoder::ASTC_Encode *CCodec_ASTC::createEncodeParams(
+	CCodecBuffer &bufferIn, double quality) const
+{
+	// Half float colors are encoded as HDR, alpha stays LDR. In sRGB mode
+	// they are taken as linear and converted to sRGB instead.
+	bool halfFloat = bufferIn.GetBufferType() == CBT_RGBA16F;
+
+	auto encoder = new ASTC_Encoder::ASTC_Encode;
+	encoder->m_decode_mode = m_SRGB ? ASTC_DECODE_LDR_SRGB : ASTC_DECODE_HDR;
+	encoder->m_rgb_force_use_of_hdr = halfFloat && !m_SRGB ? 1 : 0;
+	encoder->m_alpha_force_use_of_hdr = 0;
+	encoder->m_perform_srgb_transform = halfFloat && m_SRGB ? 1 : 0;
+	encoder->m_ignore_transparent_rgb = m_IgnoreTransparentRGB ? 1 : 0;
+	encoder->m_Quality = (float) quality;
+	encoder->m_xdim = m_xdim;
+	encoder->m_ydim = m_ydim;
+	encoder->m_zdim = m_zdim;
+	ASTC_Encoder::init_ASTC(encoder);
+	return encoder;
 }
 
 CCodecBuffer *CCodec_ASTC::CreateBuffer(CMP_BYTE nBlockWidth,
 	CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth, CMP_DWORD dwWidth,
-	CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData) const
+	CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData,
+	CMP_WORD dwDepth) const
 {
-	assert(nBlockDepth == 0);
 	assert(dwPitch == 0);
-	auto buffer =
-		CreateCodecBuffer(CBT_Block, 4, 4, 8, dwWidth, dwHeight, 0, pData);
+	// 2D blocks are given a depth of 0 or 1
+	auto buffer = CreateCodecBuffer(
+		CBT_Block, 4, 4, 8, dwWidth, dwHeight, 0, pData, dwDepth);
 	buffer->SetFormat(CMP_FORMAT_ASTC);
-	buffer->SetBlockDims(nBlockWidth, nBlockHeight);
+	buffer->SetBlockDims(
+		nBlockWidth, nBlockHeight, nBlockDepth == 0 ? 1 : nBlockDepth);
 	assert(buffer->GetBlockSize() == ASTC_COMPRESSED_BLOCK_SIZE);
 	assert(buffer->GetPitch() ==
 		ASTC_COMPRESSED_BLOCK_SIZE * buffer->GetColumns());
 	return buffer;
 }
 
+static void initImageSource(image_source_cpu &image,
+	CCodecBuffer &buffer, const texel_layout_cpu *layout, bool flipY)
+{
+	image.data = buffer.GetData();
+	image.pitch = buffer.GetPitch();
+	image.slice_pitch = image.pitch * buffer.GetHeight();
+	image.xsize = int(buffer.GetWidth());
+	image.ysize = int(buffer.GetHeight());
+	image.zsize = int(buffer.GetDepth());
+	image.layout = layout;
+	switch (buffer.GetBufferType())
+	{
+		case CBT_RGBA16:
+			image.type = IMAGE_SOURCE_UNORM16;
+			break;
+
+		case CBT_RGBA16F:
+			image.type = IMAGE_SOURCE_FLOAT16;
+			break;
+
+		default:
+			image.type = IMAGE_SOURCE_UNORM8;
+			break;
+	}
+	if (flipY)
+	{
+		image.data += (image.ysize - 1) * image.pitch;
+		image.pitch = -image.pitch;
+	}
+}
+
+static ASTC_Encoder::ASTC_Encode *createDecodeParams(
+	CMP_BYTE xdim, CMP_BYTE ydim, CMP_BYTE zdim, bool srgb)
+{
+	auto codec = new ASTC_Encoder::ASTC_Encode;
+	codec->m_decode_mode = srgb ? ASTC_DECODE_LDR_SRGB : ASTC_DECODE_HDR;
+	codec->m_rgb_force_use_of_hdr = 0;
+	codec->m_alpha_force_use_of_hdr = 0;
+	codec->m_perform_srgb_transform = 0;
+	codec->m_ignore_transparent_rgb = 0;
+	codec->m_xdim = xdim;
+	codec->m_ydim = ydim;
+	codec->m_zdim = zdim;
+	codec->m_Quality = 0.f;
+	ASTC_Encoder::init_ASTC(codec);
+	return codec;
+}
+
+ASTCScaleAccumulator::ASTCScaleAccumulator(CMP_DWORD srcWidth,
+	CMP_DWORD srcHeight, CMP_DWORD dstWidth, CMP_DWORD dstHeight)
+	: width(dstWidth)
+	, height(dstHeight)
+	, scaleX(double(dstWidth) / srcWidth)
+	, scaleY(double(dstHeight) / srcHeight)
+	, spansX(makeSpans(srcWidth, dstWidth, scaleX))
+	, spansY(makeSpans(srcHeight, dstHeight, scaleY))
+	, colors(dstWidth * dstHeight * 4, 0.f)
+	, areas(dstWidth * dstHeight, 0.f)
+{
+}
+
+std::vector<ASTCScaleAccumulator::Span> ASTCScaleAccumulator::makeSpans(
+	CMP_DWORD srcSize, CMP_DWORD dstSize, double scale)
+{
+	std::vector<Span> spans(srcSize);
+	for (CMP_DWORD i = 0; i < srcSize; i++)
+	{
+		double start = i * scale;
+		double end = (i + 1) * scale;
+		Span &span = spans[i];
+		span.index = std::min(CMP_DWORD(start), dstSize - 1);
+		double split = span.index + 1.0;
+		if (end > split && span.index + 1 < dstSize)
+		{
+			span.cover[0] = float(split - start);
+			span.cover[1] = float(end - split);
+		} else
+		{
+			span.cover[0] = float(end - start);
+			span.cover[1] = 0.f;
+		}
+	}
+	return spans;
+}
+
+void ASTCScaleAccumulator::add(
+	double x0, double y0, double x1, double y1, const float color[4])
+{
+	// Map to destination pixel units
+	x0 *= scaleX;
+	x1 *= scaleX;
+	y0 *= scaleY;
+	y1 *= scaleY;
+
+	CMP_DWORD firstX = CMP_DWORD(x0);
+	CMP_DWORD firstY = CMP_DWORD(y0);
+	CMP_DWORD lastX = std::min(CMP_DWORD(std::ceil(x1)), width);
+	CMP_DWORD lastY = std::min(CMP_DWORD(std::ceil(y1)), height);
+
+	for (CMP_DWORD y = firstY; y < lastY; y++)
+	{
+		double coverY = std::min(y1, y + 1.0) - std::max(y0, double(y));
+		for (CMP_DWORD x = firstX; x < lastX; x++)
+		{
+			double coverX = std::min(x1, x + 1.0) - std::max(x0, double(x));
+			float area = float(coverX * coverY);
+			if (area > 0.f)
+				add(y * width + x, area, color);
+		}
+	}
+}
+
+void ASTCScaleAccumulator::add(
+	CMP_DWORD x, CMP_DWORD y, const CMP_COLOR &color)
+{
+	float value[4];
+	for (int i = 0; i < 4; i++)
+		value[i] = color.rgba[i] / 255.f;
+
+	const Span &spanX = spansX[x];
+	const Span &spanY = spansY[y];
+	for (int j = 0; j < 2 && spanY.cover[j] > 0.f; j++)
+	{
+		CMP_DWORD row = (spanY.index + j) * width;
+		for (int i = 0; i < 2 && spanX.cover[i] > 0.f; i++)
+		{
+			add(row + spanX.index + i, spanX.cover[i] * spanY.cover[j],
+				value);
+		}
+	}
+}
+
+void ASTCScaleAccumulator::add(
+	CMP_DWORD index, float area, const float color[4])
+{
+	areas[index] += area;
+	float *pColor = &colors[index * 4];
+	for (int i = 0; i < 4; i++)
+		pColor[i] += color[i] * area;
+}
+
+void ASTCScaleAccumulator::store(CMP_BYTE *pDataOut, CMP_DWORD dwPitch,
+	const texel_layout_cpu &layout, bool flipY) const
+{
+	for (CMP_DWORD y = 0; y < height; y++)
+	{
+		CMP_BYTE *pRow = pDataOut + (flipY ? height - 1 - y : y) * dwPitch;
+		for (CMP_DWORD x = 0; x < width; x++)
+		{
+			CMP_DWORD index = y * width + x;
+			float area = areas[index];
+			const float *pColor = &colors[index * 4];
+			float value[4];
+			for (int i = 0; i < 4; i++)
+				value[i] = area > 0.f ? pColor[i] / area : 0.f;
+
+			store_texel_rgba8_cpu(value, &layout, pRow);
+			pRow += layout.texel_size;
+		}
+	}
+}
+
+static texel_layout_cpu sourceLayout(
+	ASTCTexelFormat format, CodecBufferType type)
+{
+	if (type == CBT_RGBA8888)
+		return texelLayout(format);
+
+	// 16-bit texels are always R, G, B, A
+	texel_layout_cpu layout = texel_layout_rgba8_cpu;
+	layout.opaque =
+		format == ASTC_TEXEL_RGBX8888 || format == ASTC_TEXEL_RGB32 ? 1 : 0;
+	return layout;
+}
+
+static bool isTexelBuffer(CodecBufferType type)
+{
+	return type == CBT_RGBA8888 || type == CBT_RGBA16 || type == CBT_RGBA16F;
+}
+
+static texel_layout_cpu texelLayout(ASTCTexelFormat format)
+{
+	texel_layout_cpu layout = texel_layout_rgba8_cpu;
+
+	switch (format)
+	{
+		case ASTC_TEXEL_RGBA8888:
+			break;
+
+		case ASTC_TEXEL_RGBX8888:
+			layout.opaque = 1;
+			break;
+
+		case ASTC_TEXEL_ARGB32_PREMULTIPLIED:
+			layout.premultiply = 1;
+			// fall through
+		case ASTC_TEXEL_ARGB32:
+		case ASTC_TEXEL_RGB32:
+		{
+			const CMP_DWORD one = 1;
+			if (*reinterpret_cast<const CMP_BYTE *>(&one) == 1)
+			{
+				// little-endian: B, G, R, A
+				layout.offsets[BC_COMP_RED] = 2;
+				layout.offsets[BC_COMP_GREEN] = 1;
+				layout.offsets[BC_COMP_BLUE] = 0;
+				layout.offsets[BC_COMP_ALPHA] = 3;
+			} else
+			{
+				// big-endian: A, R, G, B
+				layout.offsets[BC_COMP_RED] = 1;
+				layout.offsets[BC_COMP_GREEN] = 2;
+				layout.offsets[BC_COMP_BLUE] = 3;
+				layout.offsets[BC_COMP_ALPHA] = 0;
+			}
+			layout.opaque = format == ASTC_TEXEL_RGB32;
+			break;
+		}
+
+		case ASTC_TEXEL_GRAY8:
+			layout.texel_size = 1;
+			break;
+	}
+
+	return layout;
+}
+
 ASTCEncodeThread::ASTCEncodeThread(
 	ASTCEncodeQueue *queue, ASTC_Encoder::ASTC_Encode *encoder)
 	: queue(queue)
 	, encoder(encoder)
 {
+	// Trials of block costs are counted by the statistics
+	if (queue->stats || queue->costs)
+		buffers.stats = &stats;
+	buffers.costs = queue->costs;
 }
 
 ASTCEncodeThread::~ASTCEncodeThread()
@@ -385,12 +1647,20 @@ void ASTCEncodeThread::start()
 
 void ASTCEncodeThread::work()
 {
+	ASTCTrace::setThreadName("encode worker");
 	while (true)
 	{
 		ASTCEncodeBlockData block;
 		{
-			std::lock_guard<std::mutex> lock(queue->blocksMutex);
+			// Waits for the lock, and for a streaming encode to add blocks
+			ASTCTraceScope trace("wait", "queue");
+			std::unique_lock<std::mutex> lock(queue->blocksMutex);
 			auto &blocks = queue->blocks;
+			if (queue->streaming)
+			{
+				queue->blocksAdded.wait(lock,
+					[this, &blocks] { return queue->closed || !blocks.empty(); });
+			}
 			if (blocks.empty())
 				break;
 			block = blocks.front();
@@ -399,24 +1669,63 @@ void ASTCEncodeThread::work()
 
 		block.buffers = &buffers;
 		block.encode(encoder);
+
+		if (block.slot >= 0)
+		{
+			ASTCTraceScope trace("slot done", "queue");
+			std::lock_guard<std::mutex> lock(queue->blocksMutex);
+			if (--queue->slotPending[block.slot] == 0)
+				queue->slotDone.notify_one();
+		}
+	}
+
+	if (queue->stats)
+	{
+		std::lock_guard<std::mutex> lock(queue->blocksMutex);
+		queue->stats->add(stats);
 	}
 }
 
 void ASTCEncodeBlockData::encode(ASTC_Encoder::ASTC_Encode *encoder)
 {
+	ASTCTraceScope trace("block", "encode");
+	trace.arg("x", x);
+	trace.arg("y", y);
+	trace.arg("z", z);
 	ASTCBlockEncoder::CompressBlock_kernel(
-		input_image, bp, x, y, encoder, buffers);
+		input_image, bp, x, y, z, encoder, buffers);
+}
+
+ASTCEncodeQueue::ASTCEncodeQueue()
+	: streaming(false)
+	, closed(false)
+	, stats(nullptr)
+	, costs(nullptr)
+{
 }
 
 ASTCEncodeQueue::~ASTCEncodeQueue()
 {
+	if (streaming)
+		close();
 	threads.clear(); // join all threads before mutex destruction
 }
 
+void ASTCEncodeQueue::close()
+{
+	std::lock_guard<std::mutex> lock(blocksMutex);
+	// Blocks not started yet are dropped
+	blocks = std::queue<ASTCEncodeBlockData>();
+	closed = true;
+	blocksAdded.notify_all();
+}
+
 void ASTCEncodeQueue::start(
 	size_t maxThreadCount, ASTC_Encoder::ASTC_Encode *encoder)
 {
-	size_t threadCount = std::min(maxThreadCount, blocks.size());
+	// Streaming queues are filled after the workers start
+	size_t threadCount = streaming ? maxThreadCount
+								   : std::min(maxThreadCount, blocks.size());
 	threads.clear();
 	threads.reserve(threadCount);
 	for (int i = 0; i < threadCount; i++)
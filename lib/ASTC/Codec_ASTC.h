@@ -29,6 +29,11 @@
 #include "ASTC_Decode.h"
 #include "ASTC_Definitions.h"
 #include "ASTC_Host.h"
+#include "ASTC_Metrics.h"
+#include "ASTC_Mipmap.h"
+#include "ASTC_Stats.h"
+
+#include <functional>
 
 struct astc_block_size_t
 {
@@ -36,15 +41,95 @@ struct astc_block_size_t
 	CMP_BYTE h;
 };
 
+struct astc_block_size_3d_t
+{
+	CMP_BYTE w;
+	CMP_BYTE h;
+	CMP_BYTE d;
+};
+
 enum
 {
-	ASTC_VALID_BLOCK = 14
+	ASTC_VALID_BLOCK = 14,
+	ASTC_VALID_BLOCK_3D = 10
 };
 extern const astc_block_size_t ASTC_VALID_BLOCK_SIZE[ASTC_VALID_BLOCK];
+extern const astc_block_size_3d_t ASTC_VALID_BLOCK_SIZE_3D[ASTC_VALID_BLOCK_3D];
+
+// Speed settings of the encoder, each with a quality value in the middle of
+// the range that selects it
+struct astc_quality_tier_t
+{
+	const char *name;
+	double quality;
+};
+
+enum
+{
+	ASTC_QUALITY_TIER_COUNT = 5
+};
+// From the fastest to the most thorough
+extern const astc_quality_tier_t ASTC_QUALITY_TIER[ASTC_QUALITY_TIER_COUNT];
+
+// Speed setting picked by CCodec_ASTC::TuneQuality, and the measures it was
+// picked from
+struct ASTCQualityTuning
+{
+	CMP_DWORD sampleBlocks;
+	CMP_DWORD totalBlocks;
+	// Encode time of the sample at each tier with warmed up workers, the
+	// time an encode spends once whatever the image size (encoder setup,
+	// start and join of the workers), and the time of the whole image
+	// they predict. Negative for tiers left out.
+	double sampleSeconds[ASTC_QUALITY_TIER_COUNT];
+	double fixedSeconds[ASTC_QUALITY_TIER_COUNT];
+	double estimatedSeconds[ASTC_QUALITY_TIER_COUNT];
+	// Index in ASTC_QUALITY_TIER of the chosen tier and its quality
+	int tier;
+	double quality;
+	// Whether the chosen tier is predicted to meet the deadline. When no
+	// tier does, the fastest one is chosen.
+	bool metDeadline;
+	// Time the tuning took, sample encodes and encoder setups
+	double tuningSeconds;
+};
+
+// Texel format of the CBT_RGBA8888 buffers read by the encoder and written
+// by the decoder. CBT_RGBA16 and CBT_RGBA16F buffers are always R, G, B, A;
+// for them only an opaque choice (RGBX8888 or RGB32) is taken into account.
+enum ASTCTexelFormat
+{
+	ASTC_TEXEL_RGBA8888, // R, G, B, A bytes
+	ASTC_TEXEL_RGBX8888, // R, G, B bytes, alpha treated as 255
+	ASTC_TEXEL_ARGB32, // native-endian 0xAARRGGBB words
+	ASTC_TEXEL_ARGB32_PREMULTIPLIED, // same, RGB multiplied by alpha
+	ASTC_TEXEL_GRAY8, // single luminance byte, pitch must be given
+	ASTC_TEXEL_RGB32, // native-endian 0xFFRRGGBB words
+};
 
 class CCodec_ASTC : public CCodec
 {
 public:
+	// Fills pData with dwSize bytes: the next block row of compressed data.
+	// Block rows are requested in the order they are stored in the file.
+	typedef std::function<bool(CMP_BYTE *pData, CMP_DWORD dwSize)>
+		BlockRowReader;
+	// Receives the next block row of compressed data, in file order.
+	typedef std::function<bool(const CMP_BYTE *pData, CMP_DWORD dwSize)>
+		BlockRowWriter;
+	// Hands out the memory of image rows dwRow .. dwRow + dwRowCount - 1,
+	// in the same orientation as the output of Decompress: pData receives
+	// the first row, dwPitch the distance to the next one. The rows are
+	// decoded there before the next call.
+	typedef std::function<bool(CMP_DWORD dwRow, CMP_DWORD dwRowCount,
+		CMP_BYTE *&pData, CMP_DWORD &dwPitch)>
+		TexelRowTarget;
+	// Receives the compressed data of mip level nLevel, of dwWidth x
+	// dwHeight texels. Levels are received in order, 0 being the largest.
+	typedef std::function<bool(CMP_DWORD nLevel, CMP_DWORD dwWidth,
+		CMP_DWORD dwHeight, const CMP_BYTE *pData, CMP_DWORD dwSize)>
+		MipLevelWriter;
+
 	CCodec_ASTC();
 
 	static CMP_BYTE getDefaultEncodeThreads();
@@ -57,30 +142,141 @@ public:
 
 	inline int getBlockRateX() const;
 	inline int getBlockRateY() const;
-	bool setBlockRate(int x, int y);
+	inline int getBlockRateZ() const;
+	bool setBlockRate(int x, int y, int z = 1);
 
 	inline double getQuality() const;
 	inline void setQuality(double value);
 
+	inline bool getIgnoreTransparentRGB() const;
+	inline void setIgnoreTransparentRGB(bool value);
+
+	inline ASTCTexelFormat getTexelFormat() const;
+	inline void setTexelFormat(ASTCTexelFormat value);
+
+	// Block row 0 holds the top image row unless FlipY is set. FlipY
+	// stores the image bottom-up as OpenGL does; texel offsets passed to
+	// the decoder are then counted from the bottom of the image too.
+	inline bool getFlipY() const;
+	inline void setFlipY(bool value);
+
+	// Blocks use the sRGB decode mode of ASTC, with colors kept as 8-bit
+	// sRGB values. 8 and 16-bit images are taken as sRGB encoded already,
+	// half float images as linear: they are converted to sRGB when encoded
+	// and decoded back to linear.
+	inline bool getSRGB() const;
+	inline void setSRGB(bool value);
+
+	// Scans block headers only: whether the image may have texels with
+	// alpha below 1 or with R, G and B not all equal.
+	static void scanBlockTraits(
+		CCodecBuffer &bufferIn, bool &opaque, bool &grayscale);
+
 	// Required interfaces
 	virtual CodecError Compress(
 		CCodecBuffer &bufferIn, CCodecBuffer &bufferOut);
 	virtual CodecError Decompress(
 		CCodecBuffer &bufferIn, CCodecBuffer &bufferOut);
 
+	// Same as Compress, pStats receives the counters and stage times of
+	// the encoder when not null. Gathering them costs a few clock reads
+	// per block. pCosts receives the time, trials and error of every
+	// block, to render heatmaps of.
+	CodecError Compress(CCodecBuffer &bufferIn, CCodecBuffer &bufferOut,
+		ASTCEncodeStats *pStats, ASTCBlockCosts *pCosts = nullptr);
+
+	// Decodes the region of bufferIn starting at the given texel offset.
+	// The region size is the size of bufferOut, its depth included for
+	// volumes. A CBT_RGBA16F bufferOut receives half float texels with HDR
+	// values kept.
+	CodecError Decompress(CCodecBuffer &bufferIn, CCodecBuffer &bufferOut,
+		CMP_DWORD dwOffsetX, CMP_DWORD dwOffsetY, CMP_DWORD dwOffsetZ = 0);
+
+	// Streaming encode of bufferIn: each block row is handed to the writer
+	// as soon as it and all rows before it are done. Workers run at most
+	// a few block rows ahead of the writer. Returns CE_Aborted if the
+	// writer returns false. Block rows of a volume are written one layer
+	// of blocks after another.
+	CodecError CompressBlockRows(CCodecBuffer &bufferIn, CMP_BYTE nBlockWidth,
+		CMP_BYTE nBlockHeight, const BlockRowWriter &writer,
+		CMP_BYTE nBlockDepth = 1);
+
+	// Encodes bufferIn as mip level 0 and the levels below it, down to 1x1
+	// or to nLevels levels when not 0. Each level is downsampled from the
+	// one above it, in linear light when bGammaCorrect is set: 8 and 16-bit
+	// colors are then taken as sRGB encoded. Blocks of all levels share one
+	// encoder setup and one work queue, so the next level is downsampled
+	// while the previous ones are encoded and small levels do not leave
+	// workers idle. Returns CE_Aborted if the writer returns false.
+	// 2D images only.
+	CodecError CompressMipmaps(CCodecBuffer &bufferIn, CMP_BYTE nBlockWidth,
+		CMP_BYTE nBlockHeight, ASTCMipmapFilter filter, bool bGammaCorrect,
+		const MipLevelWriter &writer, CMP_DWORD nLevels = 0);
+
+	// Streaming decode of a dwWidth x dwHeight image, one block row at a
+	// time. Only a single compressed block row is kept in memory, texels
+	// are decoded straight into the rows handed out by target. Returns
+	// CE_Aborted if a callback returns false.
+	CodecError DecompressBlockRows(CMP_BYTE nBlockWidth,
+		CMP_BYTE nBlockHeight, CMP_DWORD dwWidth, CMP_DWORD dwHeight,
+		const BlockRowReader &reader, const TexelRowTarget &target);
+
+	// Decodes the given region of bufferIn downscaled to the size of
+	// bufferOut with a box filter, one block at a time. When an output
+	// pixel covers whole blocks only their average colors are decoded.
+	// 2D blocks only.
+	CodecError DecompressScaled(CCodecBuffer &bufferIn,
+		CCodecBuffer &bufferOut, CMP_DWORD dwOffsetX, CMP_DWORD dwOffsetY,
+		CMP_DWORD dwWidth, CMP_DWORD dwHeight);
+
+	// Picks the slowest speed tier that encodes bufferIn within dSeconds
+	// on the encoder threads, its quality is left for the caller to set.
+	// Each tier is timed encoding nSampleBlocks blocks spread over the
+	// image, from the fastest tier up to the first one predicted to miss
+	// the deadline. A throughput target of T Mpix/s is a deadline of
+	// width * height / (T * 10^6) seconds.
+	CodecError TuneQuality(CCodecBuffer &bufferIn, CMP_BYTE nBlockWidth,
+		CMP_BYTE nBlockHeight, double dSeconds, ASTCQualityTuning &tuning,
+		CMP_DWORD nSampleBlocks = 256, CMP_BYTE nBlockDepth = 1);
+
+	// Error of bufferCompare against bufferSource, of the same size.
+	// bufferSource holds 8-bit texels of the texel format. bufferCompare
+	// holds either decoded texels of the same format or ASTC blocks,
+	// decoded first with the current settings. Rows are split across the
+	// encoder threads. 2D images only.
+	CodecError ComputeMetrics(CCodecBuffer &bufferSource,
+		CCodecBuffer &bufferCompare, ASTCQualityMetrics &metrics);
+
 	virtual CCodecBuffer *CreateBuffer(CMP_BYTE nBlockWidth,
 		CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth, CMP_DWORD dwWidth,
-		CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0) const;
+		CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0,
+		CMP_WORD dwDepth = 1) const;
 
 private:
+	CMP_WORD encodeThreadCount() const;
+	// Encoder params for the current settings and the type of bufferIn
+	ASTC_Encoder::ASTC_Encode *createEncodeParams(
+		CCodecBuffer &bufferIn) const;
+	// Same with the given quality in place of the current one
+	ASTC_Encoder::ASTC_Encode *createEncodeParams(
+		CCodecBuffer &bufferIn, double quality) const;
+
 	static CMP_BYTE sMaxEncodeThreads;
 	static CMP_BYTE sDefaultEncodeThreads;
 
 	CMP_WORD m_NumThreads;
 
-	int m_xdim, m_ydim;
+	int m_xdim, m_ydim, m_zdim;
 
 	double m_Quality;
+
+	bool m_IgnoreTransparentRGB;
+
+	ASTCTexelFormat m_TexelFormat;
+
+	bool m_FlipY;
+
+	bool m_SRGB;
 };
 
 CMP_WORD CCodec_ASTC::getNumThreads() const
@@ -103,6 +299,11 @@ int CCodec_ASTC::getBlockRateY() const
 	return m_ydim;
 }
 
+int CCodec_ASTC::getBlockRateZ() const
+{
+	return m_zdim;
+}
+
 double CCodec_ASTC::getQuality() const
 {
 	return m_Quality;
@@ -113,4 +314,44 @@ void CCodec_ASTC::setQuality(double value)
 	m_Quality = value;
 }
 
+bool CCodec_ASTC::getIgnoreTransparentRGB() const
+{
+	return m_IgnoreTransparentRGB;
+}
+
+void CCodec_ASTC::setIgnoreTransparentRGB(bool value)
+{
+	m_IgnoreTransparentRGB = value;
+}
+
+ASTCTexelFormat CCodec_ASTC::getTexelFormat() const
+{
+	return m_TexelFormat;
+}
+
+void CCodec_ASTC::setTexelFormat(ASTCTexelFormat value)
+{
+	m_TexelFormat = value;
+}
+
+bool CCodec_ASTC::getFlipY() const
+{
+	return m_FlipY;
+}
+
+void CCodec_ASTC::setFlipY(bool value)
+{
+	m_FlipY = value;
+}
+
+bool CCodec_ASTC::getSRGB() const
+{
+	return m_SRGB;
+}
+
+void CCodec_ASTC::setSRGB(bool value)
+{
+	m_SRGB = value;
+}
+
 #endif // !defined(_CODEC_ASTC_H_INCLUDED_)
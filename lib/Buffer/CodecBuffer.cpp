@@ -29,6 +29,8 @@
 
 #include "CodecBuffer.h"
 #include "CodecBuffer_RGBA8888.h"
+#include "CodecBuffer_RGBA16.h"
+#include "CodecBuffer_RGBA16F.h"
 #include "CodecBuffer_Block.h"
 
 #include <cassert>
@@ -37,16 +39,26 @@
 
 CCodecBuffer *CreateCodecBuffer(CodecBufferType nCodecBufferType,
 	CMP_BYTE nBlockWidth, CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth,
-	CMP_DWORD dwWidth, CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData)
+	CMP_DWORD dwWidth, CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData,
+	CMP_WORD dwDepth)
 {
 	switch (nCodecBufferType)
 	{
 		case CBT_RGBA8888:
-			return new CCodecBuffer_RGBA8888(dwWidth, dwHeight, dwPitch, pData);
+			return new CCodecBuffer_RGBA8888(
+				dwWidth, dwHeight, dwPitch, pData, dwDepth);
 
 		case CBT_Block:
 			return new CCodecBuffer_Block(nBlockWidth, nBlockHeight,
-				nBlockDepth, dwWidth, dwHeight, dwPitch, pData);
+				nBlockDepth, dwWidth, dwHeight, dwPitch, pData, dwDepth);
+
+		case CBT_RGBA16:
+			return new CCodecBuffer_RGBA16(
+				dwWidth, dwHeight, dwPitch, pData, dwDepth);
+
+		case CBT_RGBA16F:
+			return new CCodecBuffer_RGBA16F(
+				dwWidth, dwHeight, dwPitch, pData, dwDepth);
 
 		case CBT_Unknown:
 			break;
@@ -61,18 +73,21 @@ CCodecBuffer *CreateCodecBuffer(CodecBufferType nCodecBufferType,
 
 CCodecBuffer::CCodecBuffer(CodecBufferType type, CMP_BYTE nBlockWidth,
 	CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth, CMP_DWORD dwWidth,
-	CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData)
+	CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData, CMP_WORD dwDepth)
 {
 	m_nBufferType = type;
 	m_dwFormat = CMP_FORMAT_Unknown;
 	m_dwWidth = dwWidth;
 	m_dwHeight = dwHeight;
+	m_dwDepth = dwDepth;
 
+	// nBlockDepth here is the bit depth, so the block holds
+	// nBlockWidth * nBlockHeight * nBlockDepth bits.
 	m_nBlockWidth = nBlockWidth;
 	m_nBlockHeight = nBlockHeight;
 	m_nBlockDepth = nBlockDepth;
-	m_dwDepth = nBlockWidth * nBlockHeight * nBlockDepth;
-	m_nBlockSize = (m_dwDepth + 7) / 8;
+	m_nBlockSize = (nBlockWidth * nBlockHeight * nBlockDepth + 7) / 8;
+	m_nLayers = m_dwDepth;
 
 	if (type == CBT_Block)
 	{
@@ -104,17 +119,21 @@ CCodecBuffer::~CCodecBuffer()
 	}
 }
 
-void CCodecBuffer::SetBlockDims(CMP_BYTE BlockWidth, CMP_BYTE BlockHeight)
+void CCodecBuffer::SetBlockDims(
+	CMP_BYTE BlockWidth, CMP_BYTE BlockHeight, CMP_BYTE BlockDepth)
 {
-	if (m_nBlockWidth == BlockWidth && m_nBlockHeight == BlockHeight)
+	if (m_nBlockWidth == BlockWidth && m_nBlockHeight == BlockHeight &&
+		m_nBlockDepth == BlockDepth)
 		return;
 
 	m_nBlockWidth = BlockWidth;
 	m_nBlockHeight = BlockHeight;
+	m_nBlockDepth = BlockDepth;
 	if (m_nBufferType == CBT_Block)
 	{
 		m_nColumns = ((m_dwWidth + BlockWidth - 1) / BlockWidth);
 		m_nRows = ((m_dwHeight + BlockHeight - 1) / BlockHeight);
+		m_nLayers = ((m_dwDepth + BlockDepth - 1) / BlockDepth);
 		m_dwPitch = m_nColumns * m_nBlockSize;
 		if (!m_bUserAllocedData)
 		{
@@ -140,7 +159,29 @@ void CCodecBuffer::WriteBlock(CMP_DWORD x, CMP_DWORD y, CMP_BYTE *pBlock)
 	memcpy(m_pData + y * m_dwPitch + x * m_nBlockSize, pBlock, m_nBlockSize);
 }
 
+void CCodecBuffer::ReadBlock(
+	CMP_DWORD x, CMP_DWORD y, CMP_DWORD z, CMP_BYTE *pBlock)
+{
+	assert(x < GetColumns());
+	assert(y < GetRows());
+	assert(z < GetLayers());
+
+	CMP_DWORD offset = (z * m_nRows + y) * m_dwPitch + x * m_nBlockSize;
+	memcpy(pBlock, m_pData + offset, m_nBlockSize);
+}
+
+void CCodecBuffer::WriteBlock(
+	CMP_DWORD x, CMP_DWORD y, CMP_DWORD z, CMP_BYTE *pBlock)
+{
+	assert(x < GetColumns());
+	assert(y < GetRows());
+	assert(z < GetLayers());
+
+	CMP_DWORD offset = (z * m_nRows + y) * m_dwPitch + x * m_nBlockSize;
+	memcpy(m_pData + offset, pBlock, m_nBlockSize);
+}
+
 CMP_DWORD CCodecBuffer::GetDataSize() const
 {
-	return m_dwPitch * m_nRows;
+	return m_dwPitch * m_nRows * m_nLayers;
 }
@@ -35,7 +35,9 @@
 typedef enum _CodecBufferType {
 	CBT_Unknown = 0,
 	CBT_RGBA8888,
-	CBT_Block
+	CBT_Block,
+	CBT_RGBA16, // 16-bit unsigned normalized R, G, B, A
+	CBT_RGBA16F // half float R, G, B, A
 } CodecBufferType;
 
 class CCodecBuffer
@@ -43,7 +45,8 @@ class CCodecBuffer
 public:
 	CCodecBuffer(CodecBufferType type, CMP_BYTE nBlockWidth,
 		CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth, CMP_DWORD dwWidth,
-		CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0);
+		CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0,
+		CMP_WORD dwDepth = 1);
 	virtual ~CCodecBuffer();
 
 	inline CodecBufferType GetBufferType() const;
@@ -54,6 +57,7 @@ public:
 
 	inline CMP_DWORD GetColumns() const;
 	inline CMP_DWORD GetRows() const;
+	inline CMP_DWORD GetLayers() const;
 
 	inline CMP_DWORD GetPitch() const;
 	inline void SetPitch(CMP_DWORD dwPitch);
@@ -66,12 +70,15 @@ public:
 	inline CMP_BYTE GetBlockDepth() const;
 	inline CMP_WORD GetBlockSize() const;
 
-	void SetBlockDims(CMP_BYTE BlockWidth, CMP_BYTE BlockHeight);
+	void SetBlockDims(
+		CMP_BYTE BlockWidth, CMP_BYTE BlockHeight, CMP_BYTE BlockDepth = 1);
 	inline void SetBlockDepth(CMP_BYTE BlockDepth);
 	inline void SetBlockSize(CMP_WORD BlockSize);
 
 	void ReadBlock(CMP_DWORD x, CMP_DWORD y, CMP_BYTE *pBlock);
 	void WriteBlock(CMP_DWORD x, CMP_DWORD y, CMP_BYTE *pBlock);
+	void ReadBlock(CMP_DWORD x, CMP_DWORD y, CMP_DWORD z, CMP_BYTE *pBlock);
+	void WriteBlock(CMP_DWORD x, CMP_DWORD y, CMP_DWORD z, CMP_BYTE *pBlock);
 
 	inline CMP_BYTE *GetData() const;
 	CMP_DWORD GetDataSize() const;
@@ -86,6 +93,7 @@ protected:
 
 	CMP_DWORD m_nColumns;
 	CMP_DWORD m_nRows;
+	CMP_DWORD m_nLayers; // Slices, or block layers for 3D blocks
 	CMP_WORD m_nBlockSize;
 	CMP_BYTE m_nBlockWidth; // DeCompression Block Sizes (Default is 4x4x1)
 	CMP_BYTE m_nBlockHeight; //
@@ -125,6 +133,11 @@ CMP_DWORD CCodecBuffer::GetRows() const
 	return m_nRows;
 }
 
+CMP_DWORD CCodecBuffer::GetLayers() const
+{
+	return m_nLayers;
+}
+
 CMP_DWORD CCodecBuffer::GetPitch() const
 {
 	return m_dwPitch;
@@ -183,6 +196,6 @@ CMP_BYTE *CCodecBuffer::GetData() const
 CCodecBuffer *CreateCodecBuffer(CodecBufferType nCodecBufferType,
 	CMP_BYTE nBlockWidth, CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth,
 	CMP_DWORD dwWidth, CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0,
-	CMP_BYTE *pData = 0);
+	CMP_BYTE *pData = 0, CMP_WORD dwDepth = 1);
 
 #endif // !defined(_CODECBUFFER_H_INCLUDED_)
@@ -39,8 +39,8 @@
 
 CCodecBuffer_Block::CCodecBuffer_Block(CMP_BYTE nBlockWidth,
 	CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth, CMP_DWORD dwWidth,
-	CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData)
+	CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData, CMP_WORD dwDepth)
 	: CCodecBuffer(CBT_Block, nBlockWidth, nBlockHeight, nBlockDepth, dwWidth,
-		  dwHeight, dwPitch, pData)
+		  dwHeight, dwPitch, pData, dwDepth)
 {
 }
@@ -0,0 +1,47 @@
+//===============================================================================
+// Copyright (c) 2007-2016  Advanced Micro Devices, Inc. All rights reserved.
+// Copyright (c) 2004-2006 ATI Technologies Inc.
+//===============================================================================
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+//
+//  File Name:   CodecBuffer_RGBA16F.cpp
+//  Description: implementation of the CCodecBuffer_RGBA16F class
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "CodecBuffer_RGBA16F.h"
+
+#include <cassert>
+#include <cstring>
+
+//////////////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+
+CCodecBuffer_RGBA16F::CCodecBuffer_RGBA16F(CMP_DWORD dwWidth, CMP_DWORD dwHeight,
+	CMP_DWORD dwPitch, CMP_BYTE *pData, CMP_WORD dwDepth)
+	: CCodecBuffer(CBT_RGBA16F, 4, 1, 16, dwWidth, dwHeight, dwPitch, pData,
+		  dwDepth)
+{
+	m_dwFormat = CMP_FORMAT_RGBA_16F;
+}
@@ -38,9 +38,10 @@
 
 #include <cstdlib>
 
-CCodecBuffer_RGBA8888::CCodecBuffer_RGBA8888(
-	CMP_DWORD dwWidth, CMP_DWORD dwHeight, CMP_DWORD dwPitch, CMP_BYTE *pData)
-	: CCodecBuffer(CBT_RGBA8888, 4, 1, 8, dwWidth, dwHeight, dwPitch, pData)
+CCodecBuffer_RGBA8888::CCodecBuffer_RGBA8888(CMP_DWORD dwWidth, CMP_DWORD dwHeight,
+	CMP_DWORD dwPitch, CMP_BYTE *pData, CMP_WORD dwDepth)
+	: CCodecBuffer(CBT_RGBA8888, 4, 1, 8, dwWidth, dwHeight, dwPitch, pData,
+		  dwDepth)
 {
 	m_dwFormat = CMP_FORMAT_RGBA_8888;
 }
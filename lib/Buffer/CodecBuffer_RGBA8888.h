@@ -35,7 +35,7 @@ class CCodecBuffer_RGBA8888 : public CCodecBuffer
 {
 public:
 	CCodecBuffer_RGBA8888(CMP_DWORD dwWidth, CMP_DWORD dwHeight,
-		CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0);
+		CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0, CMP_WORD dwDepth = 1);
 };
 
 #endif // !defined(_CODECBUFFER_RGBA8888_H_INCLUDED_)
@@ -45,8 +45,8 @@ public:
 
 	virtual CCodecBuffer *CreateBuffer(CMP_BYTE nBlockWidth,
 		CMP_BYTE nBlockHeight, CMP_BYTE nBlockDepth, CMP_DWORD dwWidth,
-		CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0,
-		CMP_BYTE *pData = 0) const = 0;
+		CMP_DWORD dwHeight, CMP_DWORD dwPitch = 0, CMP_BYTE *pData = 0,
+		CMP_WORD dwDepth = 1) const = 0;
 
 	virtual CodecError Compress(
 		CCodecBuffer &bufferIn, CCodecBuffer &bufferOut) = 0;
@@ -0,0 +1,46 @@
+# Codec sources, built into each target that includes this file
+
+INCLUDEPATH += $$PWD $$PWD/Buffer
+
+HEADERS += \
+    $$PWD/ASTC/cASTC.h \
+    $$PWD/ASTC/ARM/astc_codec_internals.h \
+    $$PWD/ASTC/ARM/mathlib.h \
+    $$PWD/ASTC/ARM/softfloat.h \
+    $$PWD/ASTC/ARM/vectypes.h \
+    $$PWD/ASTC/ASTC_Decode.h \
+    $$PWD/ASTC/ASTC_Definitions.h \
+    $$PWD/ASTC/ASTC_Encode.h \
+    $$PWD/ASTC/ASTC_Encode_Kernel.h \
+    $$PWD/ASTC/ASTC_Host.h \
+    $$PWD/ASTC/ASTC_Metrics.h \
+    $$PWD/ASTC/ASTC_Mipmap.h \
+    $$PWD/ASTC/ASTC_Stats.h \
+    $$PWD/ASTC/ASTC_Trace.h \
+    $$PWD/ASTC/Codec_ASTC.h \
+    $$PWD/Buffer/CodecBuffer.h \
+    $$PWD/Buffer/CodecBuffer_Block.h \
+    $$PWD/Buffer/CodecBuffer_RGBA8888.h \
+    $$PWD/Buffer/CodecBuffer_RGBA16.h \
+    $$PWD/Buffer/CodecBuffer_RGBA16F.h \
+    $$PWD/Codec.h \
+    $$PWD/CommonTypes.h \
+    $$PWD/MathMacros.h
+
+SOURCES += \
+    $$PWD/ASTC/ARM/mathlib.cpp \
+    $$PWD/ASTC/ARM/softfloat.cpp \
+    $$PWD/ASTC/ASTC_Decode.cpp \
+    $$PWD/ASTC/ASTC_Encode.cpp \
+    $$PWD/ASTC/ASTC_Encode_Kernel.cpp \
+    $$PWD/ASTC/ASTC_Host.cpp \
+    $$PWD/ASTC/ASTC_Metrics.cpp \
+    $$PWD/ASTC/ASTC_Mipmap.cpp \
+    $$PWD/ASTC/ASTC_Trace.cpp \
+    $$PWD/ASTC/Codec_ASTC.cpp \
+    $$PWD/Buffer/CodecBuffer.cpp \
+    $$PWD/Buffer/CodecBuffer_Block.cpp \
+    $$PWD/Buffer/CodecBuffer_RGBA8888.cpp \
+    $$PWD/Buffer/CodecBuffer_RGBA16.cpp \
+    $$PWD/Buffer/CodecBuffer_RGBA16F.cpp \
+    $$PWD/Codec.cpp
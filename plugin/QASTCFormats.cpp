@@ -0,0 +1,151 @@
+#include "QASTCFormats.h"
+
+namespace QASTCFormats
+{
+// Sub type suffix of blocks encoded in the sRGB mode
+static const char SRGB_SUFFIX[] = "-srgb";
+
+bool toTexelFormat(QImage::Format format, ASTCTexelFormat *result)
+{
+	switch (format)
+	{
+		case QImage::Format_RGBA8888:
+			*result = ASTC_TEXEL_RGBA8888;
+			return true;
+
+		case QImage::Format_RGBX8888:
+			*result = ASTC_TEXEL_RGBX8888;
+			return true;
+
+		case QImage::Format_ARGB32:
+			*result = ASTC_TEXEL_ARGB32;
+			return true;
+
+		case QImage::Format_ARGB32_Premultiplied:
+			*result = ASTC_TEXEL_ARGB32_PREMULTIPLIED;
+			return true;
+
+		case QImage::Format_Grayscale8:
+			*result = ASTC_TEXEL_GRAY8;
+			return true;
+
+		case QImage::Format_RGB32:
+			*result = ASTC_TEXEL_RGB32;
+			return true;
+
+		default:
+			break;
+	}
+
+	return false;
+}
+
+bool toSourceFormat(
+	QImage &image, CodecBufferType *type, ASTCTexelFormat *format)
+{
+	switch (image.format())
+	{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+		case QImage::Format_RGBA64_Premultiplied:
+			image = image.convertToFormat(QImage::Format_RGBA64);
+			// fall through
+		case QImage::Format_RGBA64:
+			*type = CBT_RGBA16;
+			*format = ASTC_TEXEL_RGBA8888;
+			return true;
+
+		case QImage::Format_RGBX64:
+			*type = CBT_RGBA16;
+			*format = ASTC_TEXEL_RGBX8888;
+			return true;
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+		case QImage::Format_RGBA16FPx4_Premultiplied:
+			image = image.convertToFormat(QImage::Format_RGBA16FPx4);
+			// fall through
+		case QImage::Format_RGBA16FPx4:
+			*type = CBT_RGBA16F;
+			*format = ASTC_TEXEL_RGBA8888;
+			return true;
+
+		case QImage::Format_RGBX16FPx4:
+			*type = CBT_RGBA16F;
+			*format = ASTC_TEXEL_RGBX8888;
+			return true;
+#endif
+		default:
+			break;
+	}
+
+	*type = CBT_RGBA8888;
+	return toTexelFormat(image.format(), format);
+}
+
+bool toTargetFormat(
+	QImage::Format format, CodecBufferType *type, ASTCTexelFormat *result)
+{
+	switch (format)
+	{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+		case QImage::Format_RGBA16FPx4:
+			*type = CBT_RGBA16F;
+			*result = ASTC_TEXEL_RGBA8888;
+			return true;
+
+		case QImage::Format_RGBX16FPx4:
+			*type = CBT_RGBA16F;
+			*result = ASTC_TEXEL_RGBX8888;
+			return true;
+#endif
+		default:
+			break;
+	}
+
+	*type = CBT_RGBA8888;
+	return toTexelFormat(format, result);
+}
+
+QImage::Format autoImageFormat(CCodecBuffer &buffer)
+{
+	bool opaque;
+	bool grayscale;
+	CCodec_ASTC::scanBlockTraits(buffer, opaque, grayscale);
+	return autoImageFormat(opaque, grayscale);
+}
+
+QImage::Format autoImageFormat(bool opaque, bool grayscale)
+{
+	if (!opaque)
+		return QImage::Format_ARGB32_Premultiplied;
+
+	return grayscale ? QImage::Format_Grayscale8 : QImage::Format_RGBX8888;
+}
+
+QByteArray toSubType(int xdim, int ydim, int zdim, bool srgb)
+{
+	QByteArray result =
+		QByteArray::number(xdim) + "x" + QByteArray::number(ydim);
+	if (zdim > 1)
+		result += "x" + QByteArray::number(zdim);
+	if (srgb)
+		result += SRGB_SUFFIX;
+	return result;
+}
+
+bool fromSubType(QByteArray subType, int *xdim, int *ydim, int *zdim,
+	bool *srgb)
+{
+	*srgb = subType.endsWith(SRGB_SUFFIX);
+	if (*srgb)
+		subType.chop(int(sizeof(SRGB_SUFFIX)) - 1);
+
+	auto split = subType.split('x');
+	if (split.size() != 2 && split.size() != 3)
+		return false;
+
+	*xdim = split.at(0).toInt();
+	*ydim = split.at(1).toInt();
+	*zdim = split.size() == 3 ? split.at(2).toInt() : 1;
+	return CCodec_ASTC::isValidBlockSize(*xdim, *ydim, *zdim);
+}
+}
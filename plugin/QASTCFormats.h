@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ASTC/Codec_ASTC.h"
+
+#include <QByteArray>
+#include <QImage>
+
+// Conversions between Qt image formats and codec buffers, shared by the
+// handlers of the plugin
+namespace QASTCFormats
+{
+bool toTexelFormat(QImage::Format format, ASTCTexelFormat *result);
+
+// Picks the buffer the encoder reads the image from, 16-bit formats keep
+// their precision and only premultiplied ones are converted
+bool toSourceFormat(
+	QImage &image, CodecBufferType *type, ASTCTexelFormat *format);
+
+// Picks the buffer the decoder writes the image to, half float images
+// receive HDR texels as they are decoded
+bool toTargetFormat(
+	QImage::Format format, CodecBufferType *type, ASTCTexelFormat *result);
+
+// Picks the format Qt paints fastest from the block headers: Grayscale8
+// or RGBX8888 for opaque images, ARGB32_Premultiplied otherwise
+QImage::Format autoImageFormat(CCodecBuffer &buffer);
+// Same from the traits scanned by CCodec_ASTC::scanBlockTraits
+QImage::Format autoImageFormat(bool opaque, bool grayscale);
+
+// Sub types name the block size, "-srgb" marks blocks encoded in the sRGB
+// mode: "6x6", "4x4x4-srgb"
+QByteArray toSubType(int xdim, int ydim, int zdim, bool srgb);
+bool fromSubType(QByteArray subType, int *xdim, int *ydim, int *zdim,
+	bool *srgb);
+}
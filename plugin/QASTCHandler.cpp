@@ -1,12 +1,22 @@
 ﻿#include "QASTCHandler.h"
+#include "QASTCFormats.h"
 
 #include "ASTC/cASTC.h"
+#include "ASTC/ASTC_Trace.h"
 #include "ASTC/Codec_ASTC.h"
 #include "Buffer/CodecBuffer_Block.h"
 
+#include <QFileDevice>
 #include <QImage>
 #include <QVariant>
 
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+#include <QColorSpace>
+#endif
+
+#include <algorithm>
+#include <limits>
+
 struct QASTCHandler::Header
 {
 	quint8 xdim;
@@ -19,15 +29,33 @@ struct QASTCHandler::Header
 	bool readFrom(const astc_header &other);
 	bool readFrom(QIODevice *device);
 	bool peekFrom(QIODevice *device);
+	bool writeTo(QIODevice *device) const;
 
-	QByteArray toSubType() const;
+	// Slices of a volume are stacked top to bottom in the image
+	QSize imageSize() const;
+	// Size of the blocks following the header
+	qint64 dataSize() const;
+
+	QByteArray toSubType(bool srgb) const;
 	static const QByteArrayList &validSubTypes();
 };
 
+using namespace QASTCFormats;
+
+// Text key of the slice count of volumes
+static const char SLICES_KEY[] = "Slices";
+
 QASTCHandler::QASTCHandler()
 	: mQuality(-1)
 	, mBlockWidth(4)
 	, mBlockHeight(4)
+	, mBlockDepth(1)
+	, mImageFormat(QImage::Format_Invalid)
+	, mTransformation(TransformationNone)
+	, mProgressiveScanWrite(false)
+	, mOptimizedWrite(false)
+	, mSliceCount(0)
+	, mSRGB(false)
 {
 }
 
@@ -66,6 +94,7 @@ bool QASTCHandler::canRead() const
 
 bool QASTCHandler::read(QImage *image)
 {
+	ASTCTraceScope trace("QASTCHandler::read", "io");
 	if (!validateHeader(device()))
 		return false;
 
@@ -75,33 +104,312 @@ bool QASTCHandler::read(QImage *image)
 		return false;
 	}
 
+	// Automatic formats are picked from every block of the file, whatever
+	// part of it is read
+	QImage::Format format = mImageFormat;
+	if (format == QImage::Format_Invalid)
+		format = scanImageFormat(header, 0);
+	if (format == QImage::Format_Invalid)
+		return false;
+
+	if (header.zdim > 1 || header.zsize > 1)
+		return readVolume(header, format, image);
+
+	QRect rect(0, 0, header.xsize, header.ysize);
+	if (mClipRect.isValid())
+	{
+		rect &= mClipRect;
+		if (rect.isEmpty())
+			return false;
+	}
+
+	bool scaled = mScaledSize.isValid() && !mScaledSize.isEmpty() &&
+		mScaledSize != rect.size();
+
+	// Rows of the rect in storage order, bottom-up files count them from
+	// the bottom of the image
+	int firstStoredRow =
+		isBottomUp() ? header.ysize - 1 - rect.bottom() : rect.top();
+	int firstBlockRow = firstStoredRow / header.ydim;
+	int lastBlockRow = (firstStoredRow + rect.height() - 1) / header.ydim;
+	int firstRow = firstBlockRow * header.ydim;
+	int rowCount = std::min(
+		(lastBlockRow + 1) * header.ydim, header.ysize) - firstRow;
+
+	// Only the block rows covering the rect are used
+	qint64 rowSize = qint64((header.xsize + header.xdim - 1) / header.xdim) *
+		ASTC_COMPRESSED_BLOCK_SIZE;
+	qint64 skipSize = rowSize * firstBlockRow;
+	qint64 dataSize = rowSize * (lastBlockRow - firstBlockRow + 1);
+
+	// Files are decoded straight from the mapped pages
+	auto file = qobject_cast<QFileDevice *>(device());
+	uchar *mapped = nullptr;
+	if (file && !file->isSequential())
+	{
+		ASTCTraceScope mapTrace("map", "io");
+		mapped = file->map(file->pos() + skipSize, dataSize);
+	}
+
+	CodecBufferType bufferType;
+	ASTCTexelFormat texelFormat;
+	toTargetFormat(format, &bufferType, &texelFormat);
+
+	// Half float images are decoded at full size by whole blocks
+	bool halfFloat = bufferType == CBT_RGBA16F;
+	if (!mapped && !scaled && !halfFloat &&
+		rect.size() == QSize(header.xsize, header.ysize))
+	{
+		return readBlockRows(header, format, image);
+	}
+
 	CCodec_ASTC codec;
+	codec.setSRGB(mSRGB);
+	codec.setFlipY(isBottomUp());
 
 	QScopedPointer<CCodecBuffer> srcCodecBuffer(codec.CreateBuffer(
-		header.xdim, header.ydim, 0, header.xsize, header.ysize));
-	auto dwTotalSize = srcCodecBuffer->GetDataSize();
-	if (device()->read(reinterpret_cast<char *>(srcCodecBuffer->GetData()),
-			dwTotalSize) != dwTotalSize)
+		header.xdim, header.ydim, 0, header.xsize, rowCount, 0, mapped));
+	Q_ASSERT(srcCodecBuffer->GetDataSize() == dataSize);
+
+	if (mapped)
+	{
+		// Leave the device where reading the data would
+		file->seek(file->pos() + skipSize + dataSize);
+	} else
+	{
+		ASTCTraceScope readTrace("device read", "io");
+		readTrace.arg("bytes", dataSize);
+		if (!skipBytes(device(), skipSize) ||
+			device()->read(reinterpret_cast<char *>(srcCodecBuffer->GetData()),
+				dataSize) != dataSize)
+		{
+			return false;
+		}
+	}
+
+	QSize size = rect.size();
+	// Downscaling is done by the decoder block by block
+	bool downscale = !halfFloat && scaled &&
+		mScaledSize.width() <= size.width() &&
+		mScaledSize.height() <= size.height();
+	if (downscale)
+		size = mScaledSize;
+
+	codec.setTexelFormat(texelFormat);
+
+	// Texels are decoded right into the image memory
+	QImage result(size, format);
+	CodecError error = CE_Unknown;
+	if (!result.isNull())
+	{
+		QScopedPointer<CCodecBuffer> dstCodecBuffer(
+			CreateCodecBuffer(bufferType, 0, 0, 0, size.width(),
+				size.height(), result.bytesPerLine(), result.bits()));
+
+		error = downscale
+			? codec.DecompressScaled(*srcCodecBuffer, *dstCodecBuffer,
+				  rect.x(), firstStoredRow - firstRow, rect.width(),
+				  rect.height())
+			: codec.Decompress(*srcCodecBuffer, *dstCodecBuffer, rect.x(),
+				  firstStoredRow - firstRow);
+	}
+
+	if (mapped)
+	{
+		srcCodecBuffer.reset();
+		file->unmap(mapped);
+	}
+
+	if (error != CE_OK)
 	{
 		return false;
 	}
 
-	QScopedPointer<CCodecBuffer> dstCodecBuffer(
-		CreateCodecBuffer(CBT_RGBA8888, 0, 0, 0, header.xsize, header.ysize));
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+	// Half float colors of sRGB blocks are decoded to linear
+	if (halfFloat && mSRGB)
+		result.setColorSpace(QColorSpace::SRgbLinear);
+#endif
+
+	if (scaled && mScaledSize != size)
+	{
+		result = result.scaled(
+			mScaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+
+	*image = result;
+	return true;
+}
+
+bool QASTCHandler::readBlockRows(
+	const Header &header, QImage::Format format, QImage *image)
+{
+	ASTCTexelFormat texelFormat;
+	if (!toTexelFormat(format, &texelFormat))
+		return false;
+
+	QImage result(header.xsize, header.ysize, format);
+	if (result.isNull())
+		return false;
+
+	// Compressed data is pulled from the device one block row at a time
+	// and its texels are decoded straight into the scanlines of the image
+	auto device = this->device();
+	auto reader = [device](CMP_BYTE *pData, CMP_DWORD dwSize) {
+		ASTCTraceScope trace("device read", "io");
+		trace.arg("bytes", dwSize);
+		return device->read(reinterpret_cast<char *>(pData), dwSize) ==
+			dwSize;
+	};
+	auto target = [&result](CMP_DWORD dwRow, CMP_DWORD,
+					  CMP_BYTE *&pData, CMP_DWORD &dwPitch) {
+		pData = result.scanLine(int(dwRow));
+		dwPitch = CMP_DWORD(result.bytesPerLine());
+		return true;
+	};
+
+	CCodec_ASTC codec;
+	codec.setTexelFormat(texelFormat);
+	codec.setSRGB(mSRGB);
+	codec.setFlipY(isBottomUp());
+	if (codec.DecompressBlockRows(header.xdim, header.ydim, header.xsize,
+			header.ysize, reader, target) != CE_OK)
+	{
+		return false;
+	}
+
+	*image = result;
+	return true;
+}
+
+bool QASTCHandler::readVolume(
+	const Header &header, QImage::Format format, QImage *image)
+{
+	ASTCTraceScope trace("QASTCHandler::readVolume", "io");
+
+	// Slices are stacked top to bottom in the image
+	QRect rect(QPoint(0, 0), header.imageSize());
+	if (mClipRect.isValid())
+	{
+		rect &= mClipRect;
+		if (rect.isEmpty())
+			return false;
+	}
+
+	int firstSlice = rect.top() / header.ysize;
+	int lastSlice = rect.bottom() / header.ysize;
+
+	// Only the block layers covering the slices of the rect are used
+	int firstLayer = firstSlice / header.zdim;
+	int lastLayer = lastSlice / header.zdim;
+	int firstZ = firstLayer * header.zdim;
+	int depth = std::min(
+		(lastLayer + 1) * header.zdim, header.zsize) - firstZ;
+	qint64 layerSize = qint64((header.xsize + header.xdim - 1) /
+		header.xdim) * ((header.ysize + header.ydim - 1) / header.ydim) *
+		ASTC_COMPRESSED_BLOCK_SIZE;
+	qint64 skipSize = layerSize * firstLayer;
+	qint64 dataSize = layerSize * (lastLayer - firstLayer + 1);
+
+	// Files are decoded straight from the mapped pages
+	auto file = qobject_cast<QFileDevice *>(device());
+	uchar *mapped = nullptr;
+	if (file && !file->isSequential())
+	{
+		ASTCTraceScope mapTrace("map", "io");
+		mapped = file->map(file->pos() + skipSize, dataSize);
+	}
+
+	CCodec_ASTC codec;
+	codec.setSRGB(mSRGB);
+	codec.setFlipY(isBottomUp());
+
+	QScopedPointer<CCodecBuffer> srcCodecBuffer(
+		codec.CreateBuffer(header.xdim, header.ydim, header.zdim,
+			header.xsize, header.ysize, 0, mapped, depth));
+	Q_ASSERT(srcCodecBuffer->GetDataSize() == dataSize);
+
+	if (mapped)
+	{
+		// Leave the device where reading the data would
+		file->seek(file->pos() + skipSize + dataSize);
+	} else
+	{
+		ASTCTraceScope readTrace("device read", "io");
+		readTrace.arg("bytes", dataSize);
+		if (!skipBytes(device(), skipSize) ||
+			device()->read(reinterpret_cast<char *>(srcCodecBuffer->GetData()),
+				dataSize) != dataSize)
+		{
+			return false;
+		}
+	}
+
+	CodecBufferType bufferType;
+	ASTCTexelFormat texelFormat;
+	toTargetFormat(format, &bufferType, &texelFormat);
+	codec.setTexelFormat(texelFormat);
 
-	if (codec.Decompress(*srcCodecBuffer, *dstCodecBuffer) != CE_OK)
+	// Texels are decoded right into the image memory: the rows of a slice
+	// the rect cuts are decoded alone, runs of whole slices together
+	QImage result(rect.size(), format);
+	bool ok = !result.isNull();
+	for (int z = firstSlice; ok && z <= lastSlice;)
 	{
+		QRect slice(0, z * header.ysize, header.xsize, header.ysize);
+		QRect band = rect & slice;
+		int slices = 1;
+		if (band.height() == header.ysize)
+		{
+			while (z + slices <= lastSlice &&
+				(rect & slice.translated(0, slices * header.ysize))
+						.height() == header.ysize)
+			{
+				slices++;
+			}
+		}
+
+		int top = band.top() - slice.top();
+		int storedRow = isBottomUp() ? header.ysize - top - band.height()
+									 : top;
+		QScopedPointer<CCodecBuffer> dstCodecBuffer(
+			CreateCodecBuffer(bufferType, 0, 0, 0, band.width(),
+				band.height(), result.bytesPerLine(),
+				result.scanLine(band.top() - rect.top()), slices));
+
+		ok = codec.Decompress(*srcCodecBuffer, *dstCodecBuffer, rect.x(),
+				 storedRow, z - firstZ) == CE_OK;
+		z += slices;
+	}
+
+	if (mapped)
+	{
+		srcCodecBuffer.reset();
+		file->unmap(mapped);
+	}
+
+	if (!ok)
 		return false;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+	if (bufferType == CBT_RGBA16F && mSRGB)
+		result.setColorSpace(QColorSpace::SRgbLinear);
+#endif
+
+	if (mScaledSize.isValid() && !mScaledSize.isEmpty() &&
+		mScaledSize != result.size())
+	{
+		result = result.scaled(
+			mScaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
 	}
 
-	auto buffer = dstCodecBuffer.take();
-	*image = QImage(buffer->GetData(), header.xsize, header.ysize,
-		QImage::Format_RGBA8888, &QASTCHandler::QImageTextureCleanup, buffer);
+	*image = result;
 	return true;
 }
 
 bool QASTCHandler::write(const QImage &image)
 {
+	ASTCTraceScope trace("QASTCHandler::write", "io");
 	if (!device() || !device()->isWritable())
 		return false;
 
@@ -110,47 +418,80 @@ bool QASTCHandler::write(const QImage &image)
 	{
 		codec.setQuality(mQuality / 100.0);
 	}
-	codec.setBlockRate(mBlockWidth, mBlockHeight);
-
+	codec.setBlockRate(mBlockWidth, mBlockHeight, mBlockDepth);
+	codec.setSRGB(mSRGB);
+	// Optimized writes spend no bits on the color of invisible texels
+	codec.setIgnoreTransparentRGB(mOptimizedWrite);
+	// Rows are reordered by the encoder, with no copy. Slices of a volume
+	// are flipped one by one.
+	codec.setFlipY(isBottomUp());
+
+	// Common formats are read by the encoder as they are
 	auto img = image;
-	if (img.format() != QImage::Format_RGBA8888)
-		img = img.convertToFormat(QImage::Format_RGBA8888);
+	CodecBufferType bufferType;
+	ASTCTexelFormat texelFormat;
+	if (!toSourceFormat(img, &bufferType, &texelFormat))
+	{
+		img = img.convertToFormat(QImage::Format_ARGB32);
+		texelFormat = ASTC_TEXEL_ARGB32;
+	}
+	codec.setTexelFormat(texelFormat);
+
+	// Images are 2D unless the Slices text of the writer or the image
+	// tells how many slices are stacked top to bottom in a volume
+	int depth = mSliceCount > 0
+		? mSliceCount
+		: std::max(image.text(QLatin1String(SLICES_KEY)).toInt(), 1);
+	if (img.height() % depth != 0)
+		return false;
 
-	QScopedPointer<CCodecBuffer> srcCodecBuffer(CreateCodecBuffer(CBT_RGBA8888,
-		0, 0, 0, img.width(), img.height(), img.bytesPerLine(), img.bits()));
+	Header header;
+	header.xdim = mBlockWidth;
+	header.ydim = mBlockHeight;
+	header.zdim = mBlockDepth;
+	header.xsize = img.width();
+	header.ysize = img.height() / depth;
+	header.zsize = depth;
+
+	QScopedPointer<CCodecBuffer> srcCodecBuffer(CreateCodecBuffer(bufferType,
+		0, 0, 0, header.xsize, header.ysize, img.bytesPerLine(),
+		const_cast<uchar *>(img.constBits()), header.zsize));
+
+	auto device = this->device();
+	if (mProgressiveScanWrite)
+	{
+		// Block rows go to the device as soon as they are encoded
+		if (!header.writeTo(device))
+			return false;
+
+		auto writer = [device](const CMP_BYTE *pData, CMP_DWORD dwSize) {
+			ASTCTraceScope trace("device write", "io");
+			trace.arg("bytes", dwSize);
+			return device->write(reinterpret_cast<const char *>(pData),
+					   dwSize) == dwSize;
+		};
+
+		return codec.CompressBlockRows(*srcCodecBuffer, mBlockWidth,
+				   mBlockHeight, writer, mBlockDepth) == CE_OK;
+	}
 
-	QScopedPointer<CCodecBuffer> dstCodecBuffer(codec.CreateBuffer(
-		mBlockWidth, mBlockHeight, 0, img.width(), img.height()));
+	QScopedPointer<CCodecBuffer> dstCodecBuffer(
+		codec.CreateBuffer(mBlockWidth, mBlockHeight, mBlockDepth,
+			header.xsize, header.ysize, 0, nullptr, header.zsize));
 
 	if (codec.Compress(*srcCodecBuffer, *dstCodecBuffer) != CE_OK)
 	{
 		return false;
 	}
 
-	astc_header header;
-	header.magic[0] = quint8(MAGIC_FILE_CONSTANT);
-	header.magic[1] = quint8(MAGIC_FILE_CONSTANT >> 8);
-	header.magic[2] = quint8(MAGIC_FILE_CONSTANT >> 16);
-	header.magic[3] = quint8(MAGIC_FILE_CONSTANT >> 24);
-	header.blockdim_x = mBlockWidth;
-	header.blockdim_y = mBlockHeight;
-	header.blockdim_z = 1;
-	header.xsize[0] = quint8(img.width());
-	header.xsize[1] = quint8(img.width() >> 8);
-	header.xsize[2] = quint8(img.width() >> 16);
-	header.ysize[0] = quint8(img.height());
-	header.ysize[1] = quint8(img.height() >> 8);
-	header.ysize[2] = quint8(img.height() >> 16);
-	header.zsize[0] = 1;
-	header.zsize[1] = 0;
-	header.zsize[2] = 0;
-	if (device()->write(reinterpret_cast<char *>(&header), sizeof(header)) !=
-		sizeof(header))
+	if (!header.writeTo(device))
 	{
 		return false;
 	}
 	CMP_DWORD dataSize = dstCodecBuffer->GetDataSize();
-	return device()->write(reinterpret_cast<char *>(dstCodecBuffer->GetData()),
+	ASTCTraceScope writeTrace("device write", "io");
+	writeTrace.arg("bytes", dataSize);
+	return device->write(reinterpret_cast<char *>(dstCodecBuffer->GetData()),
 			   dataSize) == dataSize;
 }
 
@@ -162,7 +503,7 @@ QVariant QASTCHandler::option(ImageOption option) const
 		{
 			Header header;
 			if (header.peekFrom(device()))
-				return QSize(header.xsize, header.ysize);
+				return header.imageSize();
 			break;
 		}
 
@@ -170,7 +511,7 @@ QVariant QASTCHandler::option(ImageOption option) const
 		{
 			Header header;
 			if (header.peekFrom(device()))
-				return header.toSubType();
+				return header.toSubType(mSRGB);
 			break;
 		}
 
@@ -183,20 +524,44 @@ QVariant QASTCHandler::option(ImageOption option) const
 		}
 
 		case ClipRect:
+			return mClipRect;
+
+		case ScaledSize:
+			return mScaledSize;
+
+		case IncrementalReading:
+			return true;
+
+		case ImageFormat:
+			return peekImageFormat();
+
+		case ImageTransformation:
+			return int(mTransformation);
+
+		case ProgressiveScanWrite:
+			return mProgressiveScanWrite;
+
+		case OptimizedWrite:
+			return mOptimizedWrite;
+
 		case Description:
+		{
+			Header header;
+			if (header.peekFrom(device()) && header.zsize > 1)
+			{
+				return QString::fromLatin1(SLICES_KEY) +
+					QStringLiteral(": ") + QString::number(header.zsize);
+			}
+			break;
+		}
+
 		case ScaledClipRect:
-		case ScaledSize:
 		case CompressionRatio:
 		case Gamma:
 		case Name:
-		case IncrementalReading:
 		case Endianness:
 		case Animation:
 		case BackgroundColor:
-		case ImageFormat:
-		case OptimizedWrite:
-		case ProgressiveScanWrite:
-		case ImageTransformation:
 		case TransformedByDefault:
 			break;
 	}
@@ -218,27 +583,74 @@ void QASTCHandler::setOption(ImageOption option, const QVariant &value)
 
 		case SubType:
 		{
-			auto split = value.toByteArray().split('x');
-			if (split.size() == 2)
+			// The file header does not tell sRGB blocks apart, the sub
+			// type chooses how they are encoded and decoded
+			int w;
+			int h;
+			int d;
+			bool srgb;
+			if (fromSubType(value.toByteArray(), &w, &h, &d, &srgb))
 			{
-				int w = split.at(0).toInt();
-				int h = split.at(1).toInt();
-				if (CCodec_ASTC::isValidBlockSize(w, h, 1))
-				{
-					mBlockWidth = quint8(w);
-					mBlockHeight = quint8(h);
-				}
+				mBlockWidth = quint8(w);
+				mBlockHeight = quint8(h);
+				mBlockDepth = quint8(d);
+				mSRGB = srgb;
 			}
 
 			break;
 		}
 
-		case Size:
-		case SupportedSubTypes:
 		case ClipRect:
+			mClipRect = value.toRect();
+			break;
+
+		case ScaledSize:
+			mScaledSize = value.toSize();
+			break;
+
+		case ProgressiveScanWrite:
+			mProgressiveScanWrite = value.toBool();
+			break;
+
+		case OptimizedWrite:
+			mOptimizedWrite = value.toBool();
+			break;
+
 		case Description:
+		{
+			// Texts of the writer come as "key: value" pairs, only the
+			// slice count is used
+			mSliceCount = 0;
+			for (auto &pair : value.toString().split(QStringLiteral("\n\n")))
+			{
+				int index = pair.indexOf(QStringLiteral(": "));
+				if (index > 0 && pair.left(index) == QLatin1String(SLICES_KEY))
+					mSliceCount = std::max(pair.mid(index + 2).toInt(), 1);
+			}
+			break;
+		}
+
+		case ImageTransformation:
+			// Only a vertical flip is supported, it selects top-down rows
+			mTransformation = Transformations(value.toInt()) &
+				TransformationFlip;
+			break;
+
+		case ImageFormat:
+		{
+			// Other formats fall back to the automatic choice
+			auto format = QImage::Format(value.toInt());
+			CodecBufferType bufferType;
+			ASTCTexelFormat texelFormat;
+			mImageFormat = toTargetFormat(format, &bufferType, &texelFormat)
+				? format
+				: QImage::Format_Invalid;
+			break;
+		}
+
+		case Size:
+		case SupportedSubTypes:
 		case ScaledClipRect:
-		case ScaledSize:
 		case CompressionRatio:
 		case Gamma:
 		case Name:
@@ -246,10 +658,6 @@ void QASTCHandler::setOption(ImageOption option, const QVariant &value)
 		case Endianness:
 		case Animation:
 		case BackgroundColor:
-		case ImageFormat:
-		case OptimizedWrite:
-		case ProgressiveScanWrite:
-		case ImageTransformation:
 		case TransformedByDefault:
 			break;
 	}
@@ -263,23 +671,23 @@ bool QASTCHandler::supportsOption(QImageIOHandler::ImageOption option) const
 		case Quality:
 		case SubType:
 		case SupportedSubTypes:
-			return true;
-
 		case ClipRect:
+		case ScaledSize:
+		case IncrementalReading:
+		case ImageFormat:
+		case ImageTransformation:
+		case ProgressiveScanWrite:
+		case OptimizedWrite:
 		case Description:
+			return true;
+
 		case ScaledClipRect:
-		case ScaledSize:
 		case CompressionRatio:
 		case Gamma:
 		case Name:
-		case IncrementalReading:
 		case Endianness:
 		case Animation:
 		case BackgroundColor:
-		case ImageFormat:
-		case OptimizedWrite:
-		case ProgressiveScanWrite:
-		case ImageTransformation:
 		case TransformedByDefault:
 			break;
 	}
@@ -287,9 +695,107 @@ bool QASTCHandler::supportsOption(QImageIOHandler::ImageOption option) const
 	return false;
 }
 
-void QASTCHandler::QImageTextureCleanup(void *ptr)
+bool QASTCHandler::isBottomUp() const
+{
+	// Rows are stored bottom-up as OpenGL expects them, the flip stores
+	// them top-down
+	return !mTransformation.testFlag(TransformationFlip);
+}
+
+bool QASTCHandler::skipBytes(QIODevice *device, qint64 size)
 {
-	delete reinterpret_cast<CCodecBuffer *>(ptr);
+	if (size <= 0)
+		return true;
+
+	if (!device->isSequential())
+		return device->seek(device->pos() + size);
+
+	char buffer[4096];
+	while (size > 0)
+	{
+		qint64 chunk = std::min<qint64>(size, sizeof(buffer));
+		if (device->read(buffer, chunk) != chunk)
+			return false;
+
+		size -= chunk;
+	}
+
+	return true;
+}
+
+QImage::Format QASTCHandler::peekImageFormat() const
+{
+	if (mImageFormat != QImage::Format_Invalid)
+		return mImageFormat;
+
+	// Blocks follow the header the device is at
+	Header header;
+	if (!header.peekFrom(device()))
+		return QImage::Format_Invalid;
+
+	return scanImageFormat(header, qint64(sizeof(astc_header)));
+}
+
+QImage::Format QASTCHandler::scanImageFormat(
+	const Header &header, qint64 offset) const
+{
+	ASTCTraceScope trace("QASTCHandler::scanImageFormat", "io");
+	auto device = this->device();
+
+	// Files are scanned in the mapped pages
+	auto file = qobject_cast<QFileDevice *>(device);
+	if (file && !file->isSequential())
+	{
+		uchar *mapped = file->map(file->pos() + offset, header.dataSize());
+		if (mapped)
+		{
+			CCodec_ASTC codec;
+			QScopedPointer<CCodecBuffer> buffer(
+				codec.CreateBuffer(header.xdim, header.ydim, header.zdim,
+					header.xsize, header.ysize, 0, mapped, header.zsize));
+			QImage::Format result = autoImageFormat(*buffer);
+			buffer.reset();
+			file->unmap(mapped);
+			return result;
+		}
+	}
+
+	// Other devices are read one block row at a time and rolled back,
+	// until the traits leave a single choice
+	CCodec_ASTC codec;
+	QScopedPointer<CCodecBuffer> row(
+		codec.CreateBuffer(header.xdim, header.ydim, header.zdim,
+			header.xsize, header.ydim, 0, nullptr, header.zdim));
+	qint64 rowSize = row->GetDataSize();
+	qint64 rowCount = header.dataSize() / rowSize;
+
+	bool opaque = true;
+	bool grayscale = true;
+	bool complete = false;
+	device->startTransaction();
+	if (skipBytes(device, offset))
+	{
+		qint64 i = 0;
+		for (; i < rowCount && (opaque || grayscale); i++)
+		{
+			if (device->read(reinterpret_cast<char *>(row->GetData()),
+					rowSize) != rowSize)
+			{
+				break;
+			}
+
+			bool rowOpaque;
+			bool rowGrayscale;
+			CCodec_ASTC::scanBlockTraits(*row, rowOpaque, rowGrayscale);
+			opaque = opaque && rowOpaque;
+			grayscale = grayscale && rowGrayscale;
+		}
+		complete = i == rowCount || (!opaque && !grayscale);
+	}
+	device->rollbackTransaction();
+
+	return complete ? autoImageFormat(opaque, grayscale)
+					: QImage::Format_Invalid;
 }
 
 bool QASTCHandler::Header::readFrom(const astc_header &other)
@@ -304,7 +810,9 @@ bool QASTCHandler::Header::readFrom(const astc_header &other)
 	int ysize = other.ysize[0] + 256 * other.ysize[1] + 65536 * other.ysize[2];
 	int zsize = other.zsize[0] + 256 * other.zsize[1] + 65536 * other.zsize[2];
 
-	if (xsize <= 0 || ysize <= 0 || zsize != 1)
+	// Volume slices must fit in a single image
+	if (xsize <= 0 || ysize <= 0 || zsize <= 0 ||
+		qint64(ysize) * zsize > std::numeric_limits<int>::max())
 	{
 		return false;
 	}
@@ -344,9 +852,44 @@ bool QASTCHandler::Header::peekFrom(QIODevice *device)
 	return ok;
 }
 
-QByteArray QASTCHandler::Header::toSubType() const
+bool QASTCHandler::Header::writeTo(QIODevice *device) const
 {
-	return QByteArray::number(xdim) + "x" + QByteArray::number(ydim);
+	astc_header header;
+	header.magic[0] = quint8(MAGIC_FILE_CONSTANT);
+	header.magic[1] = quint8(MAGIC_FILE_CONSTANT >> 8);
+	header.magic[2] = quint8(MAGIC_FILE_CONSTANT >> 16);
+	header.magic[3] = quint8(MAGIC_FILE_CONSTANT >> 24);
+	header.blockdim_x = xdim;
+	header.blockdim_y = ydim;
+	header.blockdim_z = zdim;
+	header.xsize[0] = quint8(xsize);
+	header.xsize[1] = quint8(xsize >> 8);
+	header.xsize[2] = quint8(xsize >> 16);
+	header.ysize[0] = quint8(ysize);
+	header.ysize[1] = quint8(ysize >> 8);
+	header.ysize[2] = quint8(ysize >> 16);
+	header.zsize[0] = quint8(zsize);
+	header.zsize[1] = quint8(zsize >> 8);
+	header.zsize[2] = quint8(zsize >> 16);
+
+	return device->write(reinterpret_cast<char *>(&header), sizeof(header)) ==
+		sizeof(header);
+}
+
+QSize QASTCHandler::Header::imageSize() const
+{
+	return QSize(xsize, ysize * zsize);
+}
+
+qint64 QASTCHandler::Header::dataSize() const
+{
+	return qint64((xsize + xdim - 1) / xdim) * ((ysize + ydim - 1) / ydim) *
+		((zsize + zdim - 1) / zdim) * ASTC_COMPRESSED_BLOCK_SIZE;
+}
+
+QByteArray QASTCHandler::Header::toSubType(bool srgb) const
+{
+	return QASTCFormats::toSubType(xdim, ydim, zdim, srgb);
 }
 
 const QByteArrayList &QASTCHandler::Header::validSubTypes()
@@ -355,10 +898,18 @@ const QByteArrayList &QASTCHandler::Header::validSubTypes()
 
 	if (result.isEmpty())
 	{
-		for (auto &size : ASTC_VALID_BLOCK_SIZE)
+		for (bool srgb : { false, true })
 		{
-			result.append(
-				QByteArray::number(size.w) + "x" + QByteArray::number(size.h));
+			for (auto &size : ASTC_VALID_BLOCK_SIZE)
+			{
+				result.append(
+					QASTCFormats::toSubType(size.w, size.h, 1, srgb));
+			}
+			for (auto &size : ASTC_VALID_BLOCK_SIZE_3D)
+			{
+				result.append(QASTCFormats::toSubType(
+					size.w, size.h, size.d, srgb));
+			}
 		}
 	}
 
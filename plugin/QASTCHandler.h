@@ -1,6 +1,8 @@
 ﻿#pragma once
 
+#include <QImage>
 #include <QImageIOHandler>
+#include <QRect>
 
 class QASTCHandler : public QImageIOHandler
 {
@@ -8,6 +10,15 @@ class QASTCHandler : public QImageIOHandler
 	int mQuality;
 	quint8 mBlockWidth;
 	quint8 mBlockHeight;
+	quint8 mBlockDepth;
+	QRect mClipRect;
+	QSize mScaledSize;
+	QImage::Format mImageFormat;
+	Transformations mTransformation;
+	bool mProgressiveScanWrite;
+	bool mOptimizedWrite;
+	int mSliceCount;
+	bool mSRGB;
 
 public:
 	QASTCHandler();
@@ -25,5 +36,12 @@ public:
 	virtual bool supportsOption(ImageOption option) const override;
 
 private:
-	static void QImageTextureCleanup(void *ptr);
+	bool readBlockRows(
+		const Header &header, QImage::Format format, QImage *image);
+	bool readVolume(
+		const Header &header, QImage::Format format, QImage *image);
+	QImage::Format peekImageFormat() const;
+	QImage::Format scanImageFormat(const Header &header, qint64 offset) const;
+	bool isBottomUp() const;
+	static bool skipBytes(QIODevice *device, qint64 size);
 };
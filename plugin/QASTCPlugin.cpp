@@ -1,11 +1,34 @@
 #include "QASTCPlugin.h"
 
 #include "QASTCHandler.h"
+#include "QKTX2Handler.h"
+
+#include "ASTC/ASTC_Trace.h"
+
+// The trace QASTC_TRACE asks for lasts as long as the plugin is loaded
+QASTCPlugin::QASTCPlugin()
+	: mTracing(false)
+{
+	const char *path = ASTCTrace::environmentPath();
+	if (path)
+	{
+		mTracing = ASTCTrace::start(path);
+		if (!mTracing)
+			qWarning("Cannot write trace to %s", path);
+	}
+}
+
+QASTCPlugin::~QASTCPlugin()
+{
+	if (mTracing && !ASTCTrace::stop())
+		qWarning("Cannot write trace to %s", ASTCTrace::environmentPath());
+}
 
 QImageIOPlugin::Capabilities QASTCPlugin::capabilities(
 	QIODevice *device, const QByteArray &format) const
 {
-	if (format == QASTCHandler::ASTC_Format())
+	if (format == QASTCHandler::ASTC_Format() ||
+		format == QKTX2Handler::KTX2_Format())
 	{
 		return Capabilities(CanRead | CanWrite);
 	}
@@ -18,7 +41,8 @@ QImageIOPlugin::Capabilities QASTCPlugin::capabilities(
 
 	Capabilities result;
 
-	if (QASTCHandler::validateHeader(device))
+	if (QASTCHandler::validateHeader(device) ||
+		QKTX2Handler::validateHeader(device))
 	{
 		result |= CanRead;
 	}
@@ -34,10 +58,20 @@ QImageIOPlugin::Capabilities QASTCPlugin::capabilities(
 QImageIOHandler *QASTCPlugin::create(
 	QIODevice *device, const QByteArray &format) const
 {
-	auto handler = new QASTCHandler;
+	// KTX2 files are recognized by their contents unless a format is given
+	QImageIOHandler *handler;
+	if (format == QKTX2Handler::KTX2_Format() ||
+		(format.isEmpty() && QKTX2Handler::validateHeader(device)))
+	{
+		handler = new QKTX2Handler;
+		handler->setFormat(QKTX2Handler::KTX2_Format());
+	} else
+	{
+		handler = new QASTCHandler;
+		if (!format.isEmpty())
+			handler->setFormat(format);
+	}
 	handler->setDevice(device);
-	if (!format.isEmpty())
-		handler->setFormat(format);
 
 	return handler;
 }
@@ -8,7 +8,12 @@ class QASTCPlugin : public QImageIOPlugin
 	Q_PLUGIN_METADATA(IID
 		"org.qt-project.Qt.QImageIOHandlerFactoryInterface" FILE "astc.json")
 
+	bool mTracing;
+
 public:
+	QASTCPlugin();
+	virtual ~QASTCPlugin() override;
+
 	virtual Capabilities capabilities(
 		QIODevice *device, const QByteArray &format) const override;
 
@@ -0,0 +1,1028 @@
+#include "QKTX2Handler.h"
+#include "QASTCFormats.h"
+
+#include "ASTC/ASTC_Trace.h"
+#include "ASTC/Codec_ASTC.h"
+
+#include <QBuffer>
+#include <QFileDevice>
+#include <QMap>
+#include <QVariant>
+#include <QVector>
+#include <QtEndian>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+#include <QColorSpace>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace QASTCFormats;
+
+static const char KTX2_IDENTIFIER[12] = { '\xAB', 'K', 'T', 'X', ' ', '2',
+	'0', '\xBB', '\r', '\n', '\x1A', '\n' };
+
+enum
+{
+	KTX2_HEADER_SIZE = 80,
+	KTX2_LEVEL_INDEX_ENTRY_SIZE = 24,
+	// Least common multiple of the block size and 4
+	KTX2_LEVEL_ALIGNMENT = 16,
+	// Basic data format descriptor with a single sample
+	KTX2_DFD_BLOCK_SIZE = 40,
+	// Larger key/value data is not loaded
+	KTX2_MAX_KVD_SIZE = 1 << 20,
+};
+
+// Vulkan formats of 2D ASTC blocks, in the order of their values. Each
+// UNORM format is followed by its SRGB one.
+static const astc_block_size_t KTX2_BLOCK_SIZES[] = {
+	{ 4, 4 }, //
+	{ 5, 4 }, //
+	{ 5, 5 }, //
+	{ 6, 5 }, //
+	{ 6, 6 }, //
+	{ 8, 5 }, //
+	{ 8, 6 }, //
+	{ 8, 8 }, //
+	{ 10, 5 }, //
+	{ 10, 6 }, //
+	{ 10, 8 }, //
+	{ 10, 10 }, //
+	{ 12, 10 }, //
+	{ 12, 12 }, //
+};
+static const int KTX2_BLOCK_SIZE_COUNT =
+	int(sizeof(KTX2_BLOCK_SIZES) / sizeof(KTX2_BLOCK_SIZES[0]));
+static const quint32 VK_FORMAT_ASTC_4x4_UNORM_BLOCK = 157;
+static const quint32 VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK = 1000066000;
+
+// Data format descriptor values
+static const quint32 KHR_DF_MODEL_ASTC = 162;
+static const quint32 KHR_DF_PRIMARIES_BT709 = 1;
+static const quint32 KHR_DF_TRANSFER_LINEAR = 1;
+static const quint32 KHR_DF_TRANSFER_SRGB = 2;
+static const quint32 KHR_DF_SAMPLE_DATATYPE_SIGNED = 0x40;
+static const quint32 KHR_DF_SAMPLE_DATATYPE_FLOAT = 0x80;
+
+static const char KTX_ORIENTATION_KEY[] = "KTXorientation";
+static const char KTX_WRITER_KEY[] = "KTXwriter";
+// Texts of the writer that shape the texture, not stored in it
+static const char LAYERS_KEY[] = "Layers";
+static const char LEVELS_KEY[] = "Levels";
+
+struct QKTX2Handler::Header
+{
+	struct Level
+	{
+		quint64 byteOffset;
+		quint64 byteLength;
+	};
+
+	quint32 vkFormat;
+	quint8 xdim;
+	quint8 ydim;
+	bool srgb;
+	bool hdr;
+	int width;
+	int height;
+	int layerCount; // 1 for a single texture
+	int faceCount;
+	QVector<Level> levels;
+	// Values without their terminating NUL
+	QMap<QByteArray, QByteArray> keyValues;
+
+	bool setFormat(quint32 vkFormat);
+	void setFormat(int xdim, int ydim, bool srgb, bool hdr);
+
+	bool readFrom(QIODevice *device);
+	// Places the levels smallest first, as KTX2 stores them, and returns
+	// the file contents before the level data
+	QByteArray layOut();
+
+	int imagesPerLevel() const;
+	int imageCount() const;
+	QSize levelSize(int level) const;
+	qint64 imageByteLength(int level) const;
+	qint64 fileSize() const;
+	// Rows go up when KTXorientation says so
+	bool flipped() const;
+	QString description() const;
+
+	static const QByteArrayList &validSubTypes();
+};
+
+static quint32 readU32(const char *p)
+{
+	return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(p));
+}
+
+static quint64 readU64(const char *p)
+{
+	return qFromLittleEndian<quint64>(reinterpret_cast<const uchar *>(p));
+}
+
+static void appendU32(QByteArray &out, quint32 value)
+{
+	uchar bytes[4];
+	qToLittleEndian(value, bytes);
+	out.append(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+}
+
+static void appendU64(QByteArray &out, quint64 value)
+{
+	uchar bytes[8];
+	qToLittleEndian(value, bytes);
+	out.append(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+}
+
+static quint64 alignUp(quint64 value, quint64 alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Count given by the key in the texts of the writer, else in the image
+// texts. 0 when neither has it.
+static int countText(
+	const QString &description, const QImage &image, const char *key)
+{
+	for (auto &pair : description.split(QStringLiteral("\n\n")))
+	{
+		int index = pair.indexOf(QStringLiteral(": "));
+		if (index > 0 && pair.left(index) == QLatin1String(key))
+			return std::max(pair.mid(index + 2).toInt(), 1);
+	}
+
+	QString text = image.text(QLatin1String(key));
+	return text.isEmpty() ? 0 : std::max(text.toInt(), 1);
+}
+
+// Format picked by the codec when none is set
+static QImage::Format defaultImageFormat(bool hdr, CCodecBuffer &buffer)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+	// HDR blocks keep values above 1.0 in half floats
+	if (hdr)
+		return QImage::Format_RGBA16FPx4;
+#else
+	Q_UNUSED(hdr);
+#endif
+	return autoImageFormat(buffer);
+}
+
+QKTX2Handler::QKTX2Handler()
+	: mStart(0)
+	, mHeaderRead(false)
+	, mImageIndex(0)
+	, mQuality(-1)
+	, mBlockWidth(4)
+	, mBlockHeight(4)
+	, mImageFormat(QImage::Format_Invalid)
+	, mTransformation(TransformationNone)
+	, mOptimizedWrite(false)
+	, mSRGB(false)
+{
+}
+
+QKTX2Handler::~QKTX2Handler()
+{
+}
+
+QByteArray QKTX2Handler::KTX2_Format()
+{
+	return QByteArrayLiteral("ktx2");
+}
+
+bool QKTX2Handler::validateHeader(QIODevice *device)
+{
+	if (!device || !device->isReadable())
+		return false;
+
+	char identifier[sizeof(KTX2_IDENTIFIER)];
+	return device->peek(identifier, sizeof(identifier)) ==
+		sizeof(identifier) &&
+		memcmp(identifier, KTX2_IDENTIFIER, sizeof(identifier)) == 0;
+}
+
+bool QKTX2Handler::canRead() const
+{
+	if (validateHeader(device()))
+	{
+		setFormat(KTX2_Format());
+		return true;
+	}
+	return false;
+}
+
+bool QKTX2Handler::read(QImage *image)
+{
+	ASTCTraceScope trace("QKTX2Handler::read", "io");
+	auto header = this->header();
+	if (!header || mImageIndex >= header->imageCount())
+		return false;
+
+	QSize levelSize =
+		header->levelSize(mImageIndex / header->imagesPerLevel());
+
+	QRect rect(QPoint(0, 0), levelSize);
+	if (mClipRect.isValid())
+	{
+		rect &= mClipRect;
+		if (rect.isEmpty())
+			return false;
+	}
+
+	bool scaled = mScaledSize.isValid() && !mScaledSize.isEmpty() &&
+		mScaledSize != rect.size();
+
+	QByteArray storage;
+	uchar *mapped;
+	auto data = imageData(mImageIndex, storage, &mapped);
+	if (!data)
+		return false;
+
+	CCodec_ASTC codec;
+	codec.setSRGB(header->srgb);
+	// Bottom-up images are turned upright by the decoder
+	codec.setFlipY(header->flipped());
+
+	QScopedPointer<CCodecBuffer> srcCodecBuffer(
+		codec.CreateBuffer(header->xdim, header->ydim, 1, levelSize.width(),
+			levelSize.height(), 0, const_cast<uchar *>(data)));
+
+	QImage::Format format = mImageFormat;
+	if (format == QImage::Format_Invalid)
+		format = defaultImageFormat(header->hdr, *srcCodecBuffer);
+
+	CodecBufferType bufferType;
+	ASTCTexelFormat texelFormat;
+	toTargetFormat(format, &bufferType, &texelFormat);
+	codec.setTexelFormat(texelFormat);
+
+	QSize size = rect.size();
+	// Half float images are decoded at full size by whole blocks
+	bool halfFloat = bufferType == CBT_RGBA16F;
+	bool downscale = !halfFloat && scaled &&
+		mScaledSize.width() <= size.width() &&
+		mScaledSize.height() <= size.height();
+	if (downscale)
+		size = mScaledSize;
+
+	// Offsets given to the decoder count from the bottom when flipped
+	int y = header->flipped() ? levelSize.height() - rect.bottom() - 1
+							  : rect.y();
+
+	QImage result(size, format);
+	CodecError error = CE_Unknown;
+	if (!result.isNull())
+	{
+		QScopedPointer<CCodecBuffer> dstCodecBuffer(
+			CreateCodecBuffer(bufferType, 0, 0, 0, size.width(),
+				size.height(), result.bytesPerLine(), result.bits()));
+
+		error = downscale
+			? codec.DecompressScaled(*srcCodecBuffer, *dstCodecBuffer,
+				  rect.x(), y, rect.width(), rect.height())
+			: codec.Decompress(*srcCodecBuffer, *dstCodecBuffer, rect.x(), y);
+	}
+
+	if (mapped)
+	{
+		srcCodecBuffer.reset();
+		unmapImageData(mapped);
+	}
+
+	if (error != CE_OK)
+	{
+		return false;
+	}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+	// Half float colors of sRGB blocks are decoded to linear
+	if (halfFloat && header->srgb)
+		result.setColorSpace(QColorSpace::SRgbLinear);
+#endif
+
+	if (scaled && mScaledSize != size)
+	{
+		result = result.scaled(
+			mScaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+
+	for (auto it = header->keyValues.begin(); it != header->keyValues.end();
+		 ++it)
+	{
+		result.setText(QString::fromUtf8(it.key()), QString::fromUtf8(*it));
+	}
+
+	*image = result;
+	return true;
+}
+
+bool QKTX2Handler::write(const QImage &image)
+{
+	ASTCTraceScope trace("QKTX2Handler::write", "io");
+	auto device = this->device();
+	if (!device || !device->isWritable())
+		return false;
+
+	CCodec_ASTC codec;
+	if (mQuality >= 0)
+	{
+		codec.setQuality(mQuality / 100.0);
+	}
+	codec.setSRGB(mSRGB);
+	// Optimized writes spend no bits on the color of invisible texels
+	codec.setIgnoreTransparentRGB(mOptimizedWrite);
+	// Every level is stored bottom-up, as KTXorientation tells
+	bool flip = mTransformation.testFlag(TransformationFlip);
+	codec.setFlipY(flip);
+
+	auto img = image;
+	CodecBufferType bufferType;
+	ASTCTexelFormat texelFormat;
+	if (!toSourceFormat(img, &bufferType, &texelFormat))
+	{
+		img = img.convertToFormat(QImage::Format_ARGB32);
+		texelFormat = ASTC_TEXEL_ARGB32;
+	}
+	codec.setTexelFormat(texelFormat);
+
+	// The Layers text tells how many array layers are stacked top to
+	// bottom in the image, the Levels text limits the mip chain. Cube
+	// maps are only read.
+	int layerCount = std::max(countText(mDescription, img, LAYERS_KEY), 1);
+	if (img.height() % layerCount != 0)
+		return false;
+
+	// Half float colors are encoded as HDR blocks unless in the sRGB mode
+	Header header;
+	header.setFormat(
+		mBlockWidth, mBlockHeight, mSRGB, bufferType == CBT_RGBA16F && !mSRGB);
+	header.width = img.width();
+	header.height = img.height() / layerCount;
+	header.layerCount = layerCount;
+	header.faceCount = 1;
+	int levelCount = int(
+		ASTCMipmapResampler::levelCount(header.width, header.height));
+	int levelLimit = countText(mDescription, img, LEVELS_KEY);
+	header.levels.resize(
+		levelLimit > 0 ? std::min(levelLimit, levelCount) : levelCount);
+
+	// Other texts set on the writer and the image go to the key/value data
+	auto insertText = [&header](const QString &key, const QString &value) {
+		if (key != QLatin1String(LAYERS_KEY) &&
+			key != QLatin1String(LEVELS_KEY))
+		{
+			header.keyValues.insert(key.toUtf8(), value.toUtf8());
+		}
+	};
+	for (auto &pair : mDescription.split(QStringLiteral("\n\n")))
+	{
+		int index = pair.indexOf(QStringLiteral(": "));
+		if (index > 0)
+			insertText(pair.left(index), pair.mid(index + 2));
+	}
+	for (auto &key : img.textKeys())
+	{
+		insertText(key, img.text(key));
+	}
+	header.keyValues.insert(KTX_ORIENTATION_KEY, flip ? "ru" : "rd");
+	header.keyValues.insert(KTX_WRITER_KEY, "qastc");
+
+	QByteArray head = header.layOut();
+	qint64 start = device->pos();
+	if (device->write(head) != head.size())
+		return false;
+
+	// Levels are encoded largest first and stored smallest first, the
+	// layers of a level one after another. Devices that can seek receive
+	// each level as soon as it is encoded, the others once all of them
+	// are.
+	bool seekable = !device->isSequential();
+	QVector<QByteArray> pending(seekable ? 0 : header.levels.size());
+	int layer = 0;
+	auto writer = [&](CMP_DWORD nLevel, CMP_DWORD, CMP_DWORD,
+					  const CMP_BYTE *pData, CMP_DWORD dwSize) {
+		auto data = reinterpret_cast<const char *>(pData);
+		if (!seekable)
+		{
+			pending[int(nLevel)].append(data, int(dwSize));
+			return true;
+		}
+
+		qint64 offset = qint64(header.levels.at(int(nLevel)).byteOffset) +
+			layer * header.imageByteLength(int(nLevel));
+		return device->seek(start + offset) &&
+			device->write(data, dwSize) == qint64(dwSize);
+	};
+
+	// Levels are filtered in linear light for sRGB blocks only, as the
+	// texels are read by the GPU
+	for (; layer < layerCount; layer++)
+	{
+		QScopedPointer<CCodecBuffer> srcCodecBuffer(CreateCodecBuffer(
+			bufferType, 0, 0, 0, header.width, header.height,
+			img.bytesPerLine(),
+			const_cast<uchar *>(img.constScanLine(layer * header.height))));
+
+		if (codec.CompressMipmaps(*srcCodecBuffer, mBlockWidth, mBlockHeight,
+				ASTC_MIPMAP_BOX, mSRGB, writer,
+				CMP_DWORD(header.levels.size())) != CE_OK)
+		{
+			return false;
+		}
+	}
+
+	if (seekable)
+		return device->seek(start + header.fileSize());
+
+	// Level data is contiguous, as every level size is aligned already
+	for (int level = pending.size() - 1; level >= 0; level--)
+	{
+		if (device->write(pending.at(level)) != pending.at(level).size())
+			return false;
+	}
+
+	return true;
+}
+
+int QKTX2Handler::imageCount() const
+{
+	auto header = this->header();
+	return header ? header->imageCount() : 0;
+}
+
+bool QKTX2Handler::jumpToImage(int imageNumber)
+{
+	if (imageNumber < 0 || imageNumber >= imageCount())
+		return false;
+
+	mImageIndex = imageNumber;
+	return true;
+}
+
+bool QKTX2Handler::jumpToNextImage()
+{
+	return jumpToImage(mImageIndex + 1);
+}
+
+int QKTX2Handler::currentImageNumber() const
+{
+	return mImageIndex;
+}
+
+QVariant QKTX2Handler::option(ImageOption option) const
+{
+	switch (option)
+	{
+		case Size:
+		{
+			auto header = this->header();
+			if (header && mImageIndex < header->imageCount())
+				return header->levelSize(
+					mImageIndex / header->imagesPerLevel());
+			break;
+		}
+
+		case SubType:
+		{
+			auto header = this->header();
+			if (header)
+				return toSubType(header->xdim, header->ydim, 1, header->srgb);
+			break;
+		}
+
+		case Quality:
+			return mQuality;
+
+		case SupportedSubTypes:
+			return QVariant::fromValue(Header::validSubTypes());
+
+		case ClipRect:
+			return mClipRect;
+
+		case ScaledSize:
+			return mScaledSize;
+
+		case ImageFormat:
+		{
+			if (mImageFormat != QImage::Format_Invalid)
+				return mImageFormat;
+
+			auto header = this->header();
+			if (!header || mImageIndex >= header->imageCount())
+				break;
+
+			QByteArray storage;
+			uchar *mapped;
+			auto data = imageData(mImageIndex, storage, &mapped);
+			if (!data)
+				break;
+
+			QSize size =
+				header->levelSize(mImageIndex / header->imagesPerLevel());
+			CCodec_ASTC codec;
+			QScopedPointer<CCodecBuffer> buffer(
+				codec.CreateBuffer(header->xdim, header->ydim, 1,
+					size.width(), size.height(), 0, const_cast<uchar *>(data)));
+			QImage::Format result = defaultImageFormat(header->hdr, *buffer);
+
+			if (mapped)
+			{
+				buffer.reset();
+				unmapImageData(mapped);
+			}
+			return result;
+		}
+
+		case ImageTransformation:
+			return int(mTransformation);
+
+		case OptimizedWrite:
+			return mOptimizedWrite;
+
+		case Description:
+		{
+			auto header = this->header();
+			if (header)
+				return header->description();
+			break;
+		}
+
+		case ScaledClipRect:
+		case CompressionRatio:
+		case Gamma:
+		case Name:
+		case IncrementalReading:
+		case Endianness:
+		case Animation:
+		case BackgroundColor:
+		case ProgressiveScanWrite:
+		case TransformedByDefault:
+			break;
+	}
+
+	return QVariant();
+}
+
+void QKTX2Handler::setOption(ImageOption option, const QVariant &value)
+{
+	switch (option)
+	{
+		case Quality:
+		{
+			bool ok;
+			int q = value.toInt(&ok);
+			mQuality = ok ? q : -1;
+			break;
+		}
+
+		case SubType:
+		{
+			int w;
+			int h;
+			int d;
+			bool srgb;
+			if (fromSubType(value.toByteArray(), &w, &h, &d, &srgb) && d == 1)
+			{
+				mBlockWidth = quint8(w);
+				mBlockHeight = quint8(h);
+				mSRGB = srgb;
+			}
+			break;
+		}
+
+		case ClipRect:
+			mClipRect = value.toRect();
+			break;
+
+		case ScaledSize:
+			mScaledSize = value.toSize();
+			break;
+
+		case ImageTransformation:
+			// Only a vertical flip is done while encoding
+			mTransformation = Transformations(value.toInt()) &
+				TransformationFlip;
+			break;
+
+		case ImageFormat:
+		{
+			// Other formats fall back to the automatic choice
+			auto format = QImage::Format(value.toInt());
+			CodecBufferType bufferType;
+			ASTCTexelFormat texelFormat;
+			mImageFormat = toTargetFormat(format, &bufferType, &texelFormat)
+				? format
+				: QImage::Format_Invalid;
+			break;
+		}
+
+		case Description:
+			mDescription = value.toString();
+			break;
+
+		case OptimizedWrite:
+			mOptimizedWrite = value.toBool();
+			break;
+
+		case Size:
+		case SupportedSubTypes:
+		case ScaledClipRect:
+		case CompressionRatio:
+		case Gamma:
+		case Name:
+		case IncrementalReading:
+		case Endianness:
+		case Animation:
+		case BackgroundColor:
+		case ProgressiveScanWrite:
+		case TransformedByDefault:
+			break;
+	}
+}
+
+bool QKTX2Handler::supportsOption(ImageOption option) const
+{
+	switch (option)
+	{
+		case Size:
+		case Quality:
+		case SubType:
+		case SupportedSubTypes:
+		case ClipRect:
+		case ScaledSize:
+		case ImageFormat:
+		case ImageTransformation:
+		case Description:
+		case OptimizedWrite:
+			return true;
+
+		case ScaledClipRect:
+		case CompressionRatio:
+		case Gamma:
+		case Name:
+		case IncrementalReading:
+		case Endianness:
+		case Animation:
+		case BackgroundColor:
+		case ProgressiveScanWrite:
+		case TransformedByDefault:
+			break;
+	}
+
+	return false;
+}
+
+const QKTX2Handler::Header *QKTX2Handler::header() const
+{
+	if (mHeaderRead)
+		return mHeader.data();
+
+	auto device = this->device();
+	if (!validateHeader(device))
+		return nullptr;
+
+	mHeaderRead = true;
+	QScopedPointer<Header> header(new Header);
+	bool ok;
+	if (device->isSequential())
+	{
+		// Levels are stored smallest first, the whole file is needed
+		mStart = 0;
+		mData = device->readAll();
+		QBuffer buffer(&mData);
+		ok = buffer.open(QIODevice::ReadOnly) && header->readFrom(&buffer);
+	} else
+	{
+		// The device stays at the start of the file
+		mStart = device->pos();
+		ok = header->readFrom(device);
+		device->seek(mStart);
+	}
+
+	if (ok)
+		mHeader.reset(header.take());
+
+	return mHeader.data();
+}
+
+const uchar *QKTX2Handler::imageData(
+	int index, QByteArray &storage, uchar **mapped) const
+{
+	*mapped = nullptr;
+
+	auto header = mHeader.data();
+	int level = index / header->imagesPerLevel();
+	qint64 length = header->imageByteLength(level);
+	qint64 offset = qint64(header->levels.at(level).byteOffset) +
+		(index % header->imagesPerLevel()) * length;
+
+	if (device()->isSequential())
+	{
+		if (offset + length > mData.size())
+			return nullptr;
+
+		return reinterpret_cast<const uchar *>(mData.constData()) + offset;
+	}
+
+	// Files are decoded straight from the mapped pages
+	auto file = qobject_cast<QFileDevice *>(device());
+	if (file)
+	{
+		*mapped = file->map(mStart + offset, length);
+		if (*mapped)
+			return *mapped;
+	}
+
+	storage.resize(int(length));
+	bool ok = device()->seek(mStart + offset) &&
+		device()->read(storage.data(), length) == length;
+	device()->seek(mStart);
+	return ok ? reinterpret_cast<const uchar *>(storage.constData()) : nullptr;
+}
+
+void QKTX2Handler::unmapImageData(uchar *mapped) const
+{
+	qobject_cast<QFileDevice *>(device())->unmap(mapped);
+}
+
+bool QKTX2Handler::Header::setFormat(quint32 vkFormat)
+{
+	for (int i = 0; i < KTX2_BLOCK_SIZE_COUNT; i++)
+	{
+		quint32 unorm = VK_FORMAT_ASTC_4x4_UNORM_BLOCK + 2 * i;
+		quint32 sfloat = VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK + i;
+		if (vkFormat == unorm || vkFormat == unorm + 1 || vkFormat == sfloat)
+		{
+			this->vkFormat = vkFormat;
+			xdim = KTX2_BLOCK_SIZES[i].w;
+			ydim = KTX2_BLOCK_SIZES[i].h;
+			srgb = vkFormat == unorm + 1;
+			hdr = vkFormat == sfloat;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void QKTX2Handler::Header::setFormat(int xdim, int ydim, bool srgb, bool hdr)
+{
+	for (int i = 0; i < KTX2_BLOCK_SIZE_COUNT; i++)
+	{
+		if (xdim == KTX2_BLOCK_SIZES[i].w && ydim == KTX2_BLOCK_SIZES[i].h)
+		{
+			setFormat(hdr ? VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK + i
+						  : VK_FORMAT_ASTC_4x4_UNORM_BLOCK + 2 * i +
+						(srgb ? 1 : 0));
+			return;
+		}
+	}
+
+	Q_UNREACHABLE();
+}
+
+bool QKTX2Handler::Header::readFrom(QIODevice *device)
+{
+	qint64 start = device->pos();
+	QByteArray head = device->read(KTX2_HEADER_SIZE);
+	if (head.size() != KTX2_HEADER_SIZE ||
+		memcmp(head.constData(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) !=
+			0)
+	{
+		return false;
+	}
+
+	const char *p = head.constData() + sizeof(KTX2_IDENTIFIER);
+	quint32 format = readU32(p);
+	quint32 typeSize = readU32(p + 4);
+	quint32 pixelWidth = readU32(p + 8);
+	quint32 pixelHeight = readU32(p + 12);
+	quint32 pixelDepth = readU32(p + 16);
+	quint32 layers = readU32(p + 20);
+	quint32 faces = readU32(p + 24);
+	quint32 levelCount = readU32(p + 28);
+	quint32 supercompression = readU32(p + 32);
+	quint32 kvdByteOffset = readU32(p + 44);
+	quint32 kvdByteLength = readU32(p + 48);
+
+	// 2D textures and arrays only, without supercompression
+	const quint32 maxSize = quint32(std::numeric_limits<int>::max());
+	if (!setFormat(format) || typeSize != 1 || pixelWidth == 0 ||
+		pixelHeight == 0 || pixelWidth > maxSize || pixelHeight > maxSize ||
+		pixelDepth != 0 || (faces != 1 && faces != 6) ||
+		supercompression != 0)
+	{
+		return false;
+	}
+
+	width = int(pixelWidth);
+	height = int(pixelHeight);
+	layerCount = int(std::max<quint32>(layers, 1));
+	faceCount = int(faces);
+
+	// No level count asks for mipmaps made at load time, there is only one
+	levelCount = std::max<quint32>(levelCount, 1);
+	if (levelCount > ASTCMipmapResampler::levelCount(pixelWidth, pixelHeight) ||
+		quint64(layerCount) * faceCount * levelCount > maxSize)
+	{
+		return false;
+	}
+
+	QByteArray index = device->read(levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE);
+	if (index.size() != int(levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE))
+		return false;
+
+	levels.resize(int(levelCount));
+	for (int level = 0; level < levels.size(); level++)
+	{
+		const char *entry =
+			index.constData() + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		Level &info = levels[level];
+		info.byteOffset = readU64(entry);
+		info.byteLength = readU64(entry + 8);
+		if (info.byteLength != quint64(imageByteLength(level)) *
+				imagesPerLevel() ||
+			info.byteOffset >
+				quint64(std::numeric_limits<qint64>::max()) - info.byteLength)
+		{
+			return false;
+		}
+	}
+
+	keyValues.clear();
+	if (kvdByteLength == 0 || kvdByteLength > KTX2_MAX_KVD_SIZE)
+		return true;
+
+	QByteArray kvd;
+	if (!device->seek(start + kvdByteOffset) ||
+		(kvd = device->read(kvdByteLength)).size() != int(kvdByteLength))
+	{
+		return false;
+	}
+
+	for (int pos = 0; pos + 4 <= kvd.size();)
+	{
+		int length = int(readU32(kvd.constData() + pos));
+		pos += 4;
+		if (length > kvd.size() - pos)
+			break;
+
+		QByteArray keyAndValue = kvd.mid(pos, length);
+		int separator = keyAndValue.indexOf('\0');
+		if (separator > 0)
+		{
+			QByteArray value = keyAndValue.mid(separator + 1);
+			if (value.endsWith('\0'))
+				value.chop(1);
+			keyValues.insert(keyAndValue.left(separator), value);
+		}
+		pos += int(alignUp(quint64(length), 4));
+	}
+
+	return true;
+}
+
+QByteArray QKTX2Handler::Header::layOut()
+{
+	QByteArray dfd;
+	appendU32(dfd, 4 + KTX2_DFD_BLOCK_SIZE); // total size
+	appendU32(dfd, 0); // Khronos vendor, basic descriptor type
+	appendU32(dfd, 2 | (KTX2_DFD_BLOCK_SIZE << 16)); // version 2
+	appendU32(dfd,
+		KHR_DF_MODEL_ASTC | (KHR_DF_PRIMARIES_BT709 << 8) |
+			((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+	appendU32(dfd, quint32(xdim - 1) | (quint32(ydim - 1) << 8));
+	appendU32(dfd, ASTC_COMPRESSED_BLOCK_SIZE); // bytes in plane 0
+	appendU32(dfd, 0);
+	// A single sample covers the 128 bits of a block
+	quint32 dataType =
+		hdr ? KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED : 0;
+	appendU32(dfd, (127 << 16) | (dataType << 24));
+	appendU32(dfd, 0); // sample position
+	appendU32(dfd, hdr ? 0xBF800000 : 0); // -1.0f for float samples
+	appendU32(dfd, hdr ? 0x3F800000 : 0xFFFFFFFF); // 1.0f
+
+	// Keys are sorted, string values are stored with their NUL
+	QByteArray kvd;
+	for (auto it = keyValues.begin(); it != keyValues.end(); ++it)
+	{
+		QByteArray keyAndValue = it.key() + '\0' + *it + '\0';
+		appendU32(kvd, quint32(keyAndValue.size()));
+		kvd += keyAndValue;
+		kvd.append(int(alignUp(kvd.size(), 4)) - kvd.size(), '\0');
+	}
+
+	const int levelCount = levels.size();
+	quint32 dfdByteOffset =
+		KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+	quint32 kvdByteOffset = dfdByteOffset + dfd.size();
+	quint64 levelStart =
+		alignUp(kvdByteOffset + kvd.size(), KTX2_LEVEL_ALIGNMENT);
+
+	quint64 offset = levelStart;
+	for (int level = levelCount - 1; level >= 0; level--)
+	{
+		Level &info = levels[level];
+		info.byteOffset = alignUp(offset, KTX2_LEVEL_ALIGNMENT);
+		info.byteLength = quint64(imageByteLength(level)) * imagesPerLevel();
+		offset = info.byteOffset + info.byteLength;
+	}
+
+	QByteArray result(KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	appendU32(result, vkFormat);
+	appendU32(result, 1); // type size of block formats
+	appendU32(result, quint32(width));
+	appendU32(result, quint32(height));
+	appendU32(result, 0); // depth of 2D textures
+	appendU32(result, layerCount > 1 ? quint32(layerCount) : 0);
+	appendU32(result, quint32(faceCount));
+	appendU32(result, quint32(levelCount));
+	appendU32(result, 0); // no supercompression
+	appendU32(result, dfdByteOffset);
+	appendU32(result, quint32(dfd.size()));
+	appendU32(result, kvd.isEmpty() ? 0 : kvdByteOffset);
+	appendU32(result, quint32(kvd.size()));
+	appendU64(result, 0); // no supercompression global data
+	appendU64(result, 0);
+
+	for (auto &info : levels)
+	{
+		appendU64(result, info.byteOffset);
+		appendU64(result, info.byteLength);
+		appendU64(result, info.byteLength);
+	}
+
+	result += dfd;
+	result += kvd;
+	result.append(int(levelStart) - result.size(), '\0');
+	return result;
+}
+
+int QKTX2Handler::Header::imagesPerLevel() const
+{
+	return layerCount * faceCount;
+}
+
+int QKTX2Handler::Header::imageCount() const
+{
+	return levels.size() * imagesPerLevel();
+}
+
+QSize QKTX2Handler::Header::levelSize(int level) const
+{
+	return QSize(std::max(width >> level, 1), std::max(height >> level, 1));
+}
+
+qint64 QKTX2Handler::Header::imageByteLength(int level) const
+{
+	QSize size = levelSize(level);
+	return qint64((size.width() + xdim - 1) / xdim) *
+		((size.height() + ydim - 1) / ydim) * ASTC_COMPRESSED_BLOCK_SIZE;
+}
+
+qint64 QKTX2Handler::Header::fileSize() const
+{
+	// Level 0 is stored last
+	const Level &info = levels.first();
+	return qint64(info.byteOffset + info.byteLength);
+}
+
+bool QKTX2Handler::Header::flipped() const
+{
+	QByteArray orientation = keyValues.value(KTX_ORIENTATION_KEY);
+	return orientation.size() >= 2 && orientation.at(1) == 'u';
+}
+
+QString QKTX2Handler::Header::description() const
+{
+	QStringList pairs;
+	for (auto it = keyValues.begin(); it != keyValues.end(); ++it)
+	{
+		pairs.append(QString::fromUtf8(it.key()) + QStringLiteral(": ") +
+			QString::fromUtf8(*it));
+	}
+	return pairs.join(QStringLiteral("\n\n"));
+}
+
+const QByteArrayList &QKTX2Handler::Header::validSubTypes()
+{
+	static QByteArrayList result;
+
+	if (result.isEmpty())
+	{
+		for (bool srgb : { false, true })
+		{
+			for (auto &size : ASTC_VALID_BLOCK_SIZE)
+			{
+				result.append(toSubType(size.w, size.h, 1, srgb));
+			}
+		}
+	}
+
+	return result;
+}
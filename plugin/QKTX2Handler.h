@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QImage>
+#include <QImageIOHandler>
+#include <QRect>
+#include <QScopedPointer>
+
+// KTX2 textures of 2D ASTC blocks. Every mip level, array layer and cube
+// face is an image of its own, level 0 first. Array layers are written
+// from an image of them stacked top to bottom, the Layers text tells
+// their count, the Levels text limits the mip levels written.
+class QKTX2Handler : public QImageIOHandler
+{
+	struct Header;
+	// Read on first use, device positions are relative to mStart
+	mutable QScopedPointer<Header> mHeader;
+	mutable qint64 mStart;
+	mutable bool mHeaderRead;
+	// Contents of sequential devices, read at once
+	mutable QByteArray mData;
+	int mImageIndex;
+	int mQuality;
+	quint8 mBlockWidth;
+	quint8 mBlockHeight;
+	QRect mClipRect;
+	QSize mScaledSize;
+	QImage::Format mImageFormat;
+	Transformations mTransformation;
+	bool mOptimizedWrite;
+	bool mSRGB;
+	QString mDescription;
+
+public:
+	QKTX2Handler();
+	virtual ~QKTX2Handler() override;
+
+	static QByteArray KTX2_Format();
+
+	static bool validateHeader(QIODevice *device);
+
+	virtual bool canRead() const override;
+	virtual bool read(QImage *image) override;
+	virtual bool write(const QImage &image) override;
+
+	virtual int imageCount() const override;
+	virtual bool jumpToImage(int imageNumber) override;
+	virtual bool jumpToNextImage() override;
+	virtual int currentImageNumber() const override;
+
+	virtual QVariant option(ImageOption option) const override;
+	virtual void setOption(ImageOption option, const QVariant &value) override;
+	virtual bool supportsOption(ImageOption option) const override;
+
+private:
+	const Header *header() const;
+	// Compressed data of the given image, mapped when possible
+	const uchar *imageData(
+		int index, QByteArray &storage, uchar **mapped) const;
+	void unmapImageData(uchar *mapped) const;
+};
@@ -1,4 +1,4 @@
-VERSION = 1.0.3
+VERSION = 1.1.0
 
 TARGET = qastc
 
@@ -21,40 +21,16 @@ win32-msvc* {
 DESTDIR = $$[QT_INSTALL_PLUGINS]/imageformats
 
 HEADERS += \
+    QASTCFormats.h \
     QASTCHandler.h \
     QASTCPlugin.h \
-../lib/ASTC/cASTC.h \
-../lib/ASTC/ARM/astc_codec_internals.h \
-../lib/ASTC/ARM/mathlib.h \
-../lib/ASTC/ARM/softfloat.h \
-../lib/ASTC/ARM/vectypes.h \
-../lib/ASTC/ASTC_Decode.h \
-../lib/ASTC/ASTC_Definitions.h \
-../lib/ASTC/ASTC_Encode.h \
-../lib/ASTC/ASTC_Encode_Kernel.h \
-../lib/ASTC/ASTC_Host.h \
-../lib/ASTC/Codec_ASTC.h \
-../lib/Buffer/CodecBuffer.h \
-../lib/Buffer/CodecBuffer_Block.h \
-../lib/Buffer/CodecBuffer_RGBA8888.h \
-../lib/Codec.h \
-../lib/CommonTypes.h \
-../lib/MathMacros.h
+    QKTX2Handler.h
 
 SOURCES += \
+    QASTCFormats.cpp \
     QASTCHandler.cpp \
     QASTCPlugin.cpp \
-../lib/ASTC/ARM/mathlib.cpp \
-../lib/ASTC/ARM/softfloat.cpp \
-../lib/ASTC/ASTC_Decode.cpp \
-../lib/ASTC/ASTC_Encode.cpp \
-../lib/ASTC/ASTC_Encode_Kernel.cpp \
-../lib/ASTC/ASTC_Host.cpp \
-../lib/ASTC/Codec_ASTC.cpp \
-../lib/Buffer/CodecBuffer.cpp \
-../lib/Buffer/CodecBuffer_Block.cpp \
-../lib/Buffer/CodecBuffer_RGBA8888.cpp \
-../lib/Codec.cpp
+    QKTX2Handler.cpp
 
 win32 {
     CONFIG(debug, debug|release) {
@@ -66,7 +42,7 @@ win32 {
 
 OTHER_FILES += astc.json
 
-INCLUDEPATH = ../lib ../lib/Buffer
+include(../lib/lib.pri)
 
 PLUGIN_TYPE = imageformats
 PLUGIN_CLASS_NAME = QASTCPlugin
@@ -1,6 +1,7 @@
 TEMPLATE = subdirs
 SUBDIRS = \
     plugin \
-    qastc_tests
+    qastc_tests \
+    qastc_bench
 
 qastc_tests.depends = plugin 
\ No newline at end of file
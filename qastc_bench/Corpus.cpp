@@ -0,0 +1,345 @@
+#include "Corpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+static const char *const KIND_NAMES[] = {
+	"gradient",
+	"noise",
+	"ui",
+	"normal",
+	"sprite",
+};
+
+static CMP_DWORD hash(CMP_DWORD x, CMP_DWORD y, CMP_DWORD seed)
+{
+	CMP_DWORD h = x * 0x8DA6B343u ^ y * 0xD8163841u ^ seed * 0xCB1AB31Fu;
+	h ^= h >> 13;
+	h *= 0x5BD1E995u;
+	h ^= h >> 15;
+	return h;
+}
+
+static float unitHash(CMP_DWORD x, CMP_DWORD y, CMP_DWORD seed)
+{
+	return (hash(x, y, seed) >> 8) * (1.f / 16777216.f);
+}
+
+static CMP_BYTE toByte(float value)
+{
+	return CMP_BYTE(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// Lattice noise in 0..1 with cells of the given size, smoothly interpolated
+static float valueNoise(CMP_DWORD x, CMP_DWORD y, CMP_DWORD cell,
+	CMP_DWORD seed)
+{
+	CMP_DWORD cx = x / cell;
+	CMP_DWORD cy = y / cell;
+	float fx = float(x % cell) / cell;
+	float fy = float(y % cell) / cell;
+	fx = fx * fx * (3.f - 2.f * fx);
+	fy = fy * fy * (3.f - 2.f * fy);
+
+	float top = unitHash(cx, cy, seed) +
+		(unitHash(cx + 1, cy, seed) - unitHash(cx, cy, seed)) * fx;
+	float bottom = unitHash(cx, cy + 1, seed) +
+		(unitHash(cx + 1, cy + 1, seed) - unitHash(cx, cy + 1, seed)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// Octaves from cells of the given size down to 2 texels
+static float fractalNoise(CMP_DWORD x, CMP_DWORD y, CMP_DWORD cell,
+	CMP_DWORD seed)
+{
+	float sum = 0.f;
+	float weight = 0.5f;
+	float total = 0.f;
+	for (; cell >= 2; cell /= 2, weight *= 0.5f, seed++)
+	{
+		sum += valueNoise(x, y, cell, seed) * weight;
+		total += weight;
+	}
+	return total > 0.f ? sum / total : 0.f;
+}
+
+// Coverage of a texel by a disc, with a one texel wide antialiased edge
+static float discCoverage(float dx, float dy, float radius)
+{
+	float distance = std::sqrt(dx * dx + dy * dy);
+	return std::min(std::max(radius - distance + 0.5f, 0.f), 1.f);
+}
+
+static void blend(CMP_BYTE *texel, const CMP_BYTE color[3], float alpha)
+{
+	for (int c = 0; c < 3; c++)
+		texel[c] = CMP_BYTE(texel[c] + (color[c] - texel[c]) * alpha + 0.5f);
+}
+
+static void generateGradient(CorpusImage &image)
+{
+	const float w = float(std::max<CMP_DWORD>(image.width - 1, 1));
+	const float h = float(std::max<CMP_DWORD>(image.height - 1, 1));
+	CMP_BYTE *texel = image.rgba.data();
+	for (CMP_DWORD y = 0; y < image.height; y++)
+	{
+		for (CMP_DWORD x = 0; x < image.width; x++, texel += 4)
+		{
+			float u = x / w;
+			float v = y / h;
+			texel[0] = toByte(u);
+			texel[1] = toByte(v);
+			texel[2] = toByte(1.f - (u + v) * 0.5f);
+			texel[3] = 255;
+		}
+	}
+}
+
+static void generateNoise(CorpusImage &image)
+{
+	const CMP_DWORD cell = std::max<CMP_DWORD>(image.width / 8, 4);
+	CMP_BYTE *texel = image.rgba.data();
+	for (CMP_DWORD y = 0; y < image.height; y++)
+	{
+		for (CMP_DWORD x = 0; x < image.width; x++, texel += 4)
+		{
+			float grain = (unitHash(x, y, 99) - 0.5f) * 0.15f;
+			for (int c = 0; c < 3; c++)
+				texel[c] = toByte(fractalNoise(x, y, cell, 16 * c) + grain);
+			texel[3] = 255;
+		}
+	}
+}
+
+static void generateUI(CorpusImage &image)
+{
+	static const CMP_BYTE BACKGROUND[3] = { 240, 240, 242 };
+	static const CMP_BYTE HEADER[3] = { 45, 120, 215 };
+	static const CMP_BYTE BORDER[3] = { 170, 172, 180 };
+	static const CMP_BYTE TEXT[3] = { 30, 30, 36 };
+	static const CMP_BYTE PALETTE[4][3] = {
+		{ 255, 255, 255 },
+		{ 220, 235, 250 },
+		{ 250, 225, 200 },
+		{ 215, 245, 215 },
+	};
+
+	// Controls keep their pixel size whatever the image size, as on screen
+	const int HEADER_HEIGHT = 48;
+	const int CELL_WIDTH = 200;
+	const int CELL_HEIGHT = 64;
+	const int BUTTON_WIDTH = 180;
+	const int BUTTON_HEIGHT = 40;
+	const float ICON_RADIUS = 10.f;
+
+	CMP_BYTE *texel = image.rgba.data();
+	for (CMP_DWORD y = 0; y < image.height; y++)
+	{
+		for (CMP_DWORD x = 0; x < image.width; x++, texel += 4)
+		{
+			texel[3] = 255;
+			if (int(y) < HEADER_HEIGHT)
+			{
+				std::copy(HEADER, HEADER + 3, texel);
+				continue;
+			}
+			std::copy(BACKGROUND, BACKGROUND + 3, texel);
+
+			int cellX = int(x) / CELL_WIDTH;
+			int cellY = (int(y) - HEADER_HEIGHT) / CELL_HEIGHT;
+			int bx = int(x) % CELL_WIDTH - (CELL_WIDTH - BUTTON_WIDTH) / 2;
+			int by = (int(y) - HEADER_HEIGHT) % CELL_HEIGHT -
+				(CELL_HEIGHT - BUTTON_HEIGHT) / 2;
+			if (bx < 0 || by < 0 || bx >= BUTTON_WIDTH ||
+				by >= BUTTON_HEIGHT)
+			{
+				continue;
+			}
+
+			CMP_DWORD buttonHash = hash(CMP_DWORD(cellX), CMP_DWORD(cellY), 7);
+			bool border = bx == 0 || by == 0 || bx == BUTTON_WIDTH - 1 ||
+				by == BUTTON_HEIGHT - 1;
+			std::copy(BORDER, BORDER + 3, texel);
+			if (border)
+				continue;
+			std::copy(PALETTE[buttonHash & 3], PALETTE[buttonHash & 3] + 3,
+				texel);
+
+			// Round icon on the left, a caption of glyph strokes after it
+			float iconX = bx - 20.f + 0.5f;
+			float iconY = by - BUTTON_HEIGHT * 0.5f + 0.5f;
+			float coverage = discCoverage(iconX, iconY, ICON_RADIUS);
+			if (coverage > 0.f)
+			{
+				blend(texel, HEADER, coverage);
+				continue;
+			}
+
+			int glyph = (bx - 40) / 7;
+			int captionLength = 8 + int(buttonHash >> 8) % 12;
+			if (bx >= 40 && glyph < captionLength && (bx - 40) % 7 < 2)
+			{
+				int glyphHeight = 8 + int(hash(CMP_DWORD(glyph), buttonHash,
+										  3) % 5);
+				int top = BUTTON_HEIGHT / 2 - 6;
+				if (by >= top + 12 - glyphHeight && by < top + 12)
+					std::copy(TEXT, TEXT + 3, texel);
+			}
+		}
+	}
+}
+
+static void generateNormal(CorpusImage &image)
+{
+	const CMP_DWORD cell = std::max<CMP_DWORD>(image.width / 16, 4);
+	const CMP_DWORD w = image.width;
+	const CMP_DWORD h = image.height;
+
+	// Height field with a border of one texel for the differences
+	std::vector<float> heights((w + 2) * (h + 2));
+	for (CMP_DWORD y = 0; y < h + 2; y++)
+	{
+		for (CMP_DWORD x = 0; x < w + 2; x++)
+			heights[y * (w + 2) + x] = fractalNoise(x, y, cell, 1234);
+	}
+
+	const float strength = float(cell) * 0.5f;
+	const ptrdiff_t stride = ptrdiff_t(w) + 2;
+	CMP_BYTE *texel = image.rgba.data();
+	for (CMP_DWORD y = 0; y < h; y++)
+	{
+		const float *p = &heights[(y + 1) * stride + 1];
+		for (CMP_DWORD x = 0; x < w; x++, p++, texel += 4)
+		{
+			float dx = (p[1] - p[-1]) * strength;
+			float dy = (p[stride] - p[-stride]) * strength;
+			float length = std::sqrt(dx * dx + dy * dy + 1.f);
+			texel[0] = toByte((-dx / length) * 0.5f + 0.5f);
+			texel[1] = toByte((-dy / length) * 0.5f + 0.5f);
+			texel[2] = toByte((1.f / length) * 0.5f + 0.5f);
+			texel[3] = 255;
+		}
+	}
+}
+
+static void generateSprite(CorpusImage &image)
+{
+	std::fill(image.rgba.begin(), image.rgba.end(), CMP_BYTE(0));
+
+	// Soft discs drawn over each other, straight alpha
+	const CMP_DWORD size = std::min(image.width, image.height);
+	const int count = 12;
+	for (int i = 0; i < count; i++)
+	{
+		float cx = unitHash(i, 0, 55) * image.width;
+		float cy = unitHash(i, 1, 55) * image.height;
+		float radius = size * (1.f / 16.f + unitHash(i, 2, 55) / 8.f);
+		float feather = radius * 0.25f;
+		CMP_BYTE color[3];
+		for (int c = 0; c < 3; c++)
+			color[c] = CMP_BYTE(hash(i, 3 + c, 55) >> 24);
+
+		CMP_DWORD x0 = CMP_DWORD(std::max(cx - radius, 0.f));
+		CMP_DWORD y0 = CMP_DWORD(std::max(cy - radius, 0.f));
+		CMP_DWORD x1 = std::min(CMP_DWORD(cx + radius) + 1, image.width);
+		CMP_DWORD y1 = std::min(CMP_DWORD(cy + radius) + 1, image.height);
+		for (CMP_DWORD y = y0; y < y1; y++)
+		{
+			CMP_BYTE *texel = &image.rgba[(y * image.width + x0) * 4];
+			for (CMP_DWORD x = x0; x < x1; x++, texel += 4)
+			{
+				float dx = x + 0.5f - cx;
+				float dy = y + 0.5f - cy;
+				float distance = std::sqrt(dx * dx + dy * dy);
+				float alpha = std::min(
+					std::max((radius - distance) / feather, 0.f), 1.f);
+				if (alpha <= 0.f)
+					continue;
+
+				// Straight alpha over: colors are weighted by coverage
+				float below = texel[3] / 255.f * (1.f - alpha);
+				float out = alpha + below;
+				for (int c = 0; c < 3; c++)
+				{
+					texel[c] = CMP_BYTE(
+						(color[c] * alpha + texel[c] * below) / out + 0.5f);
+				}
+				texel[3] = toByte(out);
+			}
+		}
+	}
+}
+
+void CorpusImage::generate()
+{
+	rgba.resize(size_t(width) * height * 4);
+	switch (kind)
+	{
+		case CORPUS_GRADIENT:
+			generateGradient(*this);
+			break;
+
+		case CORPUS_NOISE:
+			generateNoise(*this);
+			break;
+
+		case CORPUS_UI:
+			generateUI(*this);
+			break;
+
+		case CORPUS_NORMAL:
+			generateNormal(*this);
+			break;
+
+		case CORPUS_SPRITE:
+			generateSprite(*this);
+			break;
+	}
+}
+
+void CorpusImage::release()
+{
+	std::vector<CMP_BYTE>().swap(rgba);
+}
+
+CMP_DWORD CorpusImage::checksum() const
+{
+	CMP_DWORD h = 2166136261u;
+	for (CMP_BYTE byte : rgba)
+	{
+		h ^= byte;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+std::vector<CorpusImage> makeCorpus(const std::vector<CMP_DWORD> &sizes)
+{
+	std::vector<CorpusImage> result;
+	for (CMP_DWORD size : sizes)
+	{
+		for (int kind = CORPUS_GRADIENT; kind <= CORPUS_SPRITE; kind++)
+		{
+			CorpusImage image;
+			image.kind = CorpusKind(kind);
+			image.name = std::string(KIND_NAMES[kind]) + '-' +
+				std::to_string(size);
+			image.width = size;
+			image.height = size;
+			result.push_back(image);
+		}
+	}
+
+	if (!sizes.empty() && *std::max_element(sizes.begin(), sizes.end()) >= 2048)
+	{
+		CorpusImage image;
+		image.kind = CORPUS_UI;
+		image.name = "ui-1920x1080";
+		image.width = 1920;
+		image.height = 1080;
+		result.push_back(image);
+	}
+
+	return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CommonTypes.h"
+
+#include <string>
+#include <vector>
+
+enum CorpusKind
+{
+	CORPUS_GRADIENT, // smooth ramps
+	CORPUS_NOISE, // fractal noise with grain, natural texture detail
+	CORPUS_UI, // flat panels, sharp borders, glyph strokes, round icons
+	CORPUS_NORMAL, // tangent space normal map of a bumpy height field
+	CORPUS_SPRITE, // soft edged shapes over transparent texels
+};
+
+// Synthetic RGBA8888 image, the same bytes on every run and platform: only
+// integer math and correctly rounded float operations are used.
+struct CorpusImage
+{
+	std::string name;
+	CorpusKind kind;
+	CMP_DWORD width;
+	CMP_DWORD height;
+	// Empty until generated, large images are only kept while measured
+	std::vector<CMP_BYTE> rgba;
+
+	void generate();
+	void release();
+
+	// FNV-1a hash of the texels, to tell corpora apart in reports
+	CMP_DWORD checksum() const;
+};
+
+// Every kind at each of the given square sizes, plus a 1920x1080 UI screen
+// when the largest size is at least 2048. Pixels are not generated yet.
+std::vector<CorpusImage> makeCorpus(const std::vector<CMP_DWORD> &sizes);
@@ -0,0 +1,135 @@
+#include "JsonWriter.h"
+
+#include <cmath>
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream &out)
+	: mOut(out)
+{
+}
+
+JsonWriter::~JsonWriter()
+{
+	mOut << '\n';
+	mOut.flush();
+}
+
+void JsonWriter::beginObject(const char *key)
+{
+	beginMember(key);
+	mOut << '{';
+	mEmpty.push_back(true);
+}
+
+void JsonWriter::endObject()
+{
+	end('}');
+}
+
+void JsonWriter::beginArray(const char *key)
+{
+	beginMember(key);
+	mOut << '[';
+	mEmpty.push_back(true);
+}
+
+void JsonWriter::endArray()
+{
+	end(']');
+}
+
+void JsonWriter::value(const char *key, const std::string &value)
+{
+	beginMember(key);
+	writeString(value);
+}
+
+void JsonWriter::value(const char *key, const char *value)
+{
+	this->value(key, std::string(value));
+}
+
+void JsonWriter::value(const char *key, long long value)
+{
+	beginMember(key);
+	mOut << value;
+}
+
+void JsonWriter::value(const char *key, bool value)
+{
+	beginMember(key);
+	mOut << (value ? "true" : "false");
+}
+
+void JsonWriter::value(const char *key, double value, int decimals)
+{
+	beginMember(key);
+	if (!std::isfinite(value))
+	{
+		mOut << "null";
+		return;
+	}
+
+	char text[64];
+	snprintf(text, sizeof(text), "%.*f", decimals, value);
+	mOut << text;
+}
+
+void JsonWriter::beginMember(const char *key)
+{
+	if (mEmpty.empty())
+		return;
+
+	mOut << (mEmpty.back() ? "\n" : ",\n");
+	mEmpty.back() = false;
+	mOut << std::string(mEmpty.size(), '\t');
+	if (key)
+	{
+		writeString(key);
+		mOut << ": ";
+	}
+}
+
+void JsonWriter::end(char bracket)
+{
+	bool empty = mEmpty.back();
+	mEmpty.pop_back();
+	if (!empty)
+		mOut << '\n' << std::string(mEmpty.size(), '\t');
+	mOut << bracket;
+}
+
+void JsonWriter::writeString(const std::string &value)
+{
+	mOut << '"';
+	for (char c : value)
+	{
+		switch (c)
+		{
+			case '"':
+				mOut << "\\\"";
+				break;
+
+			case '\\':
+				mOut << "\\\\";
+				break;
+
+			case '\n':
+				mOut << "\\n";
+				break;
+
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					mOut << escaped;
+				} else
+				{
+					mOut << c;
+				}
+				break;
+		}
+	}
+	mOut << '"';
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Streams indented JSON. Members keep the order they are written in, and
+// floating point values a fixed number of decimals, so that reports of two
+// versions diff line by line.
+class JsonWriter
+{
+	std::ostream &mOut;
+	// Whether the innermost object or array has no members yet
+	std::vector<bool> mEmpty;
+
+public:
+	explicit JsonWriter(std::ostream &out);
+	~JsonWriter();
+
+	// Keys are ignored inside arrays and required inside objects
+	void beginObject(const char *key = nullptr);
+	void endObject();
+	void beginArray(const char *key = nullptr);
+	void endArray();
+
+	void value(const char *key, const std::string &value);
+	void value(const char *key, const char *value);
+	void value(const char *key, long long value);
+	void value(const char *key, bool value);
+	// Infinite and NaN values are written as null
+	void value(const char *key, double value, int decimals);
+
+private:
+	void beginMember(const char *key);
+	void end(char bracket);
+	void writeString(const std::string &value);
+};
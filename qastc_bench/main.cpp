@@ -0,0 +1,687 @@
+#include "Corpus.h"
+#include "JsonWriter.h"
+
+#include "ASTC/ASTC_Trace.h"
+#include "ASTC/Codec_ASTC.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Options
+{
+	std::vector<CMP_DWORD> sizes;
+	std::vector<astc_block_size_t> blockSizes;
+	std::vector<astc_quality_tier_t> tiers;
+	std::vector<CMP_WORD> scalingThreads;
+	std::string imageFilter;
+	std::string scalingImage;
+	std::string output;
+	std::string trace;
+	std::string heatmaps;
+	double targetMpix;
+	int repeat;
+	bool stats;
+	bool ignoreTransparentRGB;
+};
+
+struct Result
+{
+	std::string image;
+	CMP_DWORD pixels;
+	astc_block_size_t blockSize;
+	const char *tier;
+	double encodeSeconds;
+	double decodeSeconds;
+	ASTCQualityMetrics metrics;
+	// Gathered by an extra encode when asked for
+	std::shared_ptr<ASTCEncodeStats> stats;
+};
+
+struct TuningResult
+{
+	std::string image;
+	CMP_DWORD pixels;
+	astc_block_size_t blockSize;
+	double deadlineSeconds;
+	ASTCQualityTuning tuning;
+	// Of an encode at the chosen quality
+	double encodeSeconds;
+};
+
+struct ScalingResult
+{
+	CMP_WORD threads;
+	double encodeSeconds;
+};
+
+static void printUsage()
+{
+	fprintf(stderr,
+		"Usage: qastc_bench [options]\n"
+		"  --full               sizes 256 to 8192 and a 1920x1080 screen\n"
+		"  --sizes 256,1024     square image sizes\n"
+		"  --blocks 4x4,6x6     block sizes, all 2D ones by default\n"
+		"  --quality fast,...   tiers of veryfast, fast, medium, thorough\n"
+		"                       and exhaustive; the first three by default\n"
+		"  --images NAME        images whose name contains NAME only\n"
+		"  --threads 1,2,4      thread counts of the scaling curve\n"
+		"  --scaling-image NAME image of the scaling curve, the largest\n"
+		"                       noise image by default\n"
+		"  --repeat N           runs per measure, the fastest is kept\n"
+		"  --stats              encoder statistics of every measure\n"
+		"  --ignore-transparent-rgb\n"
+		"                       encodes the color of texels with zero\n"
+		"                       alpha as don't care\n"
+		"  --heatmaps DIR       PGM heatmaps of block encode time, trials\n"
+		"                       and error of every measure, in an existing\n"
+		"                       directory\n"
+		"  --output FILE        JSON report, standard output by default\n"
+		"  --trace FILE         Chrome trace of every encode and decode\n"
+		"  --target-mpix N      tunes the quality of every image and block\n"
+		"                       size for N Mpix/s, and checks the choice\n");
+}
+
+static std::vector<std::string> splitList(const std::string &list)
+{
+	std::vector<std::string> result;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+			result.push_back(item);
+	}
+	return result;
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options)
+{
+	options.sizes = { 256, 1024 };
+	options.blockSizes.assign(
+		ASTC_VALID_BLOCK_SIZE, ASTC_VALID_BLOCK_SIZE + ASTC_VALID_BLOCK);
+	options.tiers.assign(ASTC_QUALITY_TIER, ASTC_QUALITY_TIER + 3);
+	options.repeat = 3;
+	options.stats = false;
+	options.ignoreTransparentRGB = false;
+	options.targetMpix = 0.0;
+
+	CMP_WORD hardwareThreads =
+		CMP_WORD(std::max(std::thread::hardware_concurrency(), 1u));
+	for (CMP_WORD threads = 1; threads < hardwareThreads; threads *= 2)
+		options.scalingThreads.push_back(threads);
+	options.scalingThreads.push_back(hardwareThreads);
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--full")
+		{
+			options.sizes = { 256, 1024, 2048, 4096, 8192 };
+			continue;
+		}
+
+		if (option == "--stats")
+		{
+			options.stats = true;
+			continue;
+		}
+
+		if (option == "--ignore-transparent-rgb")
+		{
+			options.ignoreTransparentRGB = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+			return false;
+
+		std::string value = argv[++i];
+		if (option == "--sizes")
+		{
+			options.sizes.clear();
+			for (auto &item : splitList(value))
+			{
+				int size = atoi(item.c_str());
+				if (size <= 0)
+					return false;
+				options.sizes.push_back(CMP_DWORD(size));
+			}
+		} else if (option == "--blocks")
+		{
+			options.blockSizes.clear();
+			for (auto &item : splitList(value))
+			{
+				int w;
+				int h;
+				if (sscanf(item.c_str(), "%dx%d", &w, &h) != 2 ||
+					!CCodec_ASTC::isValidBlockSize(w, h))
+				{
+					return false;
+				}
+				options.blockSizes.push_back({ CMP_BYTE(w), CMP_BYTE(h) });
+			}
+		} else if (option == "--quality")
+		{
+			options.tiers.clear();
+			for (auto &item : splitList(value))
+			{
+				auto it = std::find_if(std::begin(ASTC_QUALITY_TIER),
+					std::end(ASTC_QUALITY_TIER),
+					[&](const astc_quality_tier_t &tier) {
+						return item == tier.name;
+					});
+				if (it == std::end(ASTC_QUALITY_TIER))
+					return false;
+				options.tiers.push_back(*it);
+			}
+		} else if (option == "--images")
+		{
+			options.imageFilter = value;
+		} else if (option == "--threads")
+		{
+			options.scalingThreads.clear();
+			for (auto &item : splitList(value))
+			{
+				int threads = atoi(item.c_str());
+				if (threads <= 0)
+					return false;
+				options.scalingThreads.push_back(CMP_WORD(threads));
+			}
+		} else if (option == "--scaling-image")
+		{
+			options.scalingImage = value;
+		} else if (option == "--repeat")
+		{
+			options.repeat = atoi(value.c_str());
+			if (options.repeat <= 0)
+				return false;
+		} else if (option == "--output")
+		{
+			options.output = value;
+		} else if (option == "--trace")
+		{
+			options.trace = value;
+		} else if (option == "--heatmaps")
+		{
+			options.heatmaps = value;
+		} else if (option == "--target-mpix")
+		{
+			options.targetMpix = atof(value.c_str());
+			if (options.targetMpix <= 0.0)
+				return false;
+		} else
+		{
+			return false;
+		}
+	}
+
+	return !options.sizes.empty() && !options.blockSizes.empty() &&
+		!options.tiers.empty();
+}
+
+// Fastest of the given number of runs, infinite if a run fails
+static double bestSeconds(int repeat, const std::function<bool()> &run)
+{
+	double best = INFINITY;
+	for (int i = 0; i < repeat; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (!run())
+			return INFINITY;
+		std::chrono::duration<double> elapsed =
+			std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+static double megapixelsPerSecond(CMP_DWORD pixels, double seconds)
+{
+	return pixels / seconds / 1e6;
+}
+
+static std::string blockName(const astc_block_size_t &size)
+{
+	return std::to_string(size.w) + 'x' + std::to_string(size.h);
+}
+
+// Binary PGM of one gray texel per block, any image viewer opens them
+static void writeHeatmaps(
+	const std::string &prefix, const ASTCBlockCosts &costs)
+{
+	static const char *const HEATMAP_NAMES[ASTC_HEATMAP_COUNT] = {
+		"seconds",
+		"trials",
+		"error",
+	};
+
+	std::vector<CMP_BYTE> gray(costs.size());
+	for (int i = 0; i < ASTC_HEATMAP_COUNT; i++)
+	{
+		costs.heatmap(ASTCHeatmap(i), 0.f, gray.data(), costs.columns);
+
+		std::string path = prefix + '-' + HEATMAP_NAMES[i] + ".pgm";
+		std::ofstream file(path, std::ios::binary);
+		file << "P5\n"
+			 << costs.columns << ' ' << costs.rows * costs.layers
+			 << "\n255\n";
+		file.write(reinterpret_cast<const char *>(gray.data()),
+			std::streamsize(gray.size()));
+		if (!file)
+			fprintf(stderr, "Cannot write %s\n", path.c_str());
+	}
+}
+
+// Encoder settings of the command line, the same for every measure
+static void setEncodeOptions(CCodec_ASTC &codec, const Options &options)
+{
+	codec.setIgnoreTransparentRGB(options.ignoreTransparentRGB);
+}
+
+static Result measure(const CorpusImage &image,
+	const astc_block_size_t &blockSize, const astc_quality_tier_t &tier,
+	const Options &options, const std::string &heatmapPrefix)
+{
+	ASTCTraceScope trace("measure", "bench");
+	trace.arg("blockWidth", blockSize.w);
+	trace.arg("blockHeight", blockSize.h);
+
+	CCodec_ASTC codec;
+	setEncodeOptions(codec, options);
+	codec.setBlockRate(blockSize.w, blockSize.h);
+	codec.setQuality(tier.quality);
+
+	std::unique_ptr<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0, 0,
+		0, image.width, image.height, image.width * 4,
+		const_cast<CMP_BYTE *>(image.rgba.data())));
+	std::unique_ptr<CCodecBuffer> blocks(codec.CreateBuffer(
+		CMP_BYTE(blockSize.w), CMP_BYTE(blockSize.h), 1, image.width,
+		image.height));
+	std::unique_ptr<CCodecBuffer> decoded(CreateCodecBuffer(
+		CBT_RGBA8888, 0, 0, 0, image.width, image.height, image.width * 4));
+
+	Result result;
+	result.image = image.name;
+	result.pixels = image.width * image.height;
+	result.blockSize = blockSize;
+	result.tier = tier.name;
+	result.encodeSeconds = bestSeconds(options.repeat,
+		[&] { return codec.Compress(*source, *blocks) == CE_OK; });
+	result.decodeSeconds = bestSeconds(options.repeat,
+		[&] { return codec.Decompress(*blocks, *decoded) == CE_OK; });
+	codec.ComputeMetrics(*source, *decoded, result.metrics);
+
+	// Kept out of the timed runs, gathering statistics slows them down
+	ASTCBlockCosts costs;
+	bool heatmaps = !heatmapPrefix.empty();
+	if (options.stats || heatmaps)
+	{
+		if (options.stats)
+			result.stats = std::make_shared<ASTCEncodeStats>();
+		codec.Compress(*source, *blocks, result.stats.get(),
+			heatmaps ? &costs : nullptr);
+	}
+	if (heatmaps)
+		writeHeatmaps(heatmapPrefix, costs);
+	return result;
+}
+
+static TuningResult measureTuning(const CorpusImage &image,
+	const astc_block_size_t &blockSize, const Options &options)
+{
+	CCodec_ASTC codec;
+	setEncodeOptions(codec, options);
+
+	std::unique_ptr<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0, 0,
+		0, image.width, image.height, image.width * 4,
+		const_cast<CMP_BYTE *>(image.rgba.data())));
+	std::unique_ptr<CCodecBuffer> blocks(codec.CreateBuffer(
+		CMP_BYTE(blockSize.w), CMP_BYTE(blockSize.h), 1, image.width,
+		image.height));
+
+	TuningResult result;
+	result.image = image.name;
+	result.pixels = image.width * image.height;
+	result.blockSize = blockSize;
+	result.deadlineSeconds = result.pixels / (options.targetMpix * 1e6);
+	codec.TuneQuality(*source, CMP_BYTE(blockSize.w), CMP_BYTE(blockSize.h),
+		result.deadlineSeconds, result.tuning);
+	codec.setQuality(result.tuning.quality);
+
+	// Whether the prediction holds
+	result.encodeSeconds = bestSeconds(
+		1, [&] { return codec.Compress(*source, *blocks) == CE_OK; });
+	return result;
+}
+
+static std::vector<ScalingResult> measureScaling(
+	const CorpusImage &image, const Options &options)
+{
+	const astc_block_size_t blockSize = { 6, 6 };
+
+	CCodec_ASTC codec;
+	setEncodeOptions(codec, options);
+	codec.setBlockRate(blockSize.w, blockSize.h);
+	codec.setQuality(options.tiers.front().quality);
+
+	std::unique_ptr<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0, 0,
+		0, image.width, image.height, image.width * 4,
+		const_cast<CMP_BYTE *>(image.rgba.data())));
+	std::unique_ptr<CCodecBuffer> blocks(codec.CreateBuffer(
+		CMP_BYTE(blockSize.w), CMP_BYTE(blockSize.h), 1, image.width,
+		image.height));
+
+	std::vector<ScalingResult> result;
+	for (CMP_WORD threads : options.scalingThreads)
+	{
+		fprintf(stderr, "scaling %s %u threads\n", image.name.c_str(),
+			unsigned(threads));
+		codec.setNumThreads(threads);
+		ASTCTraceScope trace("scaling", "bench");
+		trace.arg("threads", threads);
+		ScalingResult point;
+		point.threads = threads;
+		point.encodeSeconds = bestSeconds(options.repeat,
+			[&] { return codec.Compress(*source, *blocks) == CE_OK; });
+		result.push_back(point);
+	}
+	return result;
+}
+
+static void writeStats(JsonWriter &json, const ASTCEncodeStats &stats)
+{
+	static const char *const EXIT_NAMES[ASTC_EXIT_COUNT] = {
+		"constant",
+		"mode0",
+		"twoPlanes",
+		"partitions",
+		"partition1To2Limit",
+		"end",
+	};
+	static const char *const STAGE_NAMES[ASTC_STAGE_COUNT] = {
+		"fetch",
+		"prepare",
+		"mode0",
+		"twoPlanes",
+		"partitionSearch",
+		"partitions",
+		"pack",
+	};
+
+	json.beginObject("stats");
+	json.value("blocks", (long long) stats.blocks);
+
+	json.beginObject("exits");
+	for (int i = 0; i < ASTC_EXIT_COUNT; i++)
+		json.value(EXIT_NAMES[i], (long long) stats.exits[i]);
+	json.endObject();
+
+	json.beginArray("partitionCounts");
+	for (CMP_DWORD count : stats.partitionCounts)
+		json.value(nullptr, (long long) count);
+	json.endArray();
+
+	json.value("dualPlaneBlocks", (long long) stats.dualPlaneBlocks);
+
+	// Modes in use only, as [mode, blocks] pairs
+	json.beginArray("blockModes");
+	for (int mode = 0; mode < ASTC_BLOCK_MODE_COUNT; mode++)
+	{
+		if (stats.blockModes[mode] == 0)
+			continue;
+
+		json.beginArray();
+		json.value(nullptr, (long long) mode);
+		json.value(nullptr, (long long) stats.blockModes[mode]);
+		json.endArray();
+	}
+	json.endArray();
+
+	json.value("trials", (long long) stats.trials);
+	json.value("decodes", (long long) stats.decodes);
+
+	json.beginObject("stageSeconds");
+	for (int i = 0; i < ASTC_STAGE_COUNT; i++)
+		json.value(STAGE_NAMES[i], stats.stageSeconds[i], 6);
+	json.endObject();
+
+	json.endObject();
+}
+
+static void writeReport(std::ostream &out, const Options &options,
+	const std::vector<CorpusImage> &corpus,
+	const std::vector<CMP_DWORD> &checksums,
+	const std::vector<Result> &results,
+	const std::vector<TuningResult> &tunings, const CorpusImage *scalingImage,
+	const std::vector<ScalingResult> &scaling)
+{
+	JsonWriter json(out);
+	json.beginObject();
+	json.value("benchmark", "qastc_bench");
+	json.value("formatVersion", 1LL);
+	json.value("hardwareThreads",
+		(long long) std::thread::hardware_concurrency());
+	json.value(
+		"encodeThreads", (long long) CCodec_ASTC::getDefaultEncodeThreads());
+	json.value("repeat", (long long) options.repeat);
+	json.value("ignoreTransparentRGB", options.ignoreTransparentRGB);
+
+	json.beginArray("corpus");
+	for (size_t i = 0; i < corpus.size(); i++)
+	{
+		json.beginObject();
+		json.value("name", corpus[i].name);
+		json.value("width", (long long) corpus[i].width);
+		json.value("height", (long long) corpus[i].height);
+		char checksum[16];
+		snprintf(checksum, sizeof(checksum), "%08x", unsigned(checksums[i]));
+		json.value("checksum", checksum);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.beginArray("results");
+	for (auto &result : results)
+	{
+		json.beginObject();
+		json.value("image", result.image);
+		json.value("blockSize", blockName(result.blockSize));
+		json.value("quality", result.tier);
+		json.value("bitsPerPixel",
+			128.0 / (result.blockSize.w * result.blockSize.h), 2);
+		json.value("encodeMpixPerSec",
+			megapixelsPerSecond(result.pixels, result.encodeSeconds), 3);
+		json.value("decodeMpixPerSec",
+			megapixelsPerSecond(result.pixels, result.decodeSeconds), 3);
+		json.value("psnr", result.metrics.psnrRGBA, 3);
+		json.value("psnrRGB", result.metrics.psnrRGB, 3);
+		json.value("psnrAlphaWeighted", result.metrics.psnrAlphaWeighted, 3);
+		json.value("ssim", result.metrics.ssimRGB, 5);
+		if (result.stats)
+			writeStats(json, *result.stats);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.beginArray("tuning");
+	for (auto &result : tunings)
+	{
+		const ASTCQualityTuning &tuning = result.tuning;
+		json.beginObject();
+		json.value("image", result.image);
+		json.value("blockSize", blockName(result.blockSize));
+		json.value("targetMpixPerSec", options.targetMpix, 3);
+		json.value("deadlineSeconds", result.deadlineSeconds, 6);
+		json.value("sampleBlocks", (long long) tuning.sampleBlocks);
+		json.value("totalBlocks", (long long) tuning.totalBlocks);
+		json.value("tuningSeconds", tuning.tuningSeconds, 6);
+
+		json.beginArray("tiers");
+		for (int i = 0; i < ASTC_QUALITY_TIER_COUNT; i++)
+		{
+			if (tuning.estimatedSeconds[i] < 0.0)
+				break;
+
+			json.beginObject();
+			json.value("quality", ASTC_QUALITY_TIER[i].name);
+			json.value("sampleSeconds", tuning.sampleSeconds[i], 6);
+			json.value("fixedSeconds", tuning.fixedSeconds[i], 6);
+			json.value("estimatedSeconds", tuning.estimatedSeconds[i], 6);
+			json.endObject();
+		}
+		json.endArray();
+
+		json.value("quality", ASTC_QUALITY_TIER[tuning.tier].name);
+		json.value("metDeadline", tuning.metDeadline);
+		json.value("estimatedSeconds", tuning.estimatedSeconds[tuning.tier], 6);
+		json.value("encodeSeconds", result.encodeSeconds, 6);
+		json.value("encodeMetDeadline",
+			result.encodeSeconds <= result.deadlineSeconds);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.beginObject("threadScaling");
+	if (scalingImage)
+	{
+		json.value("image", scalingImage->name);
+		json.value("blockSize", "6x6");
+		json.value("quality", options.tiers.front().name);
+
+		CMP_DWORD pixels = scalingImage->width * scalingImage->height;
+		json.beginArray("points");
+		for (auto &point : scaling)
+		{
+			double speedup = scaling.front().encodeSeconds / point.encodeSeconds;
+			json.beginObject();
+			json.value("threads", (long long) point.threads);
+			json.value("encodeMpixPerSec",
+				megapixelsPerSecond(pixels, point.encodeSeconds), 3);
+			json.value("speedup", speedup, 3);
+			json.value("efficiency", speedup / point.threads, 3);
+			json.endObject();
+		}
+		json.endArray();
+	}
+	json.endObject();
+
+	json.endObject();
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		printUsage();
+		return 1;
+	}
+
+	// The option wins over the environment
+	if (options.trace.empty() && ASTCTrace::environmentPath())
+		options.trace = ASTCTrace::environmentPath();
+	if (!options.trace.empty() && !ASTCTrace::start(options.trace.c_str()))
+	{
+		fprintf(stderr, "Cannot write %s\n", options.trace.c_str());
+		return 1;
+	}
+	ASTCTrace::setThreadName("main");
+
+	auto corpus = makeCorpus(options.sizes);
+	corpus.erase(std::remove_if(corpus.begin(), corpus.end(),
+					 [&](const CorpusImage &image) {
+						 return image.name.find(options.imageFilter) ==
+							 std::string::npos;
+					 }),
+		corpus.end());
+
+	// The scaling curve is measured on the largest noise image unless
+	// another one is named
+	CorpusImage *scalingImage = nullptr;
+	for (auto &image : corpus)
+	{
+		bool match = options.scalingImage.empty()
+			? image.kind == CORPUS_NOISE &&
+				(!scalingImage || image.width > scalingImage->width)
+			: image.name == options.scalingImage;
+		if (match)
+			scalingImage = &image;
+	}
+
+	std::vector<CMP_DWORD> checksums;
+	std::vector<Result> results;
+	std::vector<TuningResult> tunings;
+	std::vector<ScalingResult> scaling;
+	for (auto &image : corpus)
+	{
+		image.generate();
+		checksums.push_back(image.checksum());
+
+		for (auto &blockSize : options.blockSizes)
+		{
+			for (auto &tier : options.tiers)
+			{
+				fprintf(stderr, "%s %s %s\n", image.name.c_str(),
+					blockName(blockSize).c_str(), tier.name);
+				std::string heatmapPrefix;
+				if (!options.heatmaps.empty())
+				{
+					heatmapPrefix = options.heatmaps + '/' + image.name + '-' +
+						blockName(blockSize) + '-' + tier.name;
+				}
+				results.push_back(
+					measure(image, blockSize, tier, options, heatmapPrefix));
+			}
+
+			if (options.targetMpix > 0.0)
+			{
+				fprintf(stderr, "%s %s tuning\n", image.name.c_str(),
+					blockName(blockSize).c_str());
+				tunings.push_back(measureTuning(image, blockSize, options));
+			}
+		}
+
+		if (&image == scalingImage && !options.scalingThreads.empty())
+		{
+			scaling = measureScaling(image, options);
+		}
+		image.release();
+	}
+
+	if (scaling.empty())
+		scalingImage = nullptr;
+
+	if (!options.trace.empty() && !ASTCTrace::stop())
+	{
+		fprintf(stderr, "Cannot write %s\n", options.trace.c_str());
+		return 1;
+	}
+
+	if (options.output.empty())
+	{
+		writeReport(std::cout, options, corpus, checksums, results, tunings,
+			scalingImage, scaling);
+		return 0;
+	}
+
+	std::ofstream file(options.output);
+	if (!file)
+	{
+		fprintf(stderr, "Cannot write %s\n", options.output.c_str());
+		return 1;
+	}
+	writeReport(file, options, corpus, checksums, results, tunings,
+		scalingImage, scaling);
+	return file ? 0 : 1;
+}
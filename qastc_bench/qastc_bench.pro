@@ -0,0 +1,29 @@
+TARGET = qastc_bench
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+TEMPLATE = app
+
+CONFIG += warn_off
+unix|win32-g++ {
+    QMAKE_CXXFLAGS_WARN_OFF -= -w
+    QMAKE_CXXFLAGS += -Wall
+}
+
+win32-msvc* {
+    QMAKE_CXXFLAGS_WARN_OFF -= -W0
+    QMAKE_CXXFLAGS += -W3
+}
+
+unix:LIBS += -lpthread
+
+SOURCES += \
+    Corpus.cpp \
+    JsonWriter.cpp \
+    main.cpp
+
+HEADERS += \
+    Corpus.h \
+    JsonWriter.h
+
+include(../lib/lib.pri)
@@ -1,7 +1,14 @@
 #include "Tests.h"
 
+#include "ASTC/ASTC_Trace.h"
+#include "ASTC/Codec_ASTC.h"
+#include "QASTCHandler.h"
+
 #include <QImageReader>
 #include <QImageWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 #include <QPainter>
 #include <QtTest>
@@ -29,6 +36,8 @@ const ASTCTests::Options ASTCTests::Options::OPTIONS[] = {
 	{ -1, QByteArrayLiteral("10x10") },
 	{ -1, QByteArrayLiteral("12x10") },
 	{ 95, QByteArrayLiteral("12x12") },
+	{ -1, QByteArrayLiteral("4x4x4") },
+	{ 70, QByteArrayLiteral("6x6x6") },
 };
 
 static const QImage &fetchImage()
@@ -58,6 +67,15 @@ static bool checkImages(const QImage &a, QImage &b)
 		a.pixelColor(16 + 8, 16 + 8) == b.pixelColor(16 + 8, 16 + 8);
 }
 
+static bool checkColors(QRgb a, QRgb b)
+{
+	const int tolerance = 2;
+	return qAbs(qRed(a) - qRed(b)) <= tolerance &&
+		qAbs(qGreen(a) - qGreen(b)) <= tolerance &&
+		qAbs(qBlue(a) - qBlue(b)) <= tolerance &&
+		qAbs(qAlpha(a) - qAlpha(b)) <= tolerance;
+}
+
 template <typename CLASS>
 static void checkSupportedOptions(const CLASS &io)
 {
@@ -66,20 +84,20 @@ static void checkSupportedOptions(const CLASS &io)
 	QVERIFY(io.supportsOption(QImageIOHandler::Quality));
 	QVERIFY(io.supportsOption(QImageIOHandler::SubType));
 	QVERIFY(io.supportsOption(QImageIOHandler::SupportedSubTypes));
+	QVERIFY(io.supportsOption(QImageIOHandler::ClipRect));
+	QVERIFY(io.supportsOption(QImageIOHandler::ScaledSize));
+	QVERIFY(io.supportsOption(QImageIOHandler::IncrementalReading));
+	QVERIFY(io.supportsOption(QImageIOHandler::ImageFormat));
+	QVERIFY(io.supportsOption(QImageIOHandler::ImageTransformation));
+	QVERIFY(io.supportsOption(QImageIOHandler::ProgressiveScanWrite));
+	QVERIFY(io.supportsOption(QImageIOHandler::OptimizedWrite));
+	QVERIFY(io.supportsOption(QImageIOHandler::Description));
 	// unsupported options
-	QVERIFY(!io.supportsOption(QImageIOHandler::ScaledSize));
-	QVERIFY(!io.supportsOption(QImageIOHandler::ImageFormat));
-	QVERIFY(!io.supportsOption(QImageIOHandler::ImageTransformation));
 	QVERIFY(!io.supportsOption(QImageIOHandler::Gamma));
 	QVERIFY(!io.supportsOption(QImageIOHandler::Animation));
-	QVERIFY(!io.supportsOption(QImageIOHandler::IncrementalReading));
 	QVERIFY(!io.supportsOption(QImageIOHandler::Endianness));
 	QVERIFY(!io.supportsOption(QImageIOHandler::BackgroundColor));
-	QVERIFY(!io.supportsOption(QImageIOHandler::OptimizedWrite));
-	QVERIFY(!io.supportsOption(QImageIOHandler::ProgressiveScanWrite));
 	QVERIFY(!io.supportsOption(QImageIOHandler::Name));
-	QVERIFY(!io.supportsOption(QImageIOHandler::Description));
-	QVERIFY(!io.supportsOption(QImageIOHandler::ClipRect));
 	QVERIFY(!io.supportsOption(QImageIOHandler::ScaledClipRect));
 }
 
@@ -92,6 +110,7 @@ void ASTCTests::testInstallation()
 	for (auto &s : supported)
 	{
 		QVERIFY(s.indexOf("astc") >= 0);
+		QVERIFY(s.indexOf("ktx2") >= 0);
 	}
 }
 
@@ -110,6 +129,505 @@ void ASTCTests::testIO()
 	}
 }
 
+void ASTCTests::testVolume()
+{
+	// a volume is read and written as its slices stacked top to bottom,
+	// the Slices text tells their count
+	QImage strip(32, 32 * 3, QImage::Format_ARGB32);
+	QPainter painter(&strip);
+	painter.drawImage(0, 0, fetchImage());
+	painter.drawImage(0, 32, fetchImage().mirrored());
+	painter.drawImage(0, 64, fetchImage());
+	painter.end();
+
+	QBuffer buffer;
+	QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+	QImageWriter writer(&buffer, QByteArrayLiteral("astc"));
+	writer.setSubType(QByteArrayLiteral("5x5x5"));
+	writer.setText(QStringLiteral("Slices"), QStringLiteral("3"));
+	QVERIFY(writer.write(strip));
+
+	QVERIFY(buffer.seek(0));
+	QImageReader reader(&buffer);
+	QCOMPARE(reader.size(), strip.size());
+	QCOMPARE(reader.subType(), QByteArrayLiteral("5x5x5"));
+	QCOMPARE(reader.text(QStringLiteral("Slices")), QStringLiteral("3"));
+
+	QImage volume;
+	QVERIFY(reader.read(&volume));
+	QCOMPARE(volume.size(), strip.size());
+	for (int i = 0; i < 3; i++)
+	{
+		QRect slice(0, i * 32, 32, 32);
+		QVERIFY(checkImages(strip.copy(slice), volume.copy(slice)));
+	}
+
+	// clipped reads decode only the slices the rect crosses, part of the
+	// first and last one, the whole one between them
+	const QRect clipRect(3, 20, 25, 50);
+	QVERIFY(buffer.seek(0));
+	QImageReader clipReader(&buffer);
+	clipReader.setClipRect(clipRect);
+
+	QImage clipped;
+	QVERIFY(clipReader.read(&clipped));
+	QCOMPARE(clipped, volume.copy(clipRect));
+
+	// without the text 3D blocks store a single slice
+	QBuffer flatBuffer;
+	QVERIFY(flatBuffer.open(QIODevice::ReadWrite));
+
+	QImageWriter flatWriter(&flatBuffer, QByteArrayLiteral("astc"));
+	flatWriter.setSubType(QByteArrayLiteral("5x5x5"));
+	QVERIFY(flatWriter.write(strip));
+
+	QVERIFY(flatBuffer.seek(0));
+	QImageReader flatReader(&flatBuffer);
+	QCOMPARE(flatReader.size(), strip.size());
+	QVERIFY(flatReader.text(QStringLiteral("Slices")).isEmpty());
+
+	// slices must split the image evenly
+	QBuffer badBuffer;
+	QVERIFY(badBuffer.open(QIODevice::ReadWrite));
+
+	QImageWriter badWriter(&badBuffer, QByteArrayLiteral("astc"));
+	badWriter.setSubType(QByteArrayLiteral("5x5x5"));
+	badWriter.setText(QStringLiteral("Slices"), QStringLiteral("4"));
+	QVERIFY(!badWriter.write(strip));
+}
+
+void ASTCTests::testHDR()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+	// half float images are stored as HDR blocks and decoded back to half
+	// floats, values above 1.0 included
+	auto expected = [](int x, int y, int c) {
+		const float texel[4] = { 4.f * (x + 1) / 16, 1.5f, 0.5f + y / 16.f,
+			1.f };
+		return texel[c];
+	};
+
+	QImage image(16, 16, QImage::Format_RGBA16FPx4);
+	for (int y = 0; y < image.height(); y++)
+	{
+		auto texel = reinterpret_cast<qfloat16 *>(image.scanLine(y));
+		for (int x = 0; x < image.width(); x++)
+		{
+			for (int c = 0; c < 4; c++)
+				*texel++ = qfloat16(expected(x, y, c));
+		}
+	}
+
+	QBuffer buffer;
+	QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+	QImageWriter writer(&buffer, QByteArrayLiteral("astc"));
+	writer.setSubType(QByteArrayLiteral("4x4"));
+	QVERIFY(writer.write(image));
+
+	QVERIFY(buffer.seek(0));
+	QASTCHandler handler;
+	handler.setDevice(&buffer);
+	handler.setOption(
+		QImageIOHandler::ImageFormat, int(QImage::Format_RGBA16FPx4));
+
+	QImage decoded;
+	QVERIFY(handler.read(&decoded));
+	QCOMPARE(decoded.format(), QImage::Format_RGBA16FPx4);
+	QCOMPARE(decoded.size(), image.size());
+
+	for (int y = 0; y < decoded.height(); y++)
+	{
+		auto texel = reinterpret_cast<const qfloat16 *>(decoded.scanLine(y));
+		for (int x = 0; x < decoded.width(); x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				float value = expected(x, y, c);
+				float tolerance = 0.15f * qMax(value, 1.f);
+				QVERIFY(qAbs(float(*texel++) - value) <= tolerance);
+			}
+		}
+	}
+
+	// KTX2 textures of HDR blocks are read as half floats by default
+	QBuffer ktx2Buffer;
+	QVERIFY(ktx2Buffer.open(QIODevice::ReadWrite));
+
+	QImageWriter ktx2Writer(&ktx2Buffer, QByteArrayLiteral("ktx2"));
+	ktx2Writer.setSubType(QByteArrayLiteral("4x4"));
+	QVERIFY(ktx2Writer.write(image));
+
+	QVERIFY(ktx2Buffer.seek(0));
+	QImageReader ktx2Reader(&ktx2Buffer);
+	QCOMPARE(ktx2Reader.imageFormat(), QImage::Format_RGBA16FPx4);
+
+	QImage texture;
+	QVERIFY(ktx2Reader.read(&texture));
+	QCOMPARE(texture.format(), QImage::Format_RGBA16FPx4);
+	QVERIFY(qAbs(float(reinterpret_cast<const qfloat16 *>(
+					 texture.constScanLine(0))[1]) -
+				1.5f) <= 0.15f * 1.5f);
+#else
+	QSKIP("Half float images need Qt 6.2");
+#endif
+}
+
+void ASTCTests::testKTX2()
+{
+	auto &image = fetchImage();
+
+	QTemporaryDir tempDir;
+	tempDir.setAutoRemove(true);
+	QVERIFY(tempDir.isValid());
+	QString filePath =
+		QDir(tempDir.path()).filePath(QStringLiteral("mip.ktx2"));
+
+	// every mip level is written, level 0 read first
+	QImageWriter writer(filePath);
+	writer.setSubType(QByteArrayLiteral("6x6"));
+	writer.setText(QStringLiteral("Author"), QStringLiteral("qastc"));
+	QVERIFY(writer.write(image));
+
+	QImageReader reader(filePath);
+	QCOMPARE(reader.imageCount(), 6);
+	QCOMPARE(reader.size(), image.size());
+	QCOMPARE(reader.subType(), QByteArrayLiteral("6x6"));
+	QCOMPARE(reader.text(QStringLiteral("Author")), QStringLiteral("qastc"));
+
+	QImage level;
+	QVERIFY(reader.read(&level));
+	QVERIFY(checkImages(image, level));
+
+	// smaller levels keep the quadrant colors
+	QVERIFY(reader.jumpToImage(4));
+	QCOMPARE(reader.size(), QSize(2, 2));
+	QVERIFY(reader.read(&level));
+	QCOMPARE(level.size(), QSize(2, 2));
+	QVERIFY(checkColors(level.pixel(0, 0), image.pixel(8, 8)));
+	QVERIFY(checkColors(level.pixel(1, 0), image.pixel(16 + 8, 8)));
+	QVERIFY(checkColors(level.pixel(0, 1), image.pixel(8, 16 + 8)));
+	QVERIFY(checkColors(level.pixel(1, 1), image.pixel(16 + 8, 16 + 8)));
+
+	// flipped textures are stored bottom-up and read upright
+	QBuffer buffer;
+	QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+	QImageWriter flipWriter(&buffer, QByteArrayLiteral("ktx2"));
+	flipWriter.setSubType(QByteArrayLiteral("4x4-srgb"));
+	flipWriter.setTransformation(QImageIOHandler::TransformationFlip);
+	QVERIFY(flipWriter.write(image));
+
+	QVERIFY(buffer.seek(0));
+	QImageReader flipReader(&buffer);
+	QCOMPARE(flipReader.subType(), QByteArrayLiteral("4x4-srgb"));
+	QCOMPARE(flipReader.text(QStringLiteral("KTXorientation")),
+		QStringLiteral("ru"));
+	QVERIFY(flipReader.read(&level));
+	QVERIFY(checkImages(image, level));
+
+	// array layers are written from a strip of them, the Levels text
+	// limits the mip chain
+	QImage strip(32, 32 * 3, QImage::Format_ARGB32);
+	QPainter painter(&strip);
+	painter.drawImage(0, 0, fetchImage());
+	painter.drawImage(0, 32, fetchImage().mirrored());
+	painter.drawImage(0, 64, fetchImage());
+	painter.end();
+
+	QBuffer arrayBuffer;
+	QVERIFY(arrayBuffer.open(QIODevice::ReadWrite));
+
+	QImageWriter arrayWriter(&arrayBuffer, QByteArrayLiteral("ktx2"));
+	arrayWriter.setSubType(QByteArrayLiteral("4x4"));
+	arrayWriter.setText(QStringLiteral("Layers"), QStringLiteral("3"));
+	arrayWriter.setText(QStringLiteral("Levels"), QStringLiteral("2"));
+	QVERIFY(arrayWriter.write(strip));
+
+	QVERIFY(arrayBuffer.seek(0));
+	QImageReader arrayReader(&arrayBuffer);
+	QCOMPARE(arrayReader.imageCount(), 2 * 3);
+	QCOMPARE(arrayReader.size(), image.size());
+	QVERIFY(arrayReader.text(QStringLiteral("Layers")).isEmpty());
+	for (int i = 0; i < 3; i++)
+	{
+		QVERIFY(arrayReader.jumpToImage(i));
+		QVERIFY(arrayReader.read(&level));
+		QVERIFY(checkImages(strip.copy(0, i * 32, 32, 32), level));
+	}
+	QVERIFY(arrayReader.jumpToImage(3));
+	QCOMPARE(arrayReader.size(), QSize(16, 16));
+
+	// an explicit format is honoured, KTX2 contents are no ASTC file
+	QVERIFY(buffer.seek(0));
+	QImageReader astcReader(&buffer, QByteArrayLiteral("astc"));
+	astcReader.setAutoDetectImageFormat(false);
+	QVERIFY(!astcReader.canRead());
+}
+
+void ASTCTests::testOptimizedWrite()
+{
+	// colors under zero alpha are garbage, optimized writes leave them
+	// out and match the visible texels closer
+	QImage sprite(32, 32, QImage::Format_RGBA8888);
+	quint32 seed = 1;
+	for (int y = 0; y < sprite.height(); y++)
+	{
+		for (int x = 0; x < sprite.width(); x++)
+		{
+			if ((x / 2 + y / 2) % 2)
+			{
+				sprite.setPixel(x, y, qRgba(x * 8, y * 8, 128, 255));
+				continue;
+			}
+
+			seed = seed * 1103515245 + 12345;
+			sprite.setPixel(x, y,
+				qRgba((seed >> 16) & 0xFF, (seed >> 8) & 0xFF, seed >> 24, 0));
+		}
+	}
+
+	qint64 errors[2];
+	for (bool optimized : { false, true })
+	{
+		QBuffer buffer;
+		QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+		QImageWriter writer(&buffer, QByteArrayLiteral("astc"));
+		writer.setSubType(QByteArrayLiteral("4x4"));
+		writer.setOptimizedWrite(optimized);
+		QVERIFY(writer.write(sprite));
+
+		QVERIFY(buffer.seek(0));
+		QImage decoded = QImageReader(&buffer).read();
+		QCOMPARE(decoded.size(), sprite.size());
+
+		qint64 &error = errors[optimized];
+		error = 0;
+		for (int y = 0; y < sprite.height(); y++)
+		{
+			for (int x = 0; x < sprite.width(); x++)
+			{
+				QRgb a = sprite.pixel(x, y);
+				if (qAlpha(a) == 0)
+					continue;
+
+				QRgb b = decoded.pixel(x, y);
+				int dr = qRed(a) - qRed(b);
+				int dg = qGreen(a) - qGreen(b);
+				int db = qBlue(a) - qBlue(b);
+				error += dr * dr + dg * dg + db * db;
+			}
+		}
+	}
+	QVERIFY(errors[true] < errors[false]);
+
+	// fully transparent blocks are stored as constant transparent black
+	QImage transparent(16, 16, QImage::Format_RGBA8888);
+	for (int y = 0; y < transparent.height(); y++)
+	{
+		for (int x = 0; x < transparent.width(); x++)
+			transparent.setPixel(x, y, qRgba(x * 16, y * 16, 255 - x * 16, 0));
+	}
+
+	QBuffer buffer;
+	QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+	QImageWriter writer(&buffer, QByteArrayLiteral("astc"));
+	writer.setSubType(QByteArrayLiteral("4x4"));
+	writer.setOptimizedWrite(true);
+	QVERIFY(writer.write(transparent));
+
+	// void extent blocks of R, G, B, A = 0 after the 16-byte header
+	const QByteArray constantBlock =
+		QByteArray::fromHex("fcfdffffffffffff0000000000000000");
+	const QByteArray data = buffer.data();
+	QCOMPARE(data.size(), 16 + 16 * 16);
+	for (int offset = 16; offset < data.size(); offset += 16)
+		QCOMPARE(data.mid(offset, 16), constantBlock);
+}
+
+void ASTCTests::testMetrics()
+{
+	// rows wider than 65535 texels keep the whole error
+	const int width = 70000;
+	QImage white(width, 2, QImage::Format_RGBA8888);
+	white.fill(Qt::white);
+	QImage black(white.size(), QImage::Format_RGBA8888);
+	black.fill(Qt::transparent);
+
+	QScopedPointer<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0,
+		0, 0, width, 2, white.bytesPerLine(), white.bits()));
+	QScopedPointer<CCodecBuffer> decoded(CreateCodecBuffer(CBT_RGBA8888, 0,
+		0, 0, width, 2, black.bytesPerLine(), black.bits()));
+
+	CCodec_ASTC codec;
+	ASTCQualityMetrics metrics;
+	QCOMPARE(codec.ComputeMetrics(*source, *decoded, metrics), CE_OK);
+	for (int c = 0; c < 4; c++)
+		QCOMPARE(metrics.mse[c], 255.0 * 255.0);
+}
+
+void ASTCTests::testEncodeStats()
+{
+	// every block of a solid image leaves the search at the constant
+	// block exit, with no partitions and no block mode
+	QImage solid(32, 32, QImage::Format_RGBA8888);
+	solid.fill(Qt::red);
+	QScopedPointer<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0,
+		0, 0, solid.width(), solid.height(), solid.bytesPerLine(),
+		solid.bits()));
+
+	CCodec_ASTC codec;
+	QScopedPointer<CCodecBuffer> encoded(
+		codec.CreateBuffer(4, 4, 0, solid.width(), solid.height()));
+	ASTCEncodeStats stats;
+	QCOMPARE(codec.Compress(*source, *encoded, &stats), CE_OK);
+
+	const CMP_DWORD blocks = 8 * 8;
+	QCOMPARE(stats.blocks, blocks);
+	QCOMPARE(stats.exits[ASTC_EXIT_CONSTANT], blocks);
+	for (int exit = ASTC_EXIT_CONSTANT + 1; exit < ASTC_EXIT_COUNT; exit++)
+		QCOMPARE(stats.exits[exit], CMP_DWORD(0));
+	QCOMPARE(stats.partitionCounts[0], blocks);
+	QCOMPARE(stats.dualPlaneBlocks, CMP_DWORD(0));
+	for (CMP_DWORD count : stats.blockModes)
+		QCOMPARE(count, CMP_DWORD(0));
+}
+
+void ASTCTests::testHeatmap()
+{
+	// the error heatmap has one gray texel per block, solid blocks are
+	// encoded exactly and come out darker than noisy ones
+	QImage image(16, 8, QImage::Format_RGBA8888);
+	quint32 seed = 1;
+	for (int y = 0; y < image.height(); y++)
+	{
+		for (int x = 0; x < image.width(); x++)
+		{
+			if (x < 8)
+			{
+				image.setPixel(x, y, qRgba(10, 200, 30, 255));
+				continue;
+			}
+
+			seed = seed * 1103515245 + 12345;
+			image.setPixel(x, y,
+				qRgba((seed >> 16) & 0xFF, (seed >> 8) & 0xFF, seed >> 24, 255));
+		}
+	}
+	QScopedPointer<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0,
+		0, 0, image.width(), image.height(), image.bytesPerLine(),
+		image.bits()));
+
+	CCodec_ASTC codec;
+	QScopedPointer<CCodecBuffer> encoded(
+		codec.CreateBuffer(4, 4, 0, image.width(), image.height()));
+	ASTCBlockCosts costs;
+	QCOMPARE(codec.Compress(*source, *encoded, nullptr, &costs), CE_OK);
+	QCOMPARE(costs.size(), size_t(4 * 2));
+
+	QImage heatmap(int(costs.columns), int(costs.rows * costs.layers),
+		QImage::Format_Grayscale8);
+	costs.heatmap(ASTC_HEATMAP_ERROR, 0.f, heatmap.bits(),
+		heatmap.bytesPerLine());
+
+	for (int y = 0; y < heatmap.height(); y++)
+	{
+		auto row = heatmap.constScanLine(y);
+		QCOMPARE(int(row[0]), 0);
+		QCOMPARE(int(row[1]), 0);
+		QVERIFY(row[2] > row[0]);
+		QVERIFY(row[3] > row[1]);
+	}
+}
+
+void ASTCTests::testTuneQuality()
+{
+	// the tier is picked from a quarter of the blocks, its quality is left
+	// for the caller to set
+	auto &image = fetchImage();
+	QScopedPointer<CCodecBuffer> source(CreateCodecBuffer(CBT_RGBA8888, 0, 0,
+		0, image.width(), image.height(), image.bytesPerLine(),
+		const_cast<uchar *>(image.constBits())));
+
+	CCodec_ASTC codec;
+	const double quality = codec.getQuality();
+
+	// no tier meets a zero deadline, the fastest one is chosen
+	ASTCQualityTuning tuning;
+	QCOMPARE(codec.TuneQuality(*source, 4, 4, 0.0, tuning, 16), CE_OK);
+	QCOMPARE(tuning.totalBlocks, CMP_DWORD(64));
+	QCOMPARE(tuning.sampleBlocks, CMP_DWORD(16));
+	QCOMPARE(tuning.tier, 0);
+	QVERIFY(!tuning.metDeadline);
+	QVERIFY(tuning.estimatedSeconds[0] > 0.0);
+	QVERIFY(tuning.estimatedSeconds[1] < 0.0);
+	QCOMPARE(codec.getQuality(), quality);
+
+	// every tier meets an hour, the most thorough one is chosen
+	QCOMPARE(codec.TuneQuality(*source, 4, 4, 3600.0, tuning, 16), CE_OK);
+	QCOMPARE(tuning.tier, ASTC_QUALITY_TIER_COUNT - 1);
+	QVERIFY(tuning.metDeadline);
+	QCOMPARE(tuning.quality, ASTC_QUALITY_TIER[tuning.tier].quality);
+	QCOMPARE(codec.getQuality(), quality);
+
+	// the sample time is scaled to the image, the fixed time is not
+	for (int tier = 0; tier < ASTC_QUALITY_TIER_COUNT; tier++)
+	{
+		QVERIFY(tuning.fixedSeconds[tier] >= 0.0);
+		double estimate =
+			tuning.fixedSeconds[tier] + tuning.sampleSeconds[tier] * 4;
+		QVERIFY(qAbs(tuning.estimatedSeconds[tier] - estimate) <= 1e-9);
+	}
+}
+
+void ASTCTests::testTrace()
+{
+	// spans of the handler and the codec are written as Chrome trace
+	// events when a trace runs
+	QTemporaryDir tempDir;
+	tempDir.setAutoRemove(true);
+	QVERIFY(tempDir.isValid());
+	QByteArray filePath = QFile::encodeName(
+		QDir(tempDir.path()).filePath(QStringLiteral("trace.json")));
+
+	QVERIFY(!ASTCTrace::stop());
+	QVERIFY(ASTCTrace::start(filePath.constData()));
+	QVERIFY(ASTCTrace::isEnabled());
+	// a single trace runs at a time
+	QVERIFY(!ASTCTrace::start(filePath.constData()));
+
+	QBuffer buffer;
+	QVERIFY(buffer.open(QIODevice::ReadWrite));
+	QASTCHandler handler;
+	handler.setDevice(&buffer);
+	QVERIFY(handler.write(fetchImage()));
+
+	QVERIFY(ASTCTrace::stop());
+	QVERIFY(!ASTCTrace::isEnabled());
+
+	QFile file(QFile::decodeName(filePath));
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	QJsonParseError error;
+	auto document = QJsonDocument::fromJson(file.readAll(), &error);
+	QCOMPARE(error.error, QJsonParseError::NoError);
+
+	QStringList names;
+	QStringList categories;
+	for (const auto &value :
+		document.object().value(QStringLiteral("traceEvents")).toArray())
+	{
+		auto event = value.toObject();
+		names.append(event.value(QStringLiteral("name")).toString());
+		categories.append(event.value(QStringLiteral("cat")).toString());
+	}
+	QVERIFY(names.contains(QStringLiteral("QASTCHandler::write")));
+	QVERIFY(categories.contains(QStringLiteral("codec")));
+	QVERIFY(categories.contains(QStringLiteral("encode")));
+}
+
 void ASTCTests::testWrite(const Options &options, const QDir &dir)
 {
 	QImageWriter writer;
@@ -129,6 +647,82 @@ void ASTCTests::testWrite(const Options &options, const QDir &dir)
 
 	auto &image = fetchImage();
 	QVERIFY(writer.write(image));
+
+	// images are stored bottom-up, flipped ones top-down
+	{
+		QBuffer buffer;
+		QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+		QImageWriter flipWriter(&buffer, QByteArrayLiteral("astc"));
+		flipWriter.setQuality(options.quality);
+		flipWriter.setSubType(subType);
+		flipWriter.setTransformation(QImageIOHandler::TransformationFlip);
+		QVERIFY(flipWriter.write(image));
+
+		QVERIFY(buffer.seek(0));
+		QImage flippedImage = QImageReader(&buffer).read();
+		QVERIFY(checkImages(image.mirrored(), flippedImage));
+	}
+
+	// sRGB blocks keep the colors of the quadrants
+	{
+		auto srgbSubType = subType + QByteArrayLiteral("-srgb");
+		QVERIFY(supportedSubTypes.indexOf(srgbSubType) >= 0);
+
+		QBuffer buffer;
+		QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+		QImageWriter srgbWriter(&buffer, QByteArrayLiteral("astc"));
+		srgbWriter.setQuality(options.quality);
+		srgbWriter.setSubType(srgbSubType);
+		QVERIFY(srgbWriter.write(image));
+
+		QVERIFY(buffer.seek(0));
+		QImage srgbImage = QImageReader(&buffer).read();
+		QVERIFY(checkImages(image, srgbImage));
+	}
+
+	// streamed block rows give the same data
+	{
+		QByteArray data[2];
+		for (int i = 0; i < 2; i++)
+		{
+			QBuffer buffer(&data[i]);
+			QVERIFY(buffer.open(QIODevice::WriteOnly));
+
+			QImageWriter streamWriter(&buffer, QByteArrayLiteral("astc"));
+			streamWriter.setQuality(options.quality);
+			streamWriter.setSubType(subType);
+			streamWriter.setProgressiveScanWrite(i == 1);
+			QVERIFY(streamWriter.write(image));
+		}
+
+		QCOMPARE(data[1], data[0]);
+	}
+
+	// formats encoded without conversion
+	QList<QImage::Format> formats = { QImage::Format_ARGB32,
+		QImage::Format_ARGB32_Premultiplied, QImage::Format_RGB32,
+		QImage::Format_Grayscale8 };
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+	formats << QImage::Format_RGBA64 << QImage::Format_RGBX64;
+#endif
+	for (auto format : formats)
+	{
+		auto source = image.convertToFormat(format);
+
+		QBuffer buffer;
+		QVERIFY(buffer.open(QIODevice::ReadWrite));
+
+		QImageWriter formatWriter(&buffer, QByteArrayLiteral("astc"));
+		formatWriter.setQuality(options.quality);
+		formatWriter.setSubType(subType);
+		QVERIFY(formatWriter.write(source));
+
+		QVERIFY(buffer.seek(0));
+		QImage formatImage = QImageReader(&buffer).read();
+		QVERIFY(checkImages(source, formatImage));
+	}
 }
 
 void ASTCTests::testRead(const ASTCTests::Options &options, const QDir &dir)
@@ -153,14 +747,60 @@ void ASTCTests::testRead(const ASTCTests::Options &options, const QDir &dir)
 #endif
 	QCOMPARE(reader.size(), image.size());
 	QCOMPARE(reader.subType(), subType);
+	// the image has transparent texels
+	QCOMPARE(reader.imageFormat(), QImage::Format_ARGB32_Premultiplied);
 
 	QImage readImage;
 
 	QVERIFY(reader.read(&readImage));
 
 	QCOMPARE(readImage.size(), image.size());
-	QCOMPARE(readImage.format(), QImage::Format_RGBA8888);
+	QCOMPARE(readImage.format(), QImage::Format_ARGB32_Premultiplied);
 	QVERIFY(checkImages(image, readImage));
+
+	// reading from a device that cannot be mapped gives the same image
+	{
+		QFile file(filePathForSubType(dir, subType));
+		QVERIFY(file.open(QIODevice::ReadOnly));
+		QBuffer buffer;
+		buffer.setData(file.readAll());
+		QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+		QImageReader bufferReader(&buffer);
+		QImage bufferImage;
+		QVERIFY(bufferReader.read(&bufferImage));
+		QCOMPARE(bufferImage, readImage);
+	}
+
+	// region of interest decoding must match the full decode
+	const QRect clipRect(5, 3, 21, 19);
+	reader.setFileName(filePathForSubType(dir, subType));
+	reader.setClipRect(clipRect);
+
+	QImage clippedImage;
+	QVERIFY(reader.read(&clippedImage));
+	QCOMPARE(clippedImage.size(), clipRect.size());
+	QCOMPARE(clippedImage, readImage.copy(clipRect));
+
+	// the format comes from the whole image, even for an opaque region
+	reader.setFileName(filePathForSubType(dir, subType));
+	reader.setClipRect(QRect(0, 0, 16, 16));
+	QCOMPARE(reader.imageFormat(), QImage::Format_ARGB32_Premultiplied);
+	QVERIFY(reader.read(&clippedImage));
+	QCOMPARE(clippedImage.format(), QImage::Format_ARGB32_Premultiplied);
+
+	// downscaled decoding keeps the colors of the quadrants
+	reader.setFileName(filePathForSubType(dir, subType));
+	reader.setClipRect(QRect());
+	reader.setScaledSize(QSize(4, 4));
+
+	QImage scaledImage;
+	QVERIFY(reader.read(&scaledImage));
+	QCOMPARE(scaledImage.size(), QSize(4, 4));
+	QVERIFY(checkColors(scaledImage.pixel(0, 0), readImage.pixel(0, 0)));
+	QVERIFY(checkColors(scaledImage.pixel(3, 0), readImage.pixel(31, 0)));
+	QVERIFY(checkColors(scaledImage.pixel(0, 3), readImage.pixel(0, 31)));
+	QVERIFY(checkColors(scaledImage.pixel(3, 3), readImage.pixel(31, 31)));
 }
 
 QString ASTCTests::filePathForSubType(
@@ -10,6 +10,15 @@ class ASTCTests : public QObject
 private slots:
 	void testInstallation();
 	void testIO();
+	void testVolume();
+	void testHDR();
+	void testKTX2();
+	void testOptimizedWrite();
+	void testMetrics();
+	void testEncodeStats();
+	void testHeatmap();
+	void testTuneQuality();
+	void testTrace();
 
 private:
 	struct Options;
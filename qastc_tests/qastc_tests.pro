@@ -3,7 +3,7 @@ QT       += testlib
 QT       += gui
 
 TARGET = QASTCTests
-CONFIG   += console
+CONFIG   += console c++11
 
 TEMPLATE = app
 
@@ -15,9 +15,17 @@ unix {
 
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
 
+INCLUDEPATH += $$PWD/../plugin
+
 SOURCES += \
     main.cpp \
-    Tests.cpp
+    Tests.cpp \
+    ../plugin/QASTCFormats.cpp \
+    ../plugin/QASTCHandler.cpp
 
 HEADERS += \
-    Tests.h
+    Tests.h \
+    ../plugin/QASTCFormats.h \
+    ../plugin/QASTCHandler.h
+
+include(../lib/lib.pri)